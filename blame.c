@@ -16,6 +16,12 @@
 #include "commit-slab.h"
 #include "bloom.h"
 #include "commit-graph.h"
+#include "lockfile.h"
+#include "oidmap.h"
+#include "oidset.h"
+#include "thread-utils.h"
+#include "object-file.h"
+#include "wrapper.h"
 
 define_commit_slab(blame_suspects, struct blame_origin *);
 static struct blame_suspects blame_suspects;
@@ -1921,6 +1927,88 @@ static int blame_chunk_cb(long start_a, long count_a,
 	return 0;
 }
 
+/*
+ * A blob read ahead of time for the diffs below, until an origin takes
+ * it over.
+ */
+struct blame_prediff_blob {
+	struct oidmap_entry entry;
+	mmfile_t file;
+};
+
+/*
+ * A diff between the blob of a parent and the blob of a suspect,
+ * computed ahead of time by several threads (see prediff_window()) and
+ * picked up by pass_blame_to_parent().
+ */
+struct blame_prediff {
+	struct oidmap_entry entry;	/* the blob of the suspect */
+	struct blame_prediff *next;	/* same blob, other parent blob */
+	struct blame_prediff_blob *blob_p, *blob_o;
+	char *path;
+	struct blame_hunk {
+		long start_a, count_a, start_b, count_b;
+	} *hunks;
+	size_t nr, alloc;
+	int ok, used;
+};
+
+struct blame_prediffs {
+	struct oidmap map;
+	struct blame_prediff **jobs;
+	size_t nr, alloc;
+	struct oidmap blob_map;
+	struct blame_prediff_blob **blobs;
+	size_t blobs_nr, blobs_alloc;
+	int threads;
+	int xdl_opts;
+
+	/* work handed out to the threads */
+	size_t next, work_nr;
+	void (*work)(struct blame_prediffs *pd, size_t i);
+
+	/* for deciding when to look ahead again */
+	int unused, misses, countdown;
+
+	/* stats */
+	int count, hits;
+#ifndef NO_PTHREADS
+	pthread_mutex_t mutex;
+#endif
+};
+
+static struct blame_prediff *take_prediff(struct blame_prediffs *pd,
+					  struct blame_origin *parent,
+					  struct blame_origin *target)
+{
+	struct blame_prediff *p;
+
+	for (p = oidmap_get(&pd->map, &target->blob_oid); p; p = p->next) {
+		if (!p->ok || p->used ||
+		    !oideq(&p->blob_p->entry.oid, &parent->blob_oid) ||
+		    strcmp(p->path, parent->path) || strcmp(p->path, target->path))
+			continue;
+		p->used = 1;
+		pd->unused--;
+		pd->hits++;
+		return p;
+	}
+	pd->misses++;
+	return NULL;
+}
+
+/* Let an origin take over a blob read ahead of time, if it needs one */
+static void adopt_prediff_blob(struct blame_scoreboard *sb,
+			       struct blame_origin *o,
+			       struct blame_prediff_blob *blob)
+{
+	if (o->file.ptr || !blob->file.ptr)
+		return;
+	sb->num_read_blob++;
+	o->file = blob->file;
+	blob->file.ptr = NULL;
+}
+
 /*
  * We are looking at the origin 'target' and aiming to pass blame
  * for the lines it is suspected to its parent.  Run diff to find
@@ -1933,6 +2021,7 @@ static void pass_blame_to_parent(struct blame_scoreboard *sb,
 	mmfile_t file_p, file_o;
 	struct blame_chunk_cb_data d;
 	struct blame_entry *newdest = NULL;
+	struct blame_prediff *pd = NULL;
 
 	if (!target->suspects)
 		return; /* nothing remains for this target */
@@ -1943,13 +2032,26 @@ static void pass_blame_to_parent(struct blame_scoreboard *sb,
 	d.ignore_diffs = ignore_diffs;
 	d.dstq = &newdest; d.srcq = &target->suspects;
 
+	if (sb->prediffs)
+		pd = take_prediff(sb->prediffs, parent, target);
+	if (pd) {
+		adopt_prediff_blob(sb, parent, pd->blob_p);
+		adopt_prediff_blob(sb, target, pd->blob_o);
+	}
 	fill_origin_blob(&sb->revs->diffopt, parent, &file_p,
 			 &sb->num_read_blob, ignore_diffs);
 	fill_origin_blob(&sb->revs->diffopt, target, &file_o,
 			 &sb->num_read_blob, ignore_diffs);
 	sb->num_get_patch++;
 
-	if (diff_hunks(&file_p, &file_o, blame_chunk_cb, &d, sb->xdl_opts))
+	if (pd) {
+		size_t i;
+
+		for (i = 0; i < pd->nr; i++)
+			blame_chunk_cb(pd->hunks[i].start_a, pd->hunks[i].count_a,
+				       pd->hunks[i].start_b, pd->hunks[i].count_b,
+				       &d);
+	} else if (diff_hunks(&file_p, &file_o, blame_chunk_cb, &d, sb->xdl_opts))
 		die("unable to generate diff (%s -> %s)",
 		    oid_to_hex(&parent->commit->object.oid),
 		    oid_to_hex(&target->commit->object.oid));
@@ -2393,6 +2495,304 @@ static void distribute_blame(struct blame_scoreboard *sb, struct blame_entry *bl
 
 #define MAXSG 16
 
+/*
+ * Number of diffs handed to the threads at once, per thread; this bounds
+ * the number of blobs that are held in memory.
+ */
+#define PREDIFF_JOBS_PER_THREAD 16
+
+static int record_prediff_hunk(long start_a, long count_a,
+			       long start_b, long count_b, void *data)
+{
+	struct blame_prediff *p = data;
+
+	ALLOC_GROW(p->hunks, p->nr + 1, p->alloc);
+	p->hunks[p->nr].start_a = start_a;
+	p->hunks[p->nr].count_a = count_a;
+	p->hunks[p->nr].start_b = start_b;
+	p->hunks[p->nr].count_b = count_b;
+	p->nr++;
+	return 0;
+}
+
+static void read_prediff_blob(struct blame_prediffs *pd, size_t i)
+{
+	struct blame_prediff_blob *blob = pd->blobs[i];
+	enum object_type type;
+	unsigned long size;
+
+	blob->file.ptr = repo_read_object_file(the_repository, &blob->entry.oid,
+					       &type, &size);
+	blob->file.size = size;
+	if (blob->file.ptr && type != OBJ_BLOB)
+		FREE_AND_NULL(blob->file.ptr);
+}
+
+static void run_prediff(struct blame_prediffs *pd, size_t i)
+{
+	struct blame_prediff *p = pd->jobs[i];
+
+	if (p->blob_p->file.ptr && p->blob_o->file.ptr)
+		p->ok = !diff_hunks(&p->blob_p->file, &p->blob_o->file,
+				    record_prediff_hunk, p, pd->xdl_opts);
+}
+
+static void *prediff_worker(void *data)
+{
+	struct blame_prediffs *pd = data;
+
+	for (;;) {
+		size_t i;
+
+#ifndef NO_PTHREADS
+		pthread_mutex_lock(&pd->mutex);
+#endif
+		i = pd->next++;
+#ifndef NO_PTHREADS
+		pthread_mutex_unlock(&pd->mutex);
+#endif
+		if (i >= pd->work_nr)
+			break;
+		pd->work(pd, i);
+	}
+	return NULL;
+}
+
+static void run_prediff_threads(struct blame_prediffs *pd, size_t nr,
+				void (*work)(struct blame_prediffs *, size_t))
+{
+	pd->next = 0;
+	pd->work_nr = nr;
+	pd->work = work;
+#ifndef NO_PTHREADS
+	{
+		pthread_t *threads;
+		int t;
+
+		/* the main thread works too */
+		CALLOC_ARRAY(threads, pd->threads - 1);
+		for (t = 0; t < pd->threads - 1; t++) {
+			int err = pthread_create(&threads[t], NULL,
+						 prediff_worker, pd);
+			if (err)
+				die(_("unable to create thread: %s"),
+				    strerror(err));
+		}
+		prediff_worker(pd);
+		for (t = 0; t < pd->threads - 1; t++)
+			pthread_join(threads[t], NULL);
+		free(threads);
+	}
+#else
+	prediff_worker(pd);
+#endif
+}
+
+static void run_prediffs(struct blame_prediffs *pd)
+{
+	size_t i;
+
+	/* the object store needs a lock once several threads read */
+	enable_obj_read_lock();
+	run_prediff_threads(pd, pd->blobs_nr, read_prediff_blob);
+	disable_obj_read_lock();
+	run_prediff_threads(pd, pd->nr, run_prediff);
+
+	for (i = 0; i < pd->nr; i++)
+		if (pd->jobs[i]->ok)
+			pd->unused++;
+}
+
+static void clear_prediffs(struct blame_prediffs *pd)
+{
+	size_t i;
+
+	for (i = 0; i < pd->nr; i++) {
+		struct blame_prediff *p = pd->jobs[i];
+
+		free(p->hunks);
+		free(p->path);
+		free(p);
+	}
+	for (i = 0; i < pd->blobs_nr; i++) {
+		free(pd->blobs[i]->file.ptr);
+		free(pd->blobs[i]);
+	}
+	oidmap_free(&pd->map, 0);
+	oidmap_init(&pd->map, 0);
+	oidmap_free(&pd->blob_map, 0);
+	oidmap_init(&pd->blob_map, 0);
+	pd->nr = pd->blobs_nr = 0;
+	pd->unused = pd->misses = 0;
+}
+
+static struct blame_prediff_blob *get_prediff_blob(struct blame_prediffs *pd,
+						   const struct object_id *oid)
+{
+	struct blame_prediff_blob *blob = oidmap_get(&pd->blob_map, oid);
+
+	if (!blob) {
+		CALLOC_ARRAY(blob, 1);
+		oidcpy(&blob->entry.oid, oid);
+		oidmap_put(&pd->blob_map, blob);
+		ALLOC_GROW(pd->blobs, pd->blobs_nr + 1, pd->blobs_alloc);
+		pd->blobs[pd->blobs_nr++] = blob;
+	}
+	return blob;
+}
+
+static void add_prediff(struct blame_scoreboard *sb,
+			const struct object_id *parent,
+			const struct object_id *target, const char *path,
+			unsigned mode)
+{
+	struct blame_prediffs *pd = sb->prediffs;
+	struct blame_prediff *head, *p;
+
+	head = oidmap_get(&pd->map, target);
+	for (p = head; p; p = p->next)
+		if (oideq(&p->blob_p->entry.oid, parent) && !strcmp(p->path, path))
+			return;
+
+	/* Blobs that are converted for diffing are left to the main thread */
+	if (sb->revs->diffopt.flags.allow_textconv) {
+		struct diff_filespec *df = alloc_filespec(path);
+		int textconv;
+
+		fill_filespec(df, target, 1, mode);
+		textconv = !!get_textconv(sb->repo, df);
+		free_filespec(df);
+		if (textconv)
+			return;
+	}
+
+	CALLOC_ARRAY(p, 1);
+	oidcpy(&p->entry.oid, target);
+	p->blob_p = get_prediff_blob(pd, parent);
+	p->blob_o = get_prediff_blob(pd, target);
+	p->path = xstrdup(path);
+	if (head) {
+		p->next = head->next;
+		head->next = p;
+	} else {
+		oidmap_put(&pd->map, p);
+	}
+	ALLOC_GROW(pd->jobs, pd->nr + 1, pd->alloc);
+	pd->jobs[pd->nr++] = p;
+}
+
+struct prediff_walk_item {
+	struct commit *commit;
+	const char *path;
+	struct object_id oid;
+	unsigned mode;
+};
+
+/*
+ * Guess which diffs pass_blame() is going to need next by following the
+ * paths of the suspects in the queue down the history, assuming they are
+ * not renamed, and compute them using several threads.
+ */
+static void prediff_window(struct blame_scoreboard *sb, struct commit *current)
+{
+	struct blame_prediffs *pd = sb->prediffs;
+	struct prediff_walk_item *items = NULL;
+	size_t nr = 0, alloc = 0, i;
+	size_t max_jobs = st_mult(pd->threads, PREDIFF_JOBS_PER_THREAD);
+	size_t max_items = st_mult(max_jobs, 8);
+	struct oidset seen = OIDSET_INIT;
+	int q;
+
+	clear_prediffs(pd);
+
+	for (q = -1; q < sb->commits.nr; q++) {
+		struct commit *commit = q < 0 ? current : sb->commits.array[q].data;
+		struct blame_origin *o;
+
+		for (o = get_blame_suspects(commit); o; o = o->next) {
+			if (!o->suspects || is_null_oid(&o->blob_oid))
+				continue;
+			ALLOC_GROW(items, nr + 1, alloc);
+			items[nr].commit = commit;
+			items[nr].path = o->path;
+			oidcpy(&items[nr].oid, &o->blob_oid);
+			items[nr].mode = o->mode;
+			nr++;
+		}
+	}
+
+	for (i = 0; i < nr && i < max_items && pd->nr < max_jobs; i++) {
+		struct commit *commit = items[i].commit;
+		struct commit_list *sg;
+
+		if (commit->object.flags & UNINTERESTING ||
+		    (sb->revs->max_age != -1 && commit->date < sb->revs->max_age))
+			continue;
+		for (sg = first_scapegoat(sb->revs, commit, 0); sg; sg = sg->next) {
+			struct commit *p = sg->item;
+			struct object_id oid;
+			unsigned short mode;
+
+			if (repo_parse_commit(the_repository, p) ||
+			    get_tree_entry(sb->repo, &p->object.oid, items[i].path,
+					   &oid, &mode) ||
+			    !S_ISREG(mode))
+				continue;
+			if (!oideq(&oid, &items[i].oid))
+				add_prediff(sb, &oid, &items[i].oid,
+					    items[i].path, mode);
+			if (oidset_insert(&seen, &p->object.oid))
+				continue;
+			ALLOC_GROW(items, nr + 1, alloc);
+			items[nr].commit = p;
+			items[nr].path = items[i].path;
+			oidcpy(&items[nr].oid, &oid);
+			items[nr].mode = mode;
+			nr++;
+		}
+	}
+	free(items);
+	oidset_clear(&seen);
+
+	/* Do not look ahead again before getting past what we looked at */
+	pd->countdown = pd->nr ? 0 : i;
+	if (!pd->nr)
+		return;
+	pd->count += pd->nr;
+	run_prediffs(pd);
+}
+
+static void maybe_prediff(struct blame_scoreboard *sb, struct commit *commit)
+{
+	struct blame_prediffs *pd = sb->prediffs;
+
+	if (!pd)
+		return;
+	if (pd->countdown > 0) {
+		pd->countdown--;
+		return;
+	}
+	if (!pd->unused || pd->misses > pd->threads)
+		prediff_window(sb, commit);
+}
+
+void setup_blame_threads(struct blame_scoreboard *sb, int threads)
+{
+	if (!threads)
+		threads = online_cpus();
+	if (!HAVE_THREADS || threads < 2 || sb->reverse)
+		return;
+
+	CALLOC_ARRAY(sb->prediffs, 1);
+	oidmap_init(&sb->prediffs->map, 0);
+	oidmap_init(&sb->prediffs->blob_map, 0);
+	sb->prediffs->threads = threads;
+	sb->prediffs->xdl_opts = sb->xdl_opts;
+#ifndef NO_PTHREADS
+	pthread_mutex_init(&sb->prediffs->mutex, NULL);
+#endif
+}
+
 typedef struct blame_origin *(*blame_find_alg)(struct repository *,
 					       struct commit *,
 					       struct blame_origin *,
@@ -2566,6 +2966,298 @@ static void pass_blame(struct blame_scoreboard *sb, struct blame_origin *origin,
 		free(sg_origin);
 }
 
+/*
+ * The blame cache remembers the final blame of a whole file at a commit
+ * in $GIT_DIR/blame-cache/, so that a later blame that digs down to the
+ * same commit and path can take the result from there instead of
+ * passing blame further down the history.  A file holds
+ *
+ *   "blame-cache v1 " <num-lines> LF
+ *
+ * followed by one record per group of lines, sorted by line number:
+ *
+ *   <lno> SP <num-lines> SP <s-lno> SP <commit> SP <previous-commit>
+ *   SP <path> NUL [<previous-path> NUL]
+ *
+ * where <previous-commit> is "-" if there is none.  The entry is keyed
+ * by the commit, the path and the options that affect the result.
+ */
+#define BLAME_CACHE_HEADER "blame-cache v1 "
+
+struct blame_cache_record {
+	int lno, num_lines, s_lno;
+	struct commit *commit;
+	const char *path;
+	struct commit *previous;
+	const char *previous_path;
+};
+
+static char *blame_cache_path(struct blame_scoreboard *sb,
+			      struct commit *commit, const char *path)
+{
+	git_hash_ctx ctx;
+	unsigned char hash[GIT_MAX_RAWSZ];
+
+	the_hash_algo->init_fn(&ctx);
+	the_hash_algo->update_fn(&ctx, commit->object.oid.hash,
+				 the_hash_algo->rawsz);
+	the_hash_algo->update_fn(&ctx, path, strlen(path) + 1);
+	the_hash_algo->update_fn(&ctx, sb->cache_options,
+				 strlen(sb->cache_options));
+	the_hash_algo->final_fn(hash, &ctx);
+	return repo_git_path(sb->repo, "blame-cache/%s", hash_to_hex(hash));
+}
+
+static struct commit *blame_cache_commit(struct blame_scoreboard *sb,
+					 const char **p)
+{
+	struct object_id oid;
+	struct commit *commit;
+
+	if (parse_oid_hex(*p, &oid, p) ||
+	    !(commit = lookup_commit(sb->repo, &oid)) ||
+	    repo_parse_commit(sb->repo, commit))
+		return NULL;
+	return commit;
+}
+
+static int parse_blame_cache(struct blame_scoreboard *sb,
+			     const char *p, const char *end,
+			     struct blame_cache_record **records,
+			     int *nr, int *alloc)
+{
+	int num_lines, next_lno = 0;
+	char *ep;
+
+	/* All fields below stop at the final NUL at the latest */
+	if (p == end || end[-1] != '\0' ||
+	    !skip_prefix(p, BLAME_CACHE_HEADER, &p))
+		return -1;
+	num_lines = strtol(p, &ep, 10);
+	if (*ep != '\n')
+		return -1;
+	p = ep + 1;
+
+	while (p < end) {
+		struct blame_cache_record *r;
+
+		ALLOC_GROW(*records, *nr + 1, *alloc);
+		r = &(*records)[(*nr)++];
+		r->lno = strtol(p, &ep, 10);
+		if (*ep != ' ' || r->lno != next_lno)
+			return -1;
+		r->num_lines = strtol(ep + 1, &ep, 10);
+		if (*ep != ' ' || r->num_lines <= 0)
+			return -1;
+		r->s_lno = strtol(ep + 1, &ep, 10);
+		if (*ep != ' ' || r->s_lno < 0)
+			return -1;
+		p = ep + 1;
+		if (!(r->commit = blame_cache_commit(sb, &p)) || *p++ != ' ')
+			return -1;
+		if (*p == '-')
+			r->previous = NULL, p++;
+		else if (!(r->previous = blame_cache_commit(sb, &p)))
+			return -1;
+		if (*p++ != ' ')
+			return -1;
+		r->path = p;
+		p += strlen(p) + 1;
+		if (r->previous) {
+			if (p >= end)
+				return -1;
+			r->previous_path = p;
+			p += strlen(p) + 1;
+		}
+		next_lno += r->num_lines;
+	}
+	return next_lno == num_lines ? 0 : -1;
+}
+
+static void blame_cache_apply(struct blame_scoreboard *sb,
+			      struct blame_origin *origin,
+			      struct blame_cache_record *records, int nr)
+{
+	struct blame_entry *e = origin->suspects, *own = NULL;
+	struct blame_entry **own_tail = &own;
+
+	while (e) {
+		struct blame_entry *next = e->next;
+		int end = e->s_lno + e->num_lines;
+		int lo = 0, hi = nr, i;
+
+		/* find the record holding the first line of e */
+		while (lo < hi) {
+			int mi = lo + (hi - lo) / 2;
+
+			if (records[mi].lno + records[mi].num_lines <= e->s_lno)
+				lo = mi + 1;
+			else
+				hi = mi;
+		}
+		for (i = lo; i < nr && records[i].lno < end; i++) {
+			struct blame_cache_record *r = &records[i];
+			struct blame_entry *n = xcalloc(1, sizeof(*n));
+			int start = r->lno > e->s_lno ? r->lno : e->s_lno;
+			int stop = r->lno + r->num_lines;
+
+			if (stop > end)
+				stop = end;
+			n->lno = e->lno + start - e->s_lno;
+			n->num_lines = stop - start;
+			n->s_lno = r->s_lno + start - r->lno;
+			n->ignored = e->ignored;
+			n->unblamable = e->unblamable;
+			/*
+			 * The walk may still reach these origins from other
+			 * suspects, so they need their blobs like any other.
+			 */
+			n->suspect = get_origin(r->commit, r->path);
+			fill_blob_sha1_and_mode(sb->repo, n->suspect);
+			if (r->previous && !n->suspect->previous) {
+				n->suspect->previous =
+					get_origin(r->previous, r->previous_path);
+				fill_blob_sha1_and_mode(sb->repo,
+							n->suspect->previous);
+			}
+			/* treat root commit as boundary */
+			if (!r->commit->parents && !sb->show_root)
+				r->commit->object.flags |= UNINTERESTING;
+
+			if (n->suspect == origin) {
+				*own_tail = n;
+				own_tail = &n->next;
+			} else {
+				n->suspect->guilty = 1;
+				if (sb->found_guilty_entry)
+					sb->found_guilty_entry(n, sb->found_guilty_entry_data);
+				n->next = sb->ent;
+				sb->ent = n;
+			}
+		}
+		blame_origin_decref(e->suspect);
+		free(e);
+		e = next;
+	}
+	*own_tail = NULL;
+	origin->suspects = own;
+}
+
+/*
+ * If the final blame of origin is in the cache, take the blame for the
+ * suspects of origin from there and return 1.
+ */
+static int blame_cache_lookup(struct blame_scoreboard *sb,
+			      struct blame_origin *origin)
+{
+	struct blame_cache_record *records = NULL;
+	int nr = 0, alloc = 0, fd, ret = 0;
+	struct blame_entry *e;
+	struct stat st;
+	char *path, *map;
+
+	if (!sb->cache_options || is_null_oid(&origin->commit->object.oid))
+		return 0;
+
+	path = blame_cache_path(sb, origin->commit, origin->path);
+	fd = git_open(path);
+	if (fd < 0)
+		goto out;
+	if (fstat(fd, &st) || !st.st_size) {
+		close(fd);
+		goto out;
+	}
+	map = xmmap(NULL, xsize_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (!parse_blame_cache(sb, map, map + st.st_size,
+			       &records, &nr, &alloc)) {
+		for (e = origin->suspects; e; e = e->next)
+			if (!nr || e->s_lno + e->num_lines >
+			    records[nr - 1].lno + records[nr - 1].num_lines)
+				break;
+		if (!e) {
+			blame_cache_apply(sb, origin, records, nr);
+			trace2_data_string("blame", sb->repo, "cache/hit",
+					   origin->path);
+			/* Tell "git gc" that the entry is in use. */
+			utime(path, NULL);
+			ret = 1;
+		}
+	}
+	munmap(map, xsize_t(st.st_size));
+	free(records);
+out:
+	free(path);
+	return ret;
+}
+
+static int compare_blame_final_qsort(const void *a, const void *b)
+{
+	const struct blame_entry *e1 = *(const struct blame_entry **)a;
+	const struct blame_entry *e2 = *(const struct blame_entry **)b;
+
+	return e1->lno - e2->lno;
+}
+
+void blame_cache_write(struct blame_scoreboard *sb)
+{
+	struct lock_file lock = LOCK_INIT;
+	struct strbuf buf = STRBUF_INIT;
+	struct blame_entry *e, **sorted;
+	int i, nr = 0, next_lno = 0;
+	char *path;
+
+	if (!sb->cache_options || !sb->num_lines ||
+	    is_null_oid(&sb->final->object.oid))
+		return;
+
+	for (e = sb->ent; e; e = e->next)
+		nr++;
+	ALLOC_ARRAY(sorted, nr);
+	for (i = 0, e = sb->ent; e; e = e->next)
+		sorted[i++] = e;
+	QSORT(sorted, nr, compare_blame_final_qsort);
+
+	strbuf_addf(&buf, BLAME_CACHE_HEADER "%d\n", sb->num_lines);
+	for (i = 0; i < nr; i++) {
+		struct blame_origin *suspect = sorted[i]->suspect;
+		struct blame_origin *prev = suspect->previous;
+
+		/* Only the blame of the whole file is useful later */
+		if (sorted[i]->lno != next_lno)
+			goto out;
+		next_lno += sorted[i]->num_lines;
+		strbuf_addf(&buf, "%d %d %d %s %s %s",
+			    sorted[i]->lno, sorted[i]->num_lines,
+			    sorted[i]->s_lno,
+			    oid_to_hex(&suspect->commit->object.oid),
+			    prev ? oid_to_hex(&prev->commit->object.oid) : "-",
+			    suspect->path);
+		strbuf_addch(&buf, '\0');
+		if (prev)
+			strbuf_add(&buf, prev->path, strlen(prev->path) + 1);
+	}
+	if (next_lno != sb->num_lines)
+		goto out;
+
+	/*
+	 * This is only a cache; if another process holds the lock or we
+	 * cannot write, just skip it.
+	 */
+	path = blame_cache_path(sb, sb->final, sb->path);
+	if (safe_create_leading_directories(path) == SCLD_OK &&
+	    hold_lock_file_for_update(&lock, path, 0) >= 0) {
+		if (write_in_full(get_lock_file_fd(&lock), buf.buf, buf.len) < 0 ||
+		    commit_lock_file(&lock) < 0)
+			rollback_lock_file(&lock);
+	}
+	free(path);
+out:
+	free(sorted);
+	strbuf_release(&buf);
+}
+
 /*
  * The main loop -- while we have blobs with lines whose true origin
  * is still unknown, pick one blob, and allow its lines to pass blames
@@ -2598,9 +3290,12 @@ void assign_blame(struct blame_scoreboard *sb, int opt)
 		repo_parse_commit(the_repository, commit);
 		if (sb->reverse ||
 		    (!(commit->object.flags & UNINTERESTING) &&
-		     !(revs->max_age != -1 && commit->date < revs->max_age)))
-			pass_blame(sb, suspect, opt);
-		else {
+		     !(revs->max_age != -1 && commit->date < revs->max_age))) {
+			if (!blame_cache_lookup(sb, suspect)) {
+				maybe_prediff(sb, commit);
+				pass_blame(sb, suspect, opt);
+			}
+		} else {
 			commit->object.flags |= UNINTERESTING;
 			if (commit->object.parsed)
 				mark_parents_uninteresting(sb->revs, commit);
@@ -2916,8 +3611,47 @@ void setup_blame_bloom_data(struct blame_scoreboard *sb)
 	sb->bloom_data = bd;
 }
 
+void setup_blame_cache(struct blame_scoreboard *sb, int opt)
+{
+	struct commit_list *l;
+
+	/*
+	 * Only use the cache when the blame of some lines at a commit does
+	 * not depend on where we started digging from, nor on what else is
+	 * being blamed.
+	 */
+	if (sb->reverse || (opt & (PICKAXE_BLAME_MOVE | PICKAXE_BLAME_COPY)) ||
+	    oidset_size(&sb->ignore_list) || sb->revs->max_age != -1)
+		return;
+	for (l = sb->revs->commits; l; l = l->next)
+		if (l->item->object.flags & UNINTERESTING)
+			return;
+
+	sb->cache_options = xstrfmt("xdl=%d textconv=%d first-parent=%d "
+				    "whole-file-rename=%d", sb->xdl_opts,
+				    sb->revs->diffopt.flags.allow_textconv,
+				    sb->revs->first_parent_only,
+				    !sb->no_whole_file_rename);
+}
+
 void cleanup_scoreboard(struct blame_scoreboard *sb)
 {
+	FREE_AND_NULL(sb->cache_options);
+	if (sb->prediffs) {
+		trace2_data_intmax("blame", sb->repo, "prediff/count",
+				   sb->prediffs->count);
+		trace2_data_intmax("blame", sb->repo, "prediff/used",
+				   sb->prediffs->hits);
+		clear_prediffs(sb->prediffs);
+		oidmap_free(&sb->prediffs->map, 0);
+		oidmap_free(&sb->prediffs->blob_map, 0);
+		free(sb->prediffs->jobs);
+		free(sb->prediffs->blobs);
+#ifndef NO_PTHREADS
+		pthread_mutex_destroy(&sb->prediffs->mutex);
+#endif
+		FREE_AND_NULL(sb->prediffs);
+	}
 	if (sb->bloom_data) {
 		int i;
 		for (i = 0; i < sb->bloom_data->nr; i++) {
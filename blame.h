@@ -100,6 +100,7 @@ struct blame_entry {
 };
 
 struct blame_bloom_data;
+struct blame_prediffs;
 
 /*
  * The current state of the blame assignment.
@@ -158,6 +159,15 @@ struct blame_scoreboard {
 
 	void *found_guilty_entry_data;
 	struct blame_bloom_data *bloom_data;
+
+	/*
+	 * Options the blame cache is keyed on, or NULL if the blame
+	 * cache is not in use; see setup_blame_cache()
+	 */
+	char *cache_options;
+
+	/* diffs computed ahead of time; see setup_blame_threads() */
+	struct blame_prediffs *prediffs;
 };
 
 /*
@@ -182,6 +192,9 @@ void init_scoreboard(struct blame_scoreboard *sb);
 void setup_scoreboard(struct blame_scoreboard *sb,
 		      struct blame_origin **orig);
 void setup_blame_bloom_data(struct blame_scoreboard *sb);
+void setup_blame_cache(struct blame_scoreboard *sb, int opt);
+void setup_blame_threads(struct blame_scoreboard *sb, int threads);
+void blame_cache_write(struct blame_scoreboard *sb);
 void cleanup_scoreboard(struct blame_scoreboard *sb);
 
 struct blame_entry *blame_entry_prepend(struct blame_entry *head,
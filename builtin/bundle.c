@@ -15,7 +15,7 @@
  */
 
 #define BUILTIN_BUNDLE_CREATE_USAGE \
-	N_("git bundle create [-q | --quiet | --progress]\n" \
+	N_("git bundle create [-q | --quiet | --progress] [--reuse-pack]\n" \
 	   "                  [--version=<version>] <file> <git-rev-list-args>")
 #define BUILTIN_BUNDLE_VERIFY_USAGE \
 	N_("git bundle verify [-q | --quiet] <file>")
@@ -71,6 +71,7 @@ static int cmd_bundle_create(int argc, const char **argv, const char *prefix) {
 	int progress = isatty(STDERR_FILENO);
 	struct strvec pack_opts;
 	int version = -1;
+	int reuse_pack = 0;
 	int ret;
 	struct option options[] = {
 		OPT_SET_INT('q', "quiet", &progress,
@@ -85,6 +86,8 @@ static int cmd_bundle_create(int argc, const char **argv, const char *prefix) {
 				N_("historical; does nothing")),
 		OPT_INTEGER(0, "version", &version,
 			    N_("specify bundle format version")),
+		OPT_BOOL(0, "reuse-pack", &reuse_pack,
+			 N_("copy pack data from the bitmapped pack without searching for deltas")),
 		OPT_END()
 	};
 	char *bundle_file;
@@ -102,6 +105,8 @@ static int cmd_bundle_create(int argc, const char **argv, const char *prefix) {
 		strvec_push(&pack_opts, "--all-progress");
 	if (progress && all_progress_implied)
 		strvec_push(&pack_opts, "--all-progress-implied");
+	if (reuse_pack)
+		strvec_pushl(&pack_opts, "--use-bitmap-index", "--window=0", NULL);
 
 	if (!startup_info->have_repository)
 		die(_("Need a repository to create a bundle."));
@@ -179,6 +179,7 @@ int cmd_fetch_pack(int argc, const char **argv, const char *prefix UNUSED)
 		dest = argv[i++];
 	else
 		usage(fetch_pack_usage);
+	args.url = dest;
 
 	/*
 	 * Copy refs from cmdline to growable list, then append any
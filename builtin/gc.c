@@ -16,6 +16,7 @@
 #include "hex.h"
 #include "repository.h"
 #include "config.h"
+#include "dir.h"
 #include "tempfile.h"
 #include "lockfile.h"
 #include "parse-options.h"
@@ -60,6 +61,10 @@ static timestamp_t gc_log_expire_time;
 static const char *gc_log_expire = "1.day.ago";
 static const char *prune_expire = "2.weeks.ago";
 static const char *prune_worktrees_expire = "3.months.ago";
+static timestamp_t rename_cache_expire_time;
+static const char *rename_cache_expire = "2.weeks.ago";
+static timestamp_t blame_cache_expire_time;
+static const char *blame_cache_expire = "2.weeks.ago";
 static unsigned long big_pack_threshold;
 static unsigned long max_delta_cache_size = DEFAULT_DELTA_CACHE_SIZE;
 
@@ -88,6 +93,37 @@ static void report_pack_garbage(unsigned seen_bits, const char *path)
 		string_list_append(&pack_garbage, path);
 }
 
+/*
+ * Remove the entries of $GIT_DIR/<name>/ that were last used before
+ * "expire".  Caches refresh the mtime of an entry whenever they use it.
+ */
+static void expire_cache_dir(const char *name, timestamp_t expire)
+{
+	struct strbuf path = STRBUF_INIT;
+	struct dirent *e;
+	size_t len;
+	DIR *dir;
+
+	strbuf_addstr(&path, git_path("%s", name));
+	dir = opendir(path.buf);
+	if (!dir)
+		goto out;
+	strbuf_addch(&path, '/');
+	len = path.len;
+	while ((e = readdir_skip_dot_and_dotdot(dir))) {
+		struct stat st;
+
+		strbuf_setlen(&path, len);
+		strbuf_addstr(&path, e->d_name);
+		if (!lstat(path.buf, &st) && S_ISREG(st.st_mode) &&
+		    st.st_mtime <= expire)
+			unlink_or_warn(path.buf);
+	}
+	closedir(dir);
+out:
+	strbuf_release(&path);
+}
+
 static void process_log_file(void)
 {
 	struct stat st;
@@ -165,6 +201,8 @@ static void gc_config(void)
 	git_config_get_expiry("gc.pruneexpire", &prune_expire);
 	git_config_get_expiry("gc.worktreepruneexpire", &prune_worktrees_expire);
 	git_config_get_expiry("gc.logexpiry", &gc_log_expire);
+	git_config_get_expiry("gc.renamecacheexpire", &rename_cache_expire);
+	git_config_get_expiry("gc.blamecacheexpire", &blame_cache_expire);
 
 	git_config_get_ulong("gc.bigpackthreshold", &big_pack_threshold);
 	git_config_get_ulong("pack.deltacachesize", &max_delta_cache_size);
@@ -598,6 +636,12 @@ int cmd_gc(int argc, const char **argv, const char *prefix)
 	gc_config();
 	if (parse_expiry_date(gc_log_expire, &gc_log_expire_time))
 		die(_("failed to parse gc.logExpiry value %s"), gc_log_expire);
+	if (parse_expiry_date(rename_cache_expire, &rename_cache_expire_time))
+		die(_("failed to parse gc.renameCacheExpire value %s"),
+		    rename_cache_expire);
+	if (parse_expiry_date(blame_cache_expire, &blame_cache_expire_time))
+		die(_("failed to parse gc.blameCacheExpire value %s"),
+		    blame_cache_expire);
 
 	if (pack_refs < 0)
 		pack_refs = !is_bare_repository();
@@ -732,6 +776,9 @@ int cmd_gc(int argc, const char **argv, const char *prefix)
 	if (run_command(&rerere_cmd))
 		die(FAILED_RUN, rerere.v[0]);
 
+	expire_cache_dir("rename-cache", rename_cache_expire_time);
+	expire_cache_dir("blame-cache", blame_cache_expire_time);
+
 	report_garbage = report_pack_garbage;
 	reprepare_packed_git(the_repository);
 	if (pack_garbage.nr > 0) {
@@ -16,6 +16,7 @@
 #include "exec-cmd.h"
 #include "merge-blobs.h"
 #include "quote.h"
+#include "write-or-die.h"
 
 static int line_termination = '\n';
 
@@ -412,15 +413,22 @@ struct merge_tree_options {
 	int use_stdin;
 };
 
+/*
+ * Merge branch1 and branch2 and print the result.  opt must have been set
+ * up with init_merge_options().  result is either zeroed, or holds the
+ * result of a previous real_merge() with the same opt, in which case the
+ * memory and the renames detected in that merge are reused; the caller
+ * must call merge_finalize() when done.
+ */
 static int real_merge(struct merge_tree_options *o,
+		      struct merge_options *opt,
+		      struct merge_result *result,
 		      const char *merge_base,
 		      const char *branch1, const char *branch2,
 		      const char *prefix)
 {
 	struct commit *parent1, *parent2;
 	struct commit_list *merge_bases = NULL;
-	struct merge_options opt;
-	struct merge_result result = { 0 };
 	int show_messages = o->show_messages;
 
 	parent1 = get_merge_parent(branch1);
@@ -433,12 +441,9 @@ static int real_merge(struct merge_tree_options *o,
 		help_unknown_ref(branch2, "merge-tree",
 				 _("not something we can merge"));
 
-	init_merge_options(&opt, the_repository);
-
-	opt.show_rename_progress = 0;
-
-	opt.branch1 = branch1;
-	opt.branch2 = branch2;
+	opt->branch1 = branch1;
+	opt->branch2 = branch2;
+	merge_discard_messages(result);
 
 	if (merge_base) {
 		struct commit *base_commit;
@@ -448,11 +453,12 @@ static int real_merge(struct merge_tree_options *o,
 		if (!base_commit)
 			die(_("could not lookup commit %s"), merge_base);
 
-		opt.ancestor = merge_base;
+		opt->ancestor = merge_base;
 		base_tree = repo_get_commit_tree(the_repository, base_commit);
 		parent1_tree = repo_get_commit_tree(the_repository, parent1);
 		parent2_tree = repo_get_commit_tree(the_repository, parent2);
-		merge_incore_nonrecursive(&opt, base_tree, parent1_tree, parent2_tree, &result);
+		merge_incore_nonrecursive(opt, base_tree, parent1_tree, parent2_tree, result);
+		opt->ancestor = NULL;
 	} else {
 		/*
 		 * Get the merge bases, in reverse order; see comment above
@@ -463,24 +469,24 @@ static int real_merge(struct merge_tree_options *o,
 		if (!merge_bases && !o->allow_unrelated_histories)
 			die(_("refusing to merge unrelated histories"));
 		merge_bases = reverse_commit_list(merge_bases);
-		merge_incore_recursive(&opt, merge_bases, parent1, parent2, &result);
+		merge_incore_recursive(opt, merge_bases, parent1, parent2, result);
 	}
 
-	if (result.clean < 0)
+	if (result->clean < 0)
 		die(_("failure to merge"));
 
 	if (show_messages == -1)
-		show_messages = !result.clean;
+		show_messages = !result->clean;
 
 	if (o->use_stdin)
-		printf("%d%c", result.clean, line_termination);
-	printf("%s%c", oid_to_hex(&result.tree->object.oid), line_termination);
-	if (!result.clean) {
+		printf("%d%c", result->clean, line_termination);
+	printf("%s%c", oid_to_hex(&result->tree->object.oid), line_termination);
+	if (!result->clean) {
 		struct string_list conflicted_files = STRING_LIST_INIT_NODUP;
 		const char *last = NULL;
 		int i;
 
-		merge_get_conflicted_files(&result, &conflicted_files);
+		merge_get_conflicted_files(result, &conflicted_files);
 		for (i = 0; i < conflicted_files.nr; i++) {
 			const char *name = conflicted_files.items[i].string;
 			struct stage_info *c = conflicted_files.items[i].util;
@@ -497,13 +503,15 @@ static int real_merge(struct merge_tree_options *o,
 	}
 	if (show_messages) {
 		putchar(line_termination);
-		merge_display_update_messages(&opt, line_termination == '\0',
-					      &result);
+		merge_display_update_messages(opt, line_termination == '\0',
+					      result);
 	}
-	if (o->use_stdin)
+	if (o->use_stdin) {
 		putchar(line_termination);
-	merge_finalize(&opt, &result);
-	return !result.clean; /* result.clean < 0 handled above */
+		/* let whoever feeds us read the result before the next line */
+		maybe_flush_or_die(stdout, "stdout");
+	}
+	return !result->clean; /* result->clean < 0 handled above */
 }
 
 int cmd_merge_tree(int argc, const char **argv, const char *prefix)
@@ -555,15 +563,25 @@ int cmd_merge_tree(int argc, const char **argv, const char *prefix)
 	/* Handle --stdin */
 	if (o.use_stdin) {
 		struct strbuf buf = STRBUF_INIT;
+		struct merge_options opt;
+		struct merge_result result = { 0 };
 
 		if (o.mode == MODE_TRIVIAL)
 			die(_("--trivial-merge is incompatible with all other options"));
 		if (merge_base)
 			die(_("--merge-base is incompatible with --stdin"));
 		line_termination = '\0';
+
+		/*
+		 * Set up the merge once and carry the result of each merge
+		 * over to the next, so that merge-ort can reuse its memory
+		 * and, for merges into the same branch, its renames.
+		 */
+		init_merge_options(&opt, the_repository);
+		opt.show_rename_progress = 0;
 		while (strbuf_getline_lf(&buf, stdin) != EOF) {
 			struct strbuf **split;
-			int result;
+			int ret;
 			const char *input_merge_base = NULL;
 
 			split = strbuf_split(&buf, ' ');
@@ -580,17 +598,21 @@ int cmd_merge_tree(int argc, const char **argv, const char *prefix)
 			if (input_merge_base && split[2] && split[3] && !split[4]) {
 				strbuf_rtrim(split[2]);
 				strbuf_rtrim(split[3]);
-				result = real_merge(&o, input_merge_base, split[2]->buf, split[3]->buf, prefix);
+				ret = real_merge(&o, &opt, &result, input_merge_base,
+						 split[2]->buf, split[3]->buf, prefix);
 			} else if (!input_merge_base && !split[2]) {
-				result = real_merge(&o, NULL, split[0]->buf, split[1]->buf, prefix);
+				ret = real_merge(&o, &opt, &result, NULL,
+						 split[0]->buf, split[1]->buf, prefix);
 			} else {
 				die(_("malformed input line: '%s'."), buf.buf);
 			}
 
-			if (result < 0)
-				die(_("merging cannot continue; got unclean result of %d"), result);
+			if (ret < 0)
+				die(_("merging cannot continue; got unclean result of %d"), ret);
 			strbuf_list_free(split);
 		}
+		if (result.priv)
+			merge_finalize(&opt, &result);
 		strbuf_release(&buf);
 		return 0;
 	}
@@ -628,8 +650,17 @@ int cmd_merge_tree(int argc, const char **argv, const char *prefix)
 		usage_with_options(merge_tree_usage, mt_options);
 
 	/* Do the relevant type of merge */
-	if (o.mode == MODE_REAL)
-		return real_merge(&o, merge_base, argv[0], argv[1], prefix);
-	else
+	if (o.mode == MODE_REAL) {
+		struct merge_options opt;
+		struct merge_result result = { 0 };
+		int ret;
+
+		init_merge_options(&opt, the_repository);
+		opt.show_rename_progress = 0;
+		ret = real_merge(&o, &opt, &result, merge_base,
+				 argv[0], argv[1], prefix);
+		merge_finalize(&opt, &result);
+		return ret;
+	} else
 		return trivial_merge(argv[0], argv[1], argv[2]);
 }
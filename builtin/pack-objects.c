@@ -223,13 +223,18 @@ static int thin;
 static int num_preferred_base;
 static struct progress *progress_state;
 
-static struct packed_git *reuse_packfile;
+static struct bitmapped_pack *reuse_packfiles;
+static size_t reuse_packfiles_nr;
 static uint32_t reuse_packfile_objects;
 static struct bitmap *reuse_packfile_bitmap;
 
 static int use_bitmap_index_default = 1;
 static int use_bitmap_index = -1;
-static int allow_pack_reuse = 1;
+static enum {
+	NO_PACK_REUSE = 0,
+	SINGLE_PACK_REUSE,
+	MULTI_PACK_REUSE,
+} allow_pack_reuse = SINGLE_PACK_REUSE;
 static enum {
 	WRITE_BITMAP_FALSE = 0,
 	WRITE_BITMAP_QUIET,
@@ -1015,15 +1020,56 @@ static off_t find_reused_offset(off_t where)
 	return reused_chunks[lo-1].difference;
 }
 
-static void write_reused_pack_one(size_t pos, struct hashfile *out,
+static void reused_object_oid(struct packed_git *p, off_t offset,
+			      struct object_id *oid)
+{
+	uint32_t pos;
+
+	if (offset_to_pack_pos(p, offset, &pos) < 0)
+		die(_("expected object at offset %"PRIuMAX" "
+		      "in pack %s"),
+		    (uintmax_t)offset, p->pack_name);
+
+	nth_packed_object_id(oid, p, pack_pos_to_index(p, pos));
+}
+
+/*
+ * Return whether the copy of the object at 'base_offset' in 'pack' is
+ * the one selected by the MIDX, and so is sent from this pack, too.
+ */
+static int reused_base_in_pack(struct bitmapped_pack *pack, off_t base_offset)
+{
+	struct object_id base_oid;
+	uint32_t midx_pos;
+
+	if (pack->bitmap_nr == pack->p->num_objects)
+		return 1;
+
+	reused_object_oid(pack->p, base_offset, &base_oid);
+	if (!bsearch_midx(&base_oid, pack->from_midx, &midx_pos))
+		return 0;
+	return nth_midxed_pack_int_id(pack->from_midx, midx_pos) == pack->pack_int_id &&
+		nth_midxed_offset(pack->from_midx, midx_pos) == base_offset;
+}
+
+static void write_reused_pack_one(struct bitmapped_pack *pack,
+				  size_t pos, struct hashfile *out,
 				  struct pack_window **w_curs)
 {
+	struct packed_git *reuse_packfile = pack->p;
 	off_t offset, next, cur;
+	uint32_t pack_pos;
 	enum object_type type;
 	unsigned long size;
 
-	offset = pack_pos_to_offset(reuse_packfile, pos);
-	next = pack_pos_to_offset(reuse_packfile, pos + 1);
+	offset = bitmapped_pack_pos_to_offset(pack, pos);
+	if (pack->bitmap_nr == reuse_packfile->num_objects)
+		pack_pos = pos - pack->bitmap_pos;
+	else if (offset_to_pack_pos(reuse_packfile, offset, &pack_pos) < 0)
+		die(_("expected object at offset %"PRIuMAX" "
+		      "in pack %s"),
+		    (uintmax_t)offset, reuse_packfile->pack_name);
+	next = pack_pos_to_offset(reuse_packfile, pack_pos + 1);
 
 	record_reused_object(offset, offset - hashfile_total(out));
 
@@ -1041,19 +1087,14 @@ static void write_reused_pack_one(size_t pos, struct hashfile *out,
 		base_offset = get_delta_base(reuse_packfile, w_curs, &cur, type, offset);
 		assert(base_offset != 0);
 
-		/* Convert to REF_DELTA if we must... */
-		if (!allow_ofs_delta) {
-			uint32_t base_pos;
+		/*
+		 * Convert to REF_DELTA if we must, or if the base is sent
+		 * from another pack...
+		 */
+		if (!allow_ofs_delta || !reused_base_in_pack(pack, base_offset)) {
 			struct object_id base_oid;
 
-			if (offset_to_pack_pos(reuse_packfile, base_offset, &base_pos) < 0)
-				die(_("expected object at offset %"PRIuMAX" "
-				      "in pack %s"),
-				    (uintmax_t)base_offset,
-				    reuse_packfile->pack_name);
-
-			nth_packed_object_id(&base_oid, reuse_packfile,
-					     pack_pos_to_index(reuse_packfile, base_pos));
+			reused_object_oid(reuse_packfile, base_offset, &base_oid);
 
 			len = encode_in_pack_object_header(header, sizeof(header),
 							   OBJ_REF_DELTA, size);
@@ -1093,7 +1134,8 @@ static void write_reused_pack_one(size_t pos, struct hashfile *out,
 	copy_pack_data(out, reuse_packfile, w_curs, offset, next - offset);
 }
 
-static size_t write_reused_pack_verbatim(struct hashfile *out,
+static size_t write_reused_pack_verbatim(struct bitmapped_pack *pack,
+					 struct hashfile *out,
 					 struct pack_window **w_curs)
 {
 	size_t pos = 0;
@@ -1106,13 +1148,13 @@ static size_t write_reused_pack_verbatim(struct hashfile *out,
 		off_t to_write;
 
 		written = (pos * BITS_IN_EWORD);
-		to_write = pack_pos_to_offset(reuse_packfile, written)
+		to_write = pack_pos_to_offset(pack->p, written)
 			- sizeof(struct pack_header);
 
 		/* We're recording one chunk, not one object. */
 		record_reused_object(sizeof(struct pack_header), 0);
 		hashflush(out);
-		copy_pack_data(out, reuse_packfile, w_curs,
+		copy_pack_data(out, pack->p, w_curs,
 			sizeof(struct pack_header), to_write);
 
 		display_progress(progress_state, written);
@@ -1120,30 +1162,41 @@ static size_t write_reused_pack_verbatim(struct hashfile *out,
 	return pos;
 }
 
-static void write_reused_pack(struct hashfile *f)
+static void write_reused_pack(struct bitmapped_pack *pack,
+			      struct hashfile *f)
 {
-	size_t i = 0;
+	size_t i = pack->bitmap_pos / BITS_IN_EWORD;
+	size_t end = pack->bitmap_pos + pack->bitmap_nr;
 	uint32_t offset;
 	struct pack_window *w_curs = NULL;
 
-	if (allow_ofs_delta)
-		i = write_reused_pack_verbatim(f, &w_curs);
+	/*
+	 * Offsets are only ever adjusted relative to other objects from
+	 * the same pack, so start over with each pack.
+	 */
+	reused_chunks_nr = 0;
+
+	if (!pack->bitmap_pos && allow_ofs_delta)
+		i = write_reused_pack_verbatim(pack, f, &w_curs);
 
 	for (; i < reuse_packfile_bitmap->word_alloc; ++i) {
 		eword_t word = reuse_packfile_bitmap->words[i];
 		size_t pos = (i * BITS_IN_EWORD);
 
+		if (pos >= end)
+			break;
+
 		for (offset = 0; offset < BITS_IN_EWORD; ++offset) {
 			if ((word >> offset) == 0)
 				break;
 
 			offset += ewah_bit_ctz64(word >> offset);
-			/*
-			 * Can use bit positions directly, even for MIDX
-			 * bitmaps. See comment in try_partial_reuse()
-			 * for why.
-			 */
-			write_reused_pack_one(pos + offset, f, &w_curs);
+			if (pos + offset < pack->bitmap_pos)
+				continue;
+			if (pos + offset >= end)
+				break;
+
+			write_reused_pack_one(pack, pos + offset, f, &w_curs);
 			display_progress(progress_state, ++written);
 		}
 	}
@@ -1170,6 +1223,34 @@ static void write_excluded_by_configs(void)
 	}
 }
 
+/*
+ * Objects reused verbatim from bitmapped packs are written before all
+ * others, and both they and the total number of objects are known as
+ * soon as counting is done. When writing to stdout, send the header
+ * and that region right away, so that the reader does not have to wait
+ * for the delta search to finish before seeing any pack data.
+ */
+static struct hashfile *streamed_pack;
+
+static void stream_reused_packs(void)
+{
+	size_t j;
+
+	if (!pack_to_stdout || !reuse_packfiles_nr || !nr_result)
+		return;
+
+	trace2_region_enter("pack-objects", "stream-reused-packs",
+			    the_repository);
+	/* progress is attached once write_pack_file() starts it */
+	streamed_pack = hashfd_throughput(1, "<stdout>", NULL);
+	write_pack_header(streamed_pack, nr_result);
+	for (j = 0; j < reuse_packfiles_nr; j++)
+		write_reused_pack(&reuse_packfiles[j], streamed_pack);
+	hashflush(streamed_pack);
+	trace2_region_leave("pack-objects", "stream-reused-packs",
+			    the_repository);
+}
+
 static const char no_split_warning[] = N_(
 "disabling bitmap writing, packs are split due to pack.packSizeLimit"
 );
@@ -1192,17 +1273,29 @@ static void write_pack_file(void)
 		unsigned char hash[GIT_MAX_RAWSZ];
 		char *pack_tmp_name = NULL;
 
-		if (pack_to_stdout)
-			f = hashfd_throughput(1, "<stdout>", progress_state);
-		else
-			f = create_tmp_packfile(&pack_tmp_name);
+		if (streamed_pack) {
+			/* header and reused objects are already out */
+			f = streamed_pack;
+			hashfile_set_progress(f, progress_state);
+			streamed_pack = NULL;
+			offset = hashfile_total(f);
+			display_progress(progress_state, written);
+		} else {
+			if (pack_to_stdout)
+				f = hashfd_throughput(1, "<stdout>", progress_state);
+			else
+				f = create_tmp_packfile(&pack_tmp_name);
 
-		offset = write_pack_header(f, nr_remaining);
+			offset = write_pack_header(f, nr_remaining);
 
-		if (reuse_packfile) {
-			assert(pack_to_stdout);
-			write_reused_pack(f);
-			offset = hashfile_total(f);
+			if (reuse_packfiles_nr) {
+				size_t j;
+
+				assert(pack_to_stdout);
+				for (j = 0; j < reuse_packfiles_nr; j++)
+					write_reused_pack(&reuse_packfiles[j], f);
+				offset = hashfile_total(f);
+			}
 		}
 
 		nr_written = 0;
@@ -3176,7 +3269,19 @@ static int git_pack_config(const char *k, const char *v, void *cb)
 		return 0;
 	}
 	if (!strcmp(k, "pack.allowpackreuse")) {
-		allow_pack_reuse = git_config_bool(k, v);
+		int res = git_parse_maybe_bool(v);
+		if (res < 0) {
+			if (!strcasecmp(v, "single"))
+				allow_pack_reuse = SINGLE_PACK_REUSE;
+			else if (!strcasecmp(v, "multi"))
+				allow_pack_reuse = MULTI_PACK_REUSE;
+			else
+				die(_("invalid pack.allowPackReuse value: '%s'"), v);
+		} else if (res) {
+			allow_pack_reuse = SINGLE_PACK_REUSE;
+		} else {
+			allow_pack_reuse = NO_PACK_REUSE;
+		}
 		return 0;
 	}
 	if (!strcmp(k, "pack.threads")) {
@@ -3948,13 +4053,20 @@ static int get_object_list_from_bitmap(struct rev_info *revs)
 	if (pack_options_allow_reuse() &&
 	    !reuse_partial_packfile_from_bitmap(
 			bitmap_git,
-			&reuse_packfile,
+			&reuse_packfiles,
+			&reuse_packfiles_nr,
 			&reuse_packfile_objects,
-			&reuse_packfile_bitmap)) {
+			&reuse_packfile_bitmap,
+			allow_pack_reuse == MULTI_PACK_REUSE)) {
 		assert(reuse_packfile_objects);
 		nr_result += reuse_packfile_objects;
 		nr_seen += reuse_packfile_objects;
 		display_progress(progress_state, nr_seen);
+
+		trace2_data_intmax("pack-objects", the_repository,
+				   "pack-reused", reuse_packfile_objects);
+		trace2_data_intmax("pack-objects", the_repository,
+				   "packs-reused", reuse_packfiles_nr);
 	}
 
 	traverse_bitmap_commit_list(bitmap_git, revs,
@@ -4491,6 +4603,14 @@ int cmd_pack_objects(int argc, const char **argv, const char *prefix)
 
 	if (non_empty && !nr_result)
 		goto cleanup;
+
+	/*
+	 * Any packfile-uri lines must precede the pack data, and all
+	 * exclusions have been found by now.
+	 */
+	write_excluded_by_configs();
+	stream_reused_packs();
+
 	if (nr_result) {
 		trace2_region_enter("pack-objects", "prepare-pack",
 				    the_repository);
@@ -4500,7 +4620,6 @@ int cmd_pack_objects(int argc, const char **argv, const char *prefix)
 	}
 
 	trace2_region_enter("pack-objects", "write-pack-file", the_repository);
-	write_excluded_by_configs();
 	write_pack_file();
 	trace2_region_leave("pack-objects", "write-pack-file", the_repository);
 
@@ -14,6 +14,7 @@
 #include "strbuf.h"
 #include "string-list.h"
 #include "tmp-objdir.h"
+#include "trace2.h"
 #include "packfile.h"
 #include "object-file.h"
 #include "object-store.h"
@@ -23,6 +24,15 @@ static int odb_transaction_nesting;
 
 static struct tmp_objdir *bulk_fsync_objdir;
 
+/*
+ * Set when loose objects are written straight into a quarantine (see
+ * tmp_objdir_create()) during a transaction.  Nobody can see them
+ * there until the quarantine is migrated, so there is no need for a
+ * temporary object directory of our own, nor for a second round of
+ * renames; the hardware flush just has to happen before we are done.
+ */
+static int bulk_fsync_quarantine;
+
 static struct bulk_checkin_packfile {
 	char *pack_tmp_name;
 	struct hashfile *f;
@@ -99,7 +109,7 @@ static void flush_batch_fsync(void)
 	struct strbuf temp_path = STRBUF_INIT;
 	struct tempfile *temp;
 
-	if (!bulk_fsync_objdir)
+	if (!bulk_fsync_objdir && !bulk_fsync_quarantine)
 		return;
 
 	/*
@@ -117,6 +127,11 @@ static void flush_batch_fsync(void)
 	delete_tempfile(&temp);
 	strbuf_release(&temp_path);
 
+	if (bulk_fsync_quarantine) {
+		bulk_fsync_quarantine = 0;
+		return;
+	}
+
 	/*
 	 * Make the object files visible in the primary ODB after their data is
 	 * fully durable.
@@ -327,12 +342,26 @@ void prepare_loose_object_bulk_checkin(void)
 	 * callers may not know whether any objects will be
 	 * added at the time they call begin_odb_transaction.
 	 */
-	if (!odb_transaction_nesting || bulk_fsync_objdir)
+	const char *quarantine;
+
+	if (!odb_transaction_nesting || bulk_fsync_objdir ||
+	    bulk_fsync_quarantine)
 		return;
 
+	quarantine = getenv(GIT_QUARANTINE_ENVIRONMENT);
+	if (quarantine && !strcmp(quarantine, get_object_directory())) {
+		bulk_fsync_quarantine = 1;
+		trace2_data_string("bulk-checkin", the_repository,
+				   "loose-objects", "quarantine");
+		return;
+	}
+
 	bulk_fsync_objdir = tmp_objdir_create("bulk-fsync");
-	if (bulk_fsync_objdir)
+	if (bulk_fsync_objdir) {
 		tmp_objdir_replace_primary_odb(bulk_fsync_objdir, 0);
+		trace2_data_string("bulk-checkin", the_repository,
+				   "loose-objects", "tmp-objdir");
+	}
 }
 
 void fsync_loose_object_bulk_checkin(int fd, const char *filename)
@@ -344,7 +373,7 @@ void fsync_loose_object_bulk_checkin(int fd, const char *filename)
 	 * before renaming the objects to their final names as part of
 	 * flush_batch_fsync.
 	 */
-	if (!bulk_fsync_objdir ||
+	if ((!bulk_fsync_objdir && !bulk_fsync_quarantine) ||
 	    git_fsync(fd, FSYNC_WRITEOUT_ONLY) < 0) {
 		if (errno == ENOSYS)
 			warning(_("core.fsyncMethod = batch is unsupported on this platform"));
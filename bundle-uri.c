@@ -9,7 +9,12 @@
 #include "hashmap.h"
 #include "pkt-line.h"
 #include "config.h"
+#include "credential.h"
 #include "remote.h"
+#include "sigchain.h"
+#include "thread-utils.h"
+#include "trace2.h"
+#include "wrapper.h"
 
 static struct {
 	enum bundle_list_heuristic heuristic;
@@ -352,6 +357,177 @@ static int copy_uri_to_file(const char *filename, const char *uri)
 	return copy_file(filename, uri, 0);
 }
 
+static void forget_download_ahead(struct remote_bundle_info *bundle)
+{
+	unlink(bundle->file);
+	FREE_AND_NULL(bundle->file);
+}
+
+/*
+ * Download the given bundles, which all live on the same host, with a
+ * single git-remote-https as one batch of "get-batch" commands. It
+ * downloads "jobs" of them at a time, over a single connection when the
+ * server speaks HTTP/2. Failed downloads are forgotten.
+ */
+static void download_bundle_batch(struct repository *r,
+				  struct remote_bundle_info **bundles,
+				  size_t nr, int jobs)
+{
+	struct child_process cp = CHILD_PROCESS_INIT;
+	struct strbuf cmd = STRBUF_INIT, line = STRBUF_INIT;
+	struct remote_bundle_info **todo;
+	FILE *child_in = NULL, *child_out = NULL;
+	size_t i, todo_nr = 0;
+	int found_get_batch = 0;
+
+	ALLOC_ARRAY(todo, nr);
+	for (i = 0; i < nr; i++) {
+		struct remote_bundle_info *bundle = bundles[i];
+
+		if (!(bundle->file = find_temp_filename()))
+			continue;
+
+		strbuf_addf(&cmd, "get-batch %s %s\n", bundle->uri, bundle->file);
+		todo[todo_nr++] = bundle;
+	}
+	if (todo_nr < 2)
+		goto cleanup;
+	strbuf_addch(&cmd, '\n');
+
+	trace2_region_enter("bundle-uri", "download", r);
+	strvec_pushl(&cp.args, "git-remote-https", todo[0]->uri, NULL);
+	strvec_pushf(&cp.env, "GIT_HTTP_MAX_REQUESTS=%d", jobs);
+	cp.in = -1;
+	cp.out = -1;
+	/*
+	 * A failed download is retried, and reported, when needed. Like
+	 * download_https_uri_to_file(), ignore what the helper said, and
+	 * keep the files that it did download even if it failed.
+	 */
+	cp.no_stderr = 1;
+
+	if (start_command(&cp))
+		goto done;
+	child_in = xfdopen(cp.in, "w");
+	child_out = xfdopen(cp.out, "r");
+
+	fprintf(child_in, "capabilities\n");
+	fflush(child_in);
+	while (!strbuf_getline(&line, child_out)) {
+		if (!line.len)
+			break;
+		if (!strcmp(line.buf, "get-batch"))
+			found_get_batch = 1;
+	}
+
+	/* Without it, the bundles are downloaded one at a time later. */
+	if (found_get_batch) {
+		sigchain_push(SIGPIPE, SIG_IGN);
+		fwrite(cmd.buf, 1, cmd.len, child_in);
+		fflush(child_in);
+		/* Wait for the blank line that ends the batch, or EOF */
+		strbuf_getline(&line, child_out);
+		sigchain_pop(SIGPIPE);
+	}
+	fclose(child_in);
+	fclose(child_out);
+	finish_command(&cp);
+done:
+	trace2_region_leave("bundle-uri", "download", r);
+
+cleanup:
+	for (i = 0; i < todo_nr; i++) {
+		if (file_exists(todo[i]->file))
+			todo[i]->downloaded_ahead = 1;
+		else
+			forget_download_ahead(todo[i]);
+	}
+	free(todo);
+	strbuf_release(&cmd);
+	strbuf_release(&line);
+}
+
+/* Return "<scheme>://<host>[:<port>]" of an URL, or NULL. */
+static char *url_origin(const char *url)
+{
+	struct credential c = CREDENTIAL_INIT;
+	char *origin = NULL;
+
+	if (!credential_from_url_gently(&c, url, 1) && c.protocol && c.host)
+		origin = xstrfmt("%s://%s", c.protocol, c.host);
+	credential_clear(&c);
+	return origin;
+}
+
+/*
+ * Download the given bundles over HTTP(S) ahead of time, so that
+ * fetch_bundle_uri_internal() finds them already downloaded. The
+ * bundles are grouped by host, and each group is downloaded as one
+ * batch. A helper only ever asks for credentials for the host it was
+ * started for, so a batch never mixes hosts: the bundle list comes
+ * from the server, and must not be able to send the credentials for
+ * one host to another.
+ */
+static void download_bundles_ahead(struct repository *r,
+				   struct remote_bundle_info **bundles,
+				   size_t nr)
+{
+	struct remote_bundle_info **candidates, **batch;
+	char **origins;
+	size_t i, j, candidates_nr = 0;
+	int jobs = 1;
+
+	if (repo_config_get_int(r, "fetch.bundleparallel", &jobs))
+		return;
+	if (jobs < 0)
+		die(_("fetch.bundleParallel cannot be negative"));
+	if (!jobs)
+		jobs = online_cpus();
+	if (jobs < 2 || nr < 2)
+		return;
+
+	ALLOC_ARRAY(candidates, nr);
+	ALLOC_ARRAY(origins, nr);
+	for (i = 0; i < nr; i++) {
+		struct remote_bundle_info *bundle = bundles[i];
+		char *origin;
+
+		/* Local copies are cheap enough to be left for later. */
+		if (bundle->file || !bundle->uri ||
+		    !(starts_with(bundle->uri, "https:") ||
+		      starts_with(bundle->uri, "http:")) ||
+		    !(origin = url_origin(bundle->uri)))
+			continue;
+
+		origins[candidates_nr] = origin;
+		candidates[candidates_nr++] = bundle;
+	}
+
+	ALLOC_ARRAY(batch, candidates_nr);
+	for (i = 0; i < candidates_nr; i++) {
+		size_t batch_nr = 0;
+
+		if (!origins[i])
+			continue; /* already in an earlier batch */
+		for (j = i; j < candidates_nr; j++) {
+			if (j > i &&
+			    (!origins[j] || strcasecmp(origins[i], origins[j])))
+				continue;
+			batch[batch_nr++] = candidates[j];
+			if (j > i)
+				FREE_AND_NULL(origins[j]);
+		}
+		FREE_AND_NULL(origins[i]);
+
+		if (batch_nr >= 2)
+			download_bundle_batch(r, batch, batch_nr, jobs);
+	}
+
+	free(batch);
+	free(origins);
+	free(candidates);
+}
+
 static int unbundle_from_file(struct repository *r, const char *file)
 {
 	int result = 0;
@@ -549,13 +725,25 @@ static int fetch_bundles_by_token(struct repository *r,
 		if (bundle->creationToken <= maxCreationToken)
 			break;
 
-		if (!bundle->file) {
+		if (!bundle->file || bundle->downloaded_ahead) {
 			/*
 			 * Not downloaded yet. Try downloading.
 			 *
 			 * Note that bundle->file is non-NULL if a download
 			 * was attempted, even if it failed to download.
 			 */
+			if (!bundle->file) {
+				size_t nr = 1;
+
+				/*
+				 * Download the next bundles we are likely
+				 * to dig into as well.
+				 */
+				while (cur + nr < bundles.nr &&
+				       bundles.items[cur + nr]->creationToken > maxCreationToken)
+					nr++;
+				download_bundles_ahead(r, bundles.items + cur, nr);
+			}
 			if (fetch_bundle_uri_internal(ctx.r, bundle, ctx.depth + 1, ctx.list)) {
 				/* Mark as unbundled so we do not retry. */
 				bundle->unbundled = 1;
@@ -638,6 +826,21 @@ static int download_bundle_list(struct repository *r,
 		.mode = local_list->mode,
 	};
 
+	/*
+	 * All of the bundles are needed in BUNDLE_MODE_ALL, so they can
+	 * be downloaded at the same time.
+	 */
+	if (local_list->mode == BUNDLE_MODE_ALL) {
+		struct bundles_for_sorting bundles = {
+			.alloc = hashmap_get_size(&local_list->bundles),
+		};
+
+		ALLOC_ARRAY(bundles.items, bundles.alloc);
+		for_all_bundles_in_list(local_list, append_bundle, &bundles);
+		download_bundles_ahead(r, bundles.items, bundles.nr);
+		free(bundles.items);
+	}
+
 	return for_all_bundles_in_list(local_list, download_bundle_to_file, &ctx);
 }
 
@@ -712,7 +915,9 @@ static int fetch_bundle_uri_internal(struct repository *r,
 		goto cleanup;
 	}
 
-	if ((result = copy_uri_to_file(bundle->file, bundle->uri))) {
+	if (bundle->downloaded_ahead)
+		bundle->downloaded_ahead = 0;
+	else if ((result = copy_uri_to_file(bundle->file, bundle->uri))) {
 		warning(_("failed to download bundle from URI '%s'"), bundle->uri);
 		goto cleanup;
 	}
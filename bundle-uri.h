@@ -43,6 +43,13 @@ struct remote_bundle_info {
 	 */
 	unsigned unbundled:1;
 
+	/**
+	 * If 'file' was downloaded ahead of time, in parallel with other
+	 * bundles, then this boolean is true until the download is
+	 * taken into account.
+	 */
+	unsigned downloaded_ahead:1;
+
 	/**
 	 * If the bundle is part of a list with the creationToken
 	 * heuristic, then we use this member for sorting the bundles.
@@ -50,6 +50,7 @@ void git_test_write_commit_graph_or_die(void)
 #define GRAPH_CHUNKID_BLOOMINDEXES 0x42494458 /* "BIDX" */
 #define GRAPH_CHUNKID_BLOOMDATA 0x42444154 /* "BDAT" */
 #define GRAPH_CHUNKID_BASE 0x42415345 /* "BASE" */
+#define GRAPH_CHUNKID_FIRST_PARENT_JUMPS 0x46504a50 /* "FPJP" */
 
 #define GRAPH_DATA_WIDTH (the_hash_algo->rawsz + 16)
 
@@ -205,7 +206,7 @@ static struct commit_graph *alloc_commit_graph(void)
 
 extern int read_replace_refs;
 
-static int commit_graph_compatible(struct repository *r)
+int commit_graph_compatible(struct repository *r)
 {
 	if (!r->gitdir)
 		return 0;
@@ -391,6 +392,8 @@ struct commit_graph *parse_commit_graph(struct repo_settings *s,
 	pair_chunk(cf, GRAPH_CHUNKID_DATA, &graph->chunk_commit_data);
 	pair_chunk(cf, GRAPH_CHUNKID_EXTRAEDGES, &graph->chunk_extra_edges);
 	pair_chunk(cf, GRAPH_CHUNKID_BASE, &graph->chunk_base_graphs);
+	pair_chunk(cf, GRAPH_CHUNKID_FIRST_PARENT_JUMPS,
+		   &graph->chunk_first_parent_jumps);
 
 	if (s->commit_graph_generation_version >= 2) {
 		pair_chunk(cf, GRAPH_CHUNKID_GENERATION_DATA,
@@ -899,6 +902,89 @@ int repo_find_commit_pos_in_graph(struct repository *r, struct commit *c,
 	return find_commit_pos_in_graph(c, r->objects->commit_graph, pos);
 }
 
+/*
+ * Read the first-parent depth and jump pointer of the commit at graph
+ * position "pos".  Returns -1 if the layer holding it has no
+ * first-parent jump chunk.
+ */
+static int first_parent_jump_at(struct commit_graph *g, uint32_t pos,
+				uint32_t *depth, uint32_t *jump)
+{
+	const unsigned char *data;
+
+	while (g && pos < g->num_commits_in_base)
+		g = g->base_graph;
+	if (!g || pos >= g->num_commits + g->num_commits_in_base)
+		die(_("invalid commit position. commit-graph is likely corrupt"));
+	if (!g->chunk_first_parent_jumps)
+		return -1;
+
+	data = g->chunk_first_parent_jumps +
+		2 * sizeof(uint32_t) * (pos - g->num_commits_in_base);
+	*depth = get_be32(data);
+	*jump = get_be32(data + sizeof(uint32_t));
+	return 0;
+}
+
+static uint32_t first_parent_pos(struct commit_graph *g, uint32_t pos)
+{
+	while (pos < g->num_commits_in_base)
+		g = g->base_graph;
+	return get_be32(g->chunk_commit_data + g->hash_len +
+			GRAPH_DATA_WIDTH * (pos - g->num_commits_in_base));
+}
+
+int first_parent_ancestor_in_graph(struct repository *r, struct commit *c,
+				   uint32_t n, struct commit **result)
+{
+	struct commit_graph *g;
+	struct commit *ancestor;
+	struct object_id oid;
+	uint32_t pos, depth, jump, target;
+
+	if (!repo_find_commit_pos_in_graph(r, c, &pos))
+		return -1;
+	g = r->objects->commit_graph;
+	if (first_parent_jump_at(g, pos, &depth, &jump))
+		return -1;
+
+	if (n > depth) {
+		*result = NULL;
+		return 0;
+	}
+
+	/*
+	 * Jump pointers skip over whole blocks of ancestors in the
+	 * skew-binary pattern; take a jump whenever it does not
+	 * overshoot, otherwise step to the first parent.
+	 */
+	target = depth - n;
+	while (depth > target) {
+		uint32_t jump_depth, jump_jump;
+
+		if (first_parent_jump_at(g, jump, &jump_depth, &jump_jump))
+			return -1;
+		if (jump_depth >= target) {
+			pos = jump;
+			depth = jump_depth;
+			jump = jump_jump;
+			continue;
+		}
+
+		pos = first_parent_pos(g, pos);
+		if (pos == GRAPH_PARENT_NONE ||
+		    first_parent_jump_at(g, pos, &depth, &jump))
+			return -1;
+	}
+
+	load_oid_from_graph(g, pos, &oid);
+	ancestor = lookup_commit(r, &oid);
+	if (!ancestor)
+		return -1;
+	*result = ancestor;
+	return 0;
+}
+
 struct commit *lookup_commit_in_graph(struct repository *repo, const struct object_id *id)
 {
 	struct commit *commit;
@@ -1031,8 +1117,12 @@ struct write_commit_graph_context {
 		 changed_paths:1,
 		 order_by_pack:1,
 		 write_generation_data:1,
+		 write_first_parent_jumps:1,
 		 trust_generation_numbers:1;
 
+	/* depth and jump position for each of commits.list */
+	uint32_t *first_parent_jumps;
+
 	struct topo_level_slab *topo_levels;
 	const struct commit_graph_opts *opts;
 	size_t total_bloom_filter_data_size;
@@ -1237,6 +1327,21 @@ static int write_graph_chunk_generation_data_overflow(struct hashfile *f,
 	return 0;
 }
 
+static int write_graph_chunk_first_parent_jumps(struct hashfile *f,
+						void *data)
+{
+	struct write_commit_graph_context *ctx = data;
+	size_t i;
+
+	for (i = 0; i < ctx->commits.nr; i++) {
+		display_progress(ctx->progress, ++ctx->progress_cnt);
+		hashwrite_be32(f, ctx->first_parent_jumps[2 * i]);
+		hashwrite_be32(f, ctx->first_parent_jumps[2 * i + 1]);
+	}
+
+	return 0;
+}
+
 static int write_graph_chunk_extra_edges(struct hashfile *f,
 					 void *data)
 {
@@ -1650,6 +1755,105 @@ static void trace2_bloom_filter_write_statistics(struct write_commit_graph_conte
 			   ctx->count_bloom_filter_trunc_large);
 }
 
+static int graph_pos_for_write(struct write_commit_graph_context *ctx,
+			       struct commit *c, uint32_t *pos)
+{
+	int index = oid_pos(&c->object.oid, ctx->commits.list,
+			    ctx->commits.nr, commit_to_oid);
+
+	if (index >= 0) {
+		*pos = index + ctx->new_num_commits_in_base;
+		return 0;
+	}
+	if (ctx->new_base_graph &&
+	    find_commit_pos_in_graph(c, ctx->new_base_graph, pos))
+		return 0;
+	return -1;
+}
+
+static void first_parent_jump_for_write(struct write_commit_graph_context *ctx,
+					uint32_t pos,
+					uint32_t *depth, uint32_t *jump)
+{
+	if (pos >= ctx->new_num_commits_in_base) {
+		uint32_t *entry = ctx->first_parent_jumps +
+			2 * (pos - ctx->new_num_commits_in_base);
+		*depth = entry[0];
+		*jump = entry[1];
+	} else if (first_parent_jump_at(ctx->new_base_graph, pos, depth, jump))
+		BUG("base commit-graph lost its first-parent jumps");
+}
+
+/*
+ * Every commit gets its first-parent depth and a single jump pointer
+ * to a first-parent ancestor, chosen so that the distances form a
+ * skew-binary pattern: if the parent's jump covers the same distance
+ * as the jump after it, we jump over both, otherwise just to the
+ * parent.  Any ancestor is then reachable in O(log depth) steps.
+ */
+static void compute_first_parent_jumps(struct write_commit_graph_context *ctx)
+{
+	struct commit_list *stack = NULL;
+	uint32_t base = ctx->new_num_commits_in_base;
+	size_t i;
+
+	ALLOC_ARRAY(ctx->first_parent_jumps, 2 * ctx->commits.nr);
+	for (i = 0; i < ctx->commits.nr; i++)
+		ctx->first_parent_jumps[2 * i + 1] = GRAPH_PARENT_NONE;
+
+	if (ctx->report_progress)
+		ctx->progress = start_delayed_progress(
+					_("Computing commit graph first-parent jumps"),
+					ctx->commits.nr);
+	for (i = 0; i < ctx->commits.nr; i++) {
+		display_progress(ctx->progress, i + 1);
+		if (ctx->first_parent_jumps[2 * i + 1] != GRAPH_PARENT_NONE)
+			continue;
+
+		commit_list_insert(ctx->commits.list[i], &stack);
+		while (stack) {
+			struct commit *c = stack->item;
+			uint32_t pos, parent, depth, jump, jump_depth, jump_jump;
+			uint32_t jump_jump_depth, unused;
+			uint32_t *entry;
+
+			if (graph_pos_for_write(ctx, c, &pos) || pos < base)
+				BUG("commit %s vanished from the commit-graph",
+				    oid_to_hex(&c->object.oid));
+			entry = ctx->first_parent_jumps + 2 * (pos - base);
+
+			if (!c->parents) {
+				entry[0] = 0;
+				entry[1] = pos;
+				pop_commit(&stack);
+				continue;
+			}
+
+			if (graph_pos_for_write(ctx, c->parents->item, &parent))
+				BUG("missing parent %s for commit %s",
+				    oid_to_hex(&c->parents->item->object.oid),
+				    oid_to_hex(&c->object.oid));
+			if (parent >= base &&
+			    ctx->first_parent_jumps[2 * (parent - base) + 1] == GRAPH_PARENT_NONE) {
+				commit_list_insert(c->parents->item, &stack);
+				continue;
+			}
+
+			first_parent_jump_for_write(ctx, parent, &depth, &jump);
+			first_parent_jump_for_write(ctx, jump, &jump_depth, &jump_jump);
+			first_parent_jump_for_write(ctx, jump_jump, &jump_jump_depth, &unused);
+
+			entry[0] = depth + 1;
+			if (depth - jump_depth == jump_depth - jump_jump_depth)
+				entry[1] = jump_jump;
+			else
+				entry[1] = parent;
+			pop_commit(&stack);
+		}
+	}
+	stop_progress(&ctx->progress);
+}
+
 static void compute_bloom_filters(struct write_commit_graph_context *ctx)
 {
 	int i;
@@ -1978,6 +2182,10 @@ static int write_commit_graph_file(struct write_commit_graph_context *ctx)
 				+ ctx->total_bloom_filter_data_size,
 			  write_graph_chunk_bloom_data);
 	}
+	if (ctx->write_first_parent_jumps)
+		add_chunk(cf, GRAPH_CHUNKID_FIRST_PARENT_JUMPS,
+			  2 * sizeof(uint32_t) * ctx->commits.nr,
+			  write_graph_chunk_first_parent_jumps);
 	if (ctx->num_commit_graphs_after > 1)
 		add_chunk(cf, GRAPH_CHUNKID_BASE,
 			  hashsz * (ctx->num_commit_graphs_after - 1),
@@ -2350,6 +2558,7 @@ int write_commit_graph(struct object_directory *odb,
 	uint32_t i;
 	int res = 0;
 	int replace = 0;
+	int first_parent_jumps;
 	struct bloom_filter_settings bloom_settings = DEFAULT_BLOOM_FILTER_SETTINGS;
 	struct topo_level_slab topo_levels;
 
@@ -2407,6 +2616,14 @@ int write_commit_graph(struct object_directory *odb,
 		}
 	}
 
+	if (repo_config_get_bool(r, "commitgraph.firstparentjumps",
+				 &first_parent_jumps)) {
+		/* Keep first-parent jumps if the existing graph has them */
+		struct commit_graph *g = ctx->r->objects->commit_graph;
+		first_parent_jumps = g && g->chunk_first_parent_jumps;
+	}
+	ctx->write_first_parent_jumps = !!first_parent_jumps;
+
 	if (ctx->split) {
 		struct commit_graph *g = ctx->r->objects->commit_graph;
 
@@ -2487,6 +2704,17 @@ int write_commit_graph(struct object_directory *odb,
 	if (ctx->changed_paths)
 		compute_bloom_filters(ctx);
 
+	if (ctx->write_first_parent_jumps) {
+		struct commit_graph *g;
+
+		/* Jumps into a base layer need that layer's jumps, too */
+		for (g = ctx->new_base_graph; g; g = g->base_graph)
+			if (!g->chunk_first_parent_jumps)
+				ctx->write_first_parent_jumps = 0;
+	}
+	if (ctx->write_first_parent_jumps)
+		compute_first_parent_jumps(ctx);
+
 	res = write_commit_graph_file(ctx);
 
 	if (ctx->split)
@@ -2497,6 +2725,7 @@ int write_commit_graph(struct object_directory *odb,
 cleanup:
 	free(ctx->graph_name);
 	free(ctx->commits.list);
+	free(ctx->first_parent_jumps);
 	oid_array_clear(&ctx->oids);
 	clear_topo_level_slab(&topo_levels);
 
@@ -2663,6 +2892,29 @@ int verify_commit_graph(struct repository *r, struct commit_graph *g, int flags)
 			graph_report(_("commit-graph parent list for commit %s terminates early"),
 				     oid_to_hex(&cur_oid));
 
+		if (g->chunk_first_parent_jumps) {
+			uint32_t pos = i + g->num_commits_in_base;
+			uint32_t parent = first_parent_pos(g, pos);
+			uint32_t depth, jump, parent_depth = 0, jump_depth, unused;
+			int bad_jump = 0;
+
+			first_parent_jump_at(g, pos, &depth, &jump);
+			if (parent != GRAPH_PARENT_NONE &&
+			    !first_parent_jump_at(g, parent, &parent_depth, &unused))
+				parent_depth++;
+			if (depth != parent_depth)
+				graph_report(_("commit-graph first-parent depth for commit %s is %"PRIu32" != %"PRIu32),
+					     oid_to_hex(&cur_oid), depth, parent_depth);
+
+			if (jump >= g->num_commits + g->num_commits_in_base)
+				bad_jump = 1;
+			else if (!first_parent_jump_at(g, jump, &jump_depth, &unused))
+				bad_jump = depth ? jump_depth >= depth : jump != pos;
+			if (bad_jump)
+				graph_report(_("commit-graph first-parent jump for commit %s is invalid"),
+					     oid_to_hex(&cur_oid));
+		}
+
 		if (!commit_graph_generation(graph_commit)) {
 			if (generation_zero == GENERATION_NUMBER_EXISTS)
 				graph_report(_("commit-graph has generation number zero for commit %s, but non-zero elsewhere"),
@@ -62,6 +62,17 @@ int repo_find_commit_pos_in_graph(struct repository *r, struct commit *c,
  */
 struct commit *lookup_commit_in_graph(struct repository *repo, const struct object_id *id);
 
+/*
+ * Find the n-th first-parent ancestor of `c` (i.e. `c~n`) using the
+ * first-parent jump pointers stored in the commit-graph, taking
+ * O(log n) steps.  On success returns 0 and sets `*result`, which is
+ * NULL if `c` has fewer than `n` first-parent ancestors.  Returns -1
+ * if the commit-graph cannot answer, in which case the caller should
+ * walk the parents itself.
+ */
+int first_parent_ancestor_in_graph(struct repository *r, struct commit *c,
+				   uint32_t n, struct commit **result);
+
 /*
  * It is possible that we loaded commit contents from the commit buffer,
  * but we also want to ensure the commit-graph content is correctly
@@ -97,6 +108,7 @@ struct commit_graph {
 	const unsigned char *chunk_base_graphs;
 	const unsigned char *chunk_bloom_indexes;
 	const unsigned char *chunk_bloom_data;
+	const unsigned char *chunk_first_parent_jumps;
 
 	struct topo_level_slab *topo_levels;
 	struct bloom_filter_settings *bloom_filter_settings;
@@ -115,6 +127,13 @@ struct commit_graph *read_commit_graph_one(struct repository *r,
 struct commit_graph *parse_commit_graph(struct repo_settings *s,
 					void *graph_map, size_t graph_size);
 
+/*
+ * Return 1 if and only if the commit history of the repository is not
+ * altered by replace objects, grafts or shallow boundaries, i.e. if
+ * precomputed reachability data (commit-graphs, bitmaps) can be trusted.
+ */
+int commit_graph_compatible(struct repository *r);
+
 /*
  * Return 1 if and only if the repository has a commit-graph
  * file and generation numbers are computed in that file.
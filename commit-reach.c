@@ -11,6 +11,7 @@
 #include "tag.h"
 #include "commit-reach.h"
 #include "ewah/ewok.h"
+#include "pack-bitmap.h"
 
 /* Remember to update object flag allocation in object.h */
 #define PARENT1		(1u<<16)
@@ -441,6 +442,18 @@ struct commit_list *repo_get_merge_bases(struct repository *r,
 	return get_merge_bases_many_0(r, one, 1, &two, 1);
 }
 
+static int reachability_bitmaps_enabled(struct repository *r)
+{
+	if (!r->gitdir)
+		return 0;
+	prepare_repo_settings(r);
+	return r->settings.core_reachability_bitmaps;
+}
+
+static int can_all_from_reach_1(struct repository *r,
+				struct commit_list *from, struct commit_list *to,
+				int cutoff_by_min_date, int use_bitmaps);
+
 /*
  * Is "commit" a descendant of one of the elements on the "with_commit" list?
  */
@@ -448,14 +461,21 @@ int repo_is_descendant_of(struct repository *r,
 			  struct commit *commit,
 			  struct commit_list *with_commit)
 {
+	int result;
+
 	if (!with_commit)
 		return 1;
 
+	if (reachability_bitmaps_enabled(r)) {
+		result = bitmap_commit_reaches_any(r, commit, with_commit);
+		if (result >= 0)
+			return result;
+	}
+
 	if (generation_numbers_enabled(r)) {
 		struct commit_list *from_list = NULL;
-		int result;
 		commit_list_insert(commit, &from_list);
-		result = can_all_from_reach(from_list, with_commit, 0);
+		result = can_all_from_reach_1(r, from_list, with_commit, 0, 0);
 		free_commit_list(from_list);
 		return result;
 	} else {
@@ -821,8 +841,9 @@ int can_all_from_reach_with_flag(struct object_array *from,
 	return result;
 }
 
-int can_all_from_reach(struct commit_list *from, struct commit_list *to,
-		       int cutoff_by_min_date)
+static int can_all_from_reach_1(struct repository *r,
+				struct commit_list *from, struct commit_list *to,
+				int cutoff_by_min_date, int use_bitmaps)
 {
 	struct object_array from_objs = OBJECT_ARRAY_INIT;
 	time_t min_commit_date = cutoff_by_min_date ? from->item->date : 0;
@@ -831,9 +852,23 @@ int can_all_from_reach(struct commit_list *from, struct commit_list *to,
 	timestamp_t min_generation = GENERATION_NUMBER_INFINITY;
 
 	while (from_iter) {
+		/*
+		 * A stored reachability bitmap answers the question for
+		 * this commit without walking; only walk from the rest.
+		 */
+		switch (use_bitmaps ?
+			bitmap_commit_reaches_any(r, from_iter->item, to) : -1) {
+		case 0:
+			object_array_clear(&from_objs);
+			return 0;
+		case 1:
+			from_iter = from_iter->next;
+			continue;
+		}
+
 		add_object_array(&from_iter->item->object, NULL, &from_objs);
 
-		if (!repo_parse_commit(the_repository, from_iter->item)) {
+		if (!repo_parse_commit(r, from_iter->item)) {
 			timestamp_t generation;
 			if (from_iter->item->date < min_commit_date)
 				min_commit_date = from_iter->item->date;
@@ -846,8 +881,11 @@ int can_all_from_reach(struct commit_list *from, struct commit_list *to,
 		from_iter = from_iter->next;
 	}
 
+	if (!from_objs.nr)
+		return 1;
+
 	while (to_iter) {
-		if (!repo_parse_commit(the_repository, to_iter->item)) {
+		if (!repo_parse_commit(r, to_iter->item)) {
 			timestamp_t generation;
 			if (to_iter->item->date < min_commit_date)
 				min_commit_date = to_iter->item->date;
@@ -879,6 +917,13 @@ int can_all_from_reach(struct commit_list *from, struct commit_list *to,
 	return result;
 }
 
+int can_all_from_reach(struct commit_list *from, struct commit_list *to,
+		       int cutoff_by_min_date)
+{
+	return can_all_from_reach_1(the_repository, from, to, cutoff_by_min_date,
+				    reachability_bitmaps_enabled(the_repository));
+}
+
 struct commit_list *get_reachable_subset(struct commit **from, int nr_from,
 					 struct commit **to, int nr_to,
 					 unsigned int reachable_flag)
@@ -1083,6 +1128,14 @@ void tips_reachable_from_bases(struct repository *r,
 	if (!bases || !tips || !tips_nr)
 		return;
 
+	/*
+	 * With a reachability bitmap, a single bitmap of everything
+	 * reachable from 'bases' answers the question for every tip.
+	 */
+	if (reachability_bitmaps_enabled(r) &&
+	    !bitmap_tips_reachable_from_bases(r, bases, tips, tips_nr, mark))
+		return;
+
 	/*
 	 * Do a depth-first search starting at 'bases' to search for the
 	 * tips. Stop at the lowest (un-found) generation number. When
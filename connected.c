@@ -1,4 +1,5 @@
 #include "git-compat-util.h"
+#include "alloc.h"
 #include "gettext.h"
 #include "hex.h"
 #include "object-store.h"
@@ -8,6 +9,222 @@
 #include "transport.h"
 #include "packfile.h"
 #include "promisor-remote.h"
+#include "config.h"
+#include "commit.h"
+#include "tree.h"
+#include "tree-walk.h"
+#include "tag.h"
+#include "blob.h"
+#include "oidset.h"
+#include "progress.h"
+#include "pack-bitmap.h"
+#include "ewah/ewok.h"
+#include "shallow.h"
+#include "wrapper.h"
+#include "trace2.h"
+
+__attribute__((format (printf, 2, 3)))
+static void connectivity_error(struct check_connected_options *opt,
+			       const char *fmt, ...)
+{
+	struct strbuf buf = STRBUF_INIT;
+	va_list ap;
+
+	if (opt->quiet)
+		return;
+
+	va_start(ap, fmt);
+	strbuf_vaddf(&buf, fmt, ap);
+	va_end(ap);
+	if (opt->err_fd) {
+		strbuf_insertstr(&buf, 0, _("error: "));
+		strbuf_addch(&buf, '\n');
+		write_in_full(opt->err_fd, buf.buf, buf.len);
+	} else {
+		error("%s", buf.buf);
+	}
+	strbuf_release(&buf);
+}
+
+/*
+ * Whether the refs hidden by "<section>.hideRefs" or "transfer.hideRefs"
+ * must not count as reachable; the bitmaps cannot tell them apart.
+ */
+static int has_hidden_refs(const char *section)
+{
+	const struct string_list *values;
+	struct strbuf key = STRBUF_INIT;
+	int ret;
+
+	if (!section)
+		return 0;
+	if (!repo_config_get_value_multi(the_repository, "transfer.hiderefs",
+					 &values))
+		return 1;
+	strbuf_addf(&key, "%s.hiderefs", section);
+	ret = !repo_config_get_value_multi(the_repository, key.buf, &values);
+	strbuf_release(&key);
+	return ret;
+}
+
+static struct bitmap *connectivity_bitmap(struct check_connected_options *opt,
+					  struct bitmap_index **bitmap_git)
+{
+	int enabled = 0;
+
+	if (repo_config_get_bool(the_repository,
+				 "transfer.bitmapconnectivitycheck", &enabled) ||
+	    !enabled)
+		return NULL;
+	if (opt->shallow_file || opt->is_deepening_fetch ||
+	    is_repository_shallow(the_repository) ||
+	    has_hidden_refs(opt->exclude_hidden_refs_section))
+		return NULL;
+
+	*bitmap_git = prepare_reachability_bitmap(the_repository);
+	if (!*bitmap_git)
+		return NULL;
+	return bitmap_selected_reachable(*bitmap_git);
+}
+
+struct connectivity_walk {
+	struct check_connected_options *opt;
+	struct bitmap_index *bitmap_git;
+	struct bitmap *known;
+	struct oidset seen;
+	struct object **stack;
+	size_t nr, alloc;
+	struct progress *progress;
+	uint64_t count;
+};
+
+static void connectivity_push(struct connectivity_walk *w, struct object *obj)
+{
+	if (!obj || oidset_insert(&w->seen, &obj->oid) ||
+	    bitmap_walk_contains(w->bitmap_git, w->known, &obj->oid))
+		return;
+	ALLOC_GROW(w->stack, w->nr + 1, w->alloc);
+	w->stack[w->nr++] = obj;
+}
+
+static int connectivity_visit(struct connectivity_walk *w, struct object *obj)
+{
+	display_progress(w->progress, ++w->count);
+
+	switch (obj->type) {
+	case OBJ_COMMIT: {
+		struct commit *commit = (struct commit *)obj;
+		struct commit_list *p;
+
+		if (repo_parse_commit_no_graph(the_repository, commit))
+			return -1;
+		for (p = commit->parents; p; p = p->next)
+			connectivity_push(w, &p->item->object);
+		connectivity_push(w, &repo_get_commit_tree(the_repository,
+							   commit)->object);
+		free_commit_buffer(the_repository->parsed_objects, commit);
+		return 0;
+	}
+	case OBJ_TREE: {
+		struct tree *tree = (struct tree *)obj;
+		struct tree_desc desc;
+		struct name_entry entry;
+
+		if (parse_tree(tree))
+			return -1;
+		init_tree_desc(&desc, tree->buffer, tree->size);
+		while (tree_entry(&desc, &entry)) {
+			if (S_ISGITLINK(entry.mode))
+				continue;
+			if (S_ISDIR(entry.mode))
+				connectivity_push(w, &lookup_tree(the_repository,
+								  &entry.oid)->object);
+			else
+				connectivity_push(w, &lookup_blob(the_repository,
+								  &entry.oid)->object);
+		}
+		free_tree_buffer(tree);
+		return 0;
+	}
+	case OBJ_TAG: {
+		struct tag *tag = (struct tag *)obj;
+
+		if (parse_tag(tag))
+			return -1;
+		connectivity_push(w, tag->tagged);
+		return 0;
+	}
+	case OBJ_BLOB:
+		return repo_has_object_file(the_repository, &obj->oid) ? 0 : -1;
+	default:
+		return -1;
+	}
+}
+
+/*
+ * Walk from the given objects down to objects that are reachable from a
+ * commit with a stored bitmap, whose whole history is known to be
+ * present. Unlike "rev-list --not --all", this does not need to look at
+ * the existing refs at all, so its cost is bounded by the number of
+ * objects that are not covered by the bitmaps yet, i.e. mostly the ones
+ * that were just received.
+ */
+static int check_connected_bitmap(oid_iterate_fn fn, void *cb_data,
+				  const struct object_id *oid,
+				  struct packed_git *new_pack,
+				  struct bitmap_index *bitmap_git,
+				  struct bitmap *known,
+				  struct check_connected_options *opt)
+{
+	struct connectivity_walk w = {
+		.opt = opt,
+		.bitmap_git = bitmap_git,
+		.known = known,
+		.seen = OIDSET_INIT,
+	};
+	int err = 0;
+
+	if (opt->progress)
+		w.progress = start_delayed_progress(_("Checking connectivity"), 0);
+
+	do {
+		struct object *obj;
+		int type;
+
+		/* see the comment in check_connected() */
+		if (new_pack && find_pack_entry_one(oid->hash, new_pack))
+			continue;
+
+		type = oid_object_info(the_repository, oid, NULL);
+		obj = type < 0 ? NULL :
+			lookup_object_by_type(the_repository, oid, type);
+		if (!obj) {
+			connectivity_error(opt, _("missing object %s"),
+					   oid_to_hex(oid));
+			err = 1;
+			break;
+		}
+		connectivity_push(&w, obj);
+	} while ((oid = fn(cb_data)) != NULL);
+
+	while (!err && w.nr) {
+		struct object *obj = w.stack[--w.nr];
+
+		if (connectivity_visit(&w, obj) < 0) {
+			connectivity_error(opt, _("missing %s %s"),
+					   type_name(obj->type),
+					   oid_to_hex(&obj->oid));
+			err = 1;
+		}
+	}
+
+	stop_progress(&w.progress);
+	trace2_data_intmax("connectivity", the_repository, "bitmap/walked",
+			   w.count);
+	oidset_clear(&w.seen);
+	free(w.stack);
+	return err;
+}
 
 /*
  * If we feed all the commits we want to verify to this command
@@ -92,6 +309,21 @@ int check_connected(oid_iterate_fn fn, void *cb_data,
 	}
 
 no_promisor_pack_found:
+	if (!repo_has_promisor_remote(the_repository)) {
+		struct bitmap_index *bitmap_git = NULL;
+		struct bitmap *known = connectivity_bitmap(opt, &bitmap_git);
+
+		if (known) {
+			err = check_connected_bitmap(fn, cb_data, oid, new_pack,
+						     bitmap_git, known, opt);
+			bitmap_free(known);
+			free(new_pack);
+			if (opt->err_fd)
+				close(opt->err_fd);
+			return err;
+		}
+	}
+
 	if (opt->shallow_file) {
 		strvec_push(&rev_list.args, "--shallow-file");
 		strvec_push(&rev_list.args, opt->shallow_file);
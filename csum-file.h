@@ -64,6 +64,17 @@ static inline off_t hashfile_total(struct hashfile *f)
 	return f->total + f->offset;
 }
 
+/*
+ * Report the throughput of what is written to a hashfile from now on to
+ * "tp"; meant for one made with hashfd_throughput() before the progress
+ * meter was started.
+ */
+static inline void hashfile_set_progress(struct hashfile *f,
+					 struct progress *tp)
+{
+	f->tp = tp;
+}
+
 static inline void hashwrite_u8(struct hashfile *f, uint8_t data)
 {
 	hashwrite(f, &data, sizeof(data));
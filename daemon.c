@@ -7,6 +7,7 @@
 #include "protocol.h"
 #include "run-command.h"
 #include "setup.h"
+#include "sigchain.h"
 #include "strbuf.h"
 #include "string-list.h"
 #include "wrapper.h"
@@ -36,6 +37,7 @@ static const char daemon_usage[] =
 "           [--access-hook=<path>]\n"
 "           [--inetd | [--listen=<host_or_ipaddr>] [--port=<n>]\n"
 "                      [--detach] [--user=<user> [--group=<group>]]\n"
+"                      [--worker-pool=<n>]]\n"
 "           [--log-destination=(stderr|syslog|none)]\n"
 "           [<directory>...]";
 
@@ -61,6 +63,10 @@ static const char *user_path;
 static unsigned int timeout;
 static unsigned int init_timeout;
 
+/* Number of idle workers to keep, and whether we are one of them */
+static int worker_pool;
+static int pool_worker;
+
 struct hostinfo {
 	struct strbuf hostname;
 	struct strbuf canon_hostname;
@@ -891,9 +897,216 @@ static void check_dead_children(void)
 }
 
 static struct strvec cld_argv = STRVEC_INIT;
+
+#ifndef NO_UNIX_SOCKETS
+/*
+ * With --worker-pool, "git daemon --serve" processes are started ahead
+ * of time.  Each waits for the socket of a connection to be passed to
+ * it over a Unix domain socket, together with the environment that
+ * describes the client, so that new connections do not wait for a
+ * process to be started.
+ */
+static struct idle_worker {
+	struct child_process cld;
+	int sock;
+} *idle_workers;
+static int nr_idle_workers, alloc_idle_workers;
+
+static int start_idle_worker(void)
+{
+	struct idle_worker *w;
+	int sv[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+		logerror("unable to create socket pair: %s", strerror(errno));
+		return -1;
+	}
+	/* Only the worker is to have the other end. */
+	if (fcntl(sv[0], F_SETFD, FD_CLOEXEC) < 0) {
+		logerror("unable to set FD_CLOEXEC: %s", strerror(errno));
+		close(sv[0]);
+		close(sv[1]);
+		return -1;
+	}
+
+	ALLOC_GROW(idle_workers, nr_idle_workers + 1, alloc_idle_workers);
+	w = &idle_workers[nr_idle_workers];
+	child_process_init(&w->cld);
+	/* before any <directory> arguments */
+	strvec_pushl(&w->cld.args, cld_argv.v[0], cld_argv.v[1],
+		     "--pool-worker", NULL);
+	strvec_pushv(&w->cld.args, cld_argv.v + 2);
+	w->cld.in = sv[1];
+	w->cld.no_stdout = 1;
+	if (start_command(&w->cld)) {
+		logerror("unable to fork");
+		close(sv[0]);
+		return -1;
+	}
+	w->sock = sv[0];
+	nr_idle_workers++;
+	return 0;
+}
+
+static void fill_worker_pool(void)
+{
+	while (nr_idle_workers < worker_pool)
+		if (start_idle_worker())
+			break;
+}
+
+/*
+ * Forget about an idle worker, reaping it if "finish" is set; otherwise
+ * its child_process has been handed over to add_child().
+ */
+static void remove_idle_worker(int i, int finish)
+{
+	struct idle_worker *w = &idle_workers[i];
+
+	close(w->sock);
+	if (finish)
+		finish_command(&w->cld);
+	idle_workers[i] = idle_workers[--nr_idle_workers];
+}
+
+static int send_connection(int sock, int fd, const struct strvec *env)
+{
+	struct strbuf payload = STRBUF_INIT;
+	union {
+		struct cmsghdr align;
+		char buf[CMSG_SPACE(sizeof(int))];
+	} control;
+	struct msghdr msg = { 0 };
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	ssize_t ret;
+	int i;
+
+	/* NUL-terminated environment entries, with at least one byte */
+	for (i = 0; i < env->nr; i++)
+		strbuf_add(&payload, env->v[i], strlen(env->v[i]) + 1);
+	if (!payload.len)
+		strbuf_addch(&payload, '\0');
+
+	iov.iov_base = payload.buf;
+	iov.iov_len = payload.len;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	memset(&control, 0, sizeof(control));
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+	/* The worker may have died in the meantime. */
+	sigchain_push(SIGPIPE, SIG_IGN);
+	do {
+		ret = sendmsg(sock, &msg, 0);
+	} while (ret < 0 && errno == EINTR);
+	sigchain_pop(SIGPIPE);
+
+	strbuf_release(&payload);
+	return ret == iov.iov_len ? 0 : -1;
+}
+
+static int hand_to_idle_worker(int incoming, const struct strvec *env,
+			       struct sockaddr *addr, socklen_t addrlen)
+{
+	while (nr_idle_workers) {
+		int i = nr_idle_workers - 1;
+
+		if (!send_connection(idle_workers[i].sock, incoming, env)) {
+			add_child(&idle_workers[i].cld, addr, addrlen);
+			remove_idle_worker(i, 0);
+			close(incoming);
+			fill_worker_pool();
+			return 0;
+		}
+		remove_idle_worker(i, 1);
+	}
+	return -1;
+}
+
+/*
+ * In a worker, wait for the connection to serve, and make it our
+ * stdin and stdout.
+ */
+static int receive_connection(void)
+{
+	char buf[4096];
+	union {
+		struct cmsghdr align;
+		char buf[CMSG_SPACE(sizeof(int))];
+	} control;
+	struct msghdr msg = { 0 };
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	ssize_t len;
+	int fd = -1;
+	char *p;
+
+	iov.iov_base = buf;
+	iov.iov_len = sizeof(buf) - 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+
+	do {
+		len = recvmsg(0, &msg, 0);
+	} while (len < 0 && errno == EINTR);
+	/* The daemon went away without giving us anything to do. */
+	if (len <= 0)
+		return -1;
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+		if (cmsg->cmsg_level == SOL_SOCKET &&
+		    cmsg->cmsg_type == SCM_RIGHTS)
+			memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+	if (fd < 0)
+		return -1;
+
+	buf[len] = '\0';
+	for (p = buf; p < buf + len; p += strlen(p) + 1) {
+		char *eq = strchr(p, '=');
+		if (eq) {
+			*eq = '\0';
+			setenv(p, eq + 1, 1);
+		}
+	}
+
+	if (dup2(fd, 0) < 0 || dup2(fd, 1) < 0)
+		die_errno("unable to dup2 the connection");
+	if (fd > 1)
+		close(fd);
+	return 0;
+}
+#else
+static void fill_worker_pool(void)
+{
+}
+
+static int hand_to_idle_worker(int incoming UNUSED,
+			       const struct strvec *env UNUSED,
+			       struct sockaddr *addr UNUSED,
+			       socklen_t addrlen UNUSED)
+{
+	return -1;
+}
+
+static int receive_connection(void)
+{
+	return -1;
+}
+#endif
+
 static void handle(int incoming, struct sockaddr *addr, socklen_t addrlen)
 {
 	struct child_process cld = CHILD_PROCESS_INIT;
+	struct strvec env = STRVEC_INIT;
 
 	if (max_connections && live_children >= max_connections) {
 		kill_some_child();
@@ -910,20 +1123,27 @@ static void handle(int incoming, struct sockaddr *addr, socklen_t addrlen)
 		char buf[128] = "";
 		struct sockaddr_in *sin_addr = (void *) addr;
 		inet_ntop(addr->sa_family, &sin_addr->sin_addr, buf, sizeof(buf));
-		strvec_pushf(&cld.env, "REMOTE_ADDR=%s", buf);
-		strvec_pushf(&cld.env, "REMOTE_PORT=%d",
+		strvec_pushf(&env, "REMOTE_ADDR=%s", buf);
+		strvec_pushf(&env, "REMOTE_PORT=%d",
 			     ntohs(sin_addr->sin_port));
 #ifndef NO_IPV6
 	} else if (addr->sa_family == AF_INET6) {
 		char buf[128] = "";
 		struct sockaddr_in6 *sin6_addr = (void *) addr;
 		inet_ntop(AF_INET6, &sin6_addr->sin6_addr, buf, sizeof(buf));
-		strvec_pushf(&cld.env, "REMOTE_ADDR=[%s]", buf);
-		strvec_pushf(&cld.env, "REMOTE_PORT=%d",
+		strvec_pushf(&env, "REMOTE_ADDR=[%s]", buf);
+		strvec_pushf(&env, "REMOTE_PORT=%d",
 			     ntohs(sin6_addr->sin6_port));
 #endif
 	}
 
+	if (!hand_to_idle_worker(incoming, &env, addr, addrlen)) {
+		strvec_clear(&env);
+		return;
+	}
+
+	strvec_pushv(&cld.env, env.v);
+	strvec_clear(&env);
 	strvec_pushv(&cld.args, cld_argv.v);
 	cld.in = incoming;
 	cld.out = dup(incoming);
@@ -1145,7 +1365,7 @@ static int service_loop(struct socketlist *socklist)
 	struct pollfd *pfd;
 	int i;
 
-	CALLOC_ARRAY(pfd, socklist->nr);
+	CALLOC_ARRAY(pfd, socklist->nr + worker_pool);
 
 	for (i = 0; i < socklist->nr; i++) {
 		pfd[i].fd = socklist->list[i];
@@ -1154,12 +1374,27 @@ static int service_loop(struct socketlist *socklist)
 
 	signal(SIGCHLD, child_handler);
 
+	fill_worker_pool();
+
 	for (;;) {
-		int i;
+		int i, nr_pfd = socklist->nr;
 
 		check_dead_children();
 
-		if (poll(pfd, socklist->nr, -1) < 0) {
+#ifndef NO_UNIX_SOCKETS
+		/*
+		 * Idle workers never write to us; their end becoming
+		 * readable means that they went away.
+		 */
+		for (i = 0; i < nr_idle_workers; i++) {
+			pfd[nr_pfd].fd = idle_workers[i].sock;
+			pfd[nr_pfd].events = POLLIN;
+			pfd[nr_pfd].revents = 0;
+			nr_pfd++;
+		}
+#endif
+
+		if (poll(pfd, nr_pfd, -1) < 0) {
 			if (errno != EINTR) {
 				logerror("Poll failed, resuming: %s",
 				      strerror(errno));
@@ -1168,6 +1403,22 @@ static int service_loop(struct socketlist *socklist)
 			continue;
 		}
 
+#ifndef NO_UNIX_SOCKETS
+		for (i = nr_pfd - 1; i >= socklist->nr; i--) {
+			int j;
+
+			if (!pfd[i].revents)
+				continue;
+			for (j = 0; j < nr_idle_workers; j++)
+				if (idle_workers[j].sock == pfd[i].fd) {
+					logerror("Idle worker [%"PRIuMAX"] went away",
+						 (uintmax_t)idle_workers[j].cld.pid);
+					remove_idle_worker(j, 1);
+					break;
+				}
+		}
+#endif
+
 		for (i = 0; i < socklist->nr; i++) {
 			if (pfd[i].revents & POLLIN) {
 				union {
@@ -1299,6 +1550,16 @@ int cmd_main(int argc, const char **argv)
 			inetd_mode = 1;
 			continue;
 		}
+		if (skip_prefix(arg, "--worker-pool=", &v)) {
+			worker_pool = atoi(v);
+			if (worker_pool < 0)
+				worker_pool = 0;
+			continue;
+		}
+		if (!strcmp(arg, "--pool-worker")) {
+			pool_worker = 1;
+			continue;
+		}
 		if (!strcmp(arg, "--verbose")) {
 			verbose = 1;
 			continue;
@@ -1443,6 +1704,13 @@ int cmd_main(int argc, const char **argv)
 	else if (listen_port == 0)
 		listen_port = DEFAULT_GIT_PORT;
 
+	if (inetd_mode && worker_pool)
+		die("--worker-pool is incompatible with --inetd");
+#ifdef NO_UNIX_SOCKETS
+	if (worker_pool)
+		die("--worker-pool not supported on this platform");
+#endif
+
 	if (group_name && !user_name)
 		die("--group supplied without --user");
 
@@ -1461,6 +1729,9 @@ int cmd_main(int argc, const char **argv)
 			die_errno("failed to redirect stderr to /dev/null");
 	}
 
+	if (serve_mode && pool_worker && receive_connection())
+		return 0;
+
 	if (inetd_mode || serve_mode)
 		return execute();
 
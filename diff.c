@@ -40,6 +40,8 @@
 #include "object-name.h"
 #include "setup.h"
 #include "strmap.h"
+#include "thread-utils.h"
+#include "trace2.h"
 #include "wrapper.h"
 
 #ifdef NO_FAST_WORKING_DIRECTORY
@@ -66,6 +68,7 @@ static int diff_no_prefix;
 static int diff_relative;
 static int diff_stat_graph_width;
 static int diff_dirstat_permille_default = 30;
+static int diff_threads = 1;
 static struct diff_options default_diff_options;
 static long diff_algorithm;
 static unsigned ws_error_highlight_default = WSEH_NEW;
@@ -450,6 +453,18 @@ int git_diff_basic_config(const char *var, const char *value, void *cb)
 		return 0;
 	}
 
+	if (!strcmp(var, "diff.threads")) {
+		diff_threads = git_config_int(var, value);
+		if (diff_threads < 0)
+			die(_("invalid number of threads specified (%d) for %s"),
+			    diff_threads, var);
+		if (!HAVE_THREADS && diff_threads > 1) {
+			warning(_("no threads support, ignoring %s"), var);
+			diff_threads = 1;
+		}
+		return 0;
+	}
+
 	if (userdiff_config(var, value) < 0)
 		return -1;
 
@@ -824,6 +839,20 @@ struct moved_entry {
 	const struct emitted_diff_symbol *es;
 	struct moved_entry *next_line;
 	struct moved_entry *next_match;
+	/* next entry with the same text followed by the same next line */
+	struct moved_entry *next_bigram;
+};
+
+/*
+ * All entries on one side of the diff ('s') whose line has the text
+ * 'id' and is directly followed by a line with the text 'next_id' on
+ * the same side.
+ */
+struct moved_bigram {
+	struct hashmap_entry ent;
+	enum diff_symbol s;
+	unsigned id, next_id;
+	struct moved_entry *entries;
 };
 
 struct moved_block {
@@ -959,8 +988,70 @@ struct moved_entry_list {
 	struct moved_entry *add, *del;
 };
 
+static unsigned int moved_bigram_hash(enum diff_symbol s, unsigned id,
+				      unsigned next_id)
+{
+	return memhash(&id, sizeof(id)) ^
+	       memhash(&next_id, sizeof(next_id)) ^ (unsigned)s;
+}
+
+static int moved_bigram_cmp(const void *hashmap_cmp_fn_data UNUSED,
+			    const struct hashmap_entry *eptr,
+			    const struct hashmap_entry *entry_or_key,
+			    const void *keydata UNUSED)
+{
+	const struct moved_bigram *a, *b;
+
+	a = container_of(eptr, const struct moved_bigram, ent);
+	b = container_of(entry_or_key, const struct moved_bigram, ent);
+
+	return a->s != b->s || a->id != b->id || a->next_id != b->next_id;
+}
+
+static struct moved_bigram *find_moved_bigram(struct hashmap *bigrams,
+					      enum diff_symbol s,
+					      unsigned id, unsigned next_id)
+{
+	struct moved_bigram key;
+
+	hashmap_entry_init(&key.ent, moved_bigram_hash(s, id, next_id));
+	key.s = s;
+	key.id = id;
+	key.next_id = next_id;
+	return hashmap_get_entry(bigrams, &key, ent, NULL);
+}
+
+/* Record 'entry' once it is known whether it has a next line. */
+static void add_moved_bigram(struct hashmap *bigrams,
+			     struct mem_pool *pool,
+			     struct moved_entry *entry)
+{
+	unsigned next_id;
+	struct moved_bigram *b;
+
+	/* a block starting here could not extend past it, anyway */
+	if (!entry->next_line)
+		return;
+
+	next_id = entry->next_line->es->id;
+	b = find_moved_bigram(bigrams, entry->es->s, entry->es->id, next_id);
+	if (!b) {
+		b = mem_pool_calloc(pool, 1, sizeof(*b));
+		hashmap_entry_init(&b->ent,
+				   moved_bigram_hash(entry->es->s,
+						     entry->es->id, next_id));
+		b->s = entry->es->s;
+		b->id = entry->es->id;
+		b->next_id = next_id;
+		hashmap_add(bigrams, &b->ent);
+	}
+	entry->next_bigram = b->entries;
+	b->entries = entry;
+}
+
 static struct moved_entry_list *add_lines_to_move_detection(struct diff_options *o,
-							    struct mem_pool *entry_mem_pool)
+							    struct mem_pool *entry_mem_pool,
+							    struct hashmap *bigrams)
 {
 	struct moved_entry *prev_line = NULL;
 	struct mem_pool interned_pool;
@@ -980,6 +1071,9 @@ static struct moved_entry_list *add_lines_to_move_detection(struct diff_options
 		struct moved_entry *entry;
 
 		if (l->s != DIFF_SYMBOL_PLUS && l->s != DIFF_SYMBOL_MINUS) {
+			if (prev_line)
+				add_moved_bigram(bigrams, entry_mem_pool,
+						 prev_line);
 			prev_line = NULL;
 			continue;
 		}
@@ -1005,6 +1099,8 @@ static struct moved_entry_list *add_lines_to_move_detection(struct diff_options
 		entry->next_line = NULL;
 		if (prev_line && prev_line->es->s == l->s)
 			prev_line->next_line = entry;
+		if (prev_line)
+			add_moved_bigram(bigrams, entry_mem_pool, prev_line);
 		prev_line = entry;
 		if (l->s == DIFF_SYMBOL_PLUS) {
 			entry->next_match = entry_list[l->id].add;
@@ -1015,6 +1111,9 @@ static struct moved_entry_list *add_lines_to_move_detection(struct diff_options
 		}
 	}
 
+	if (prev_line)
+		add_moved_bigram(bigrams, entry_mem_pool, prev_line);
+
 	hashmap_clear(&interned_map);
 	mem_pool_discard(&interned_pool, 0);
 
@@ -1050,20 +1149,36 @@ static void pmb_advance_or_null(struct diff_options *o,
 }
 
 static void fill_potential_moved_blocks(struct diff_options *o,
+					struct hashmap *bigrams,
 					struct moved_entry *match,
 					struct emitted_diff_symbol *l,
+					const struct emitted_diff_symbol *next,
 					struct moved_block **pmb_p,
 					int *pmb_alloc_p, int *pmb_nr_p)
 
 {
 	struct moved_block *pmb = *pmb_p;
 	int pmb_alloc = *pmb_alloc_p, pmb_nr = *pmb_nr_p;
+	struct moved_bigram *b = NULL;
 
 	/*
 	 * The current line is the start of a new block.
 	 * Setup the set of potential blocks.
+	 *
+	 * Only those potential blocks that continue with the text of the
+	 * next line can outlive this one, and all the others would be
+	 * dropped by pmb_advance_or_null() right away. Since all that
+	 * matters until then is whether there is any potential block at
+	 * all, keep just one of them when none of them continues. This
+	 * keeps lines like "}" that match all over the place from making
+	 * each new block cost time proportional to their number.
 	 */
-	for (; match; match = match->next_match) {
+	if (next && next->s == l->s)
+		b = find_moved_bigram(bigrams, match->es->s, l->id, next->id);
+	if (b)
+		match = b->entries;
+
+	for (; match; match = b ? match->next_bigram : NULL) {
 		ALLOC_GROW(pmb, pmb_nr + 1, pmb_alloc);
 		if (o->color_moved_ws_handling &
 		    COLOR_MOVED_WS_ALLOW_INDENTATION_CHANGE)
@@ -1118,7 +1233,8 @@ static int adjust_last_block(struct diff_options *o, int n, int block_length)
 
 /* Find blocks of moved code, delegate actual coloring decision to helper */
 static void mark_color_as_moved(struct diff_options *o,
-				struct moved_entry_list *entry_list)
+				struct moved_entry_list *entry_list,
+				struct hashmap *bigrams)
 {
 	struct moved_block *pmb = NULL; /* potentially moved blocks */
 	int pmb_nr = 0, pmb_alloc = 0;
@@ -1177,7 +1293,9 @@ static void mark_color_as_moved(struct diff_options *o,
 				 */
 				n -= block_length;
 			else
-				fill_potential_moved_blocks(o, match, l,
+				fill_potential_moved_blocks(o, bigrams, match, l,
+							    n + 1 < o->emitted_symbols->nr ?
+							    l + 1 : NULL,
 							    &pmb, &pmb_alloc,
 							    &pmb_nr);
 
@@ -3476,6 +3594,26 @@ static int set_diff_algorithm(struct diff_options *opts,
 	return 0;
 }
 
+/*
+ * When diff_flush() computes patches on several threads, everything
+ * apart from running xdiff itself (reading blobs and worktree files,
+ * attribute lookups, textconv, ...) is done under this lock.
+ */
+static pthread_mutex_t diff_serial_mutex;
+static int diff_serial_mutex_active;
+
+static void diff_serial_lock(void)
+{
+	if (diff_serial_mutex_active)
+		pthread_mutex_lock(&diff_serial_mutex);
+}
+
+static void diff_serial_unlock(void)
+{
+	if (diff_serial_mutex_active)
+		pthread_mutex_unlock(&diff_serial_mutex);
+}
+
 static void builtin_diff(const char *name_a,
 			 const char *name_b,
 			 struct diff_filespec *one,
@@ -3698,9 +3836,11 @@ static void builtin_diff(const char *name_a,
 
 		if (o->word_diff)
 			init_diff_words_data(&ecbdata, o, one, two);
+		diff_serial_unlock();
 		if (xdi_diff_outf(&mf1, &mf2, NULL, fn_out_consume,
 				  &ecbdata, &xpp, &xecfg))
 			die("unable to generate diff for %s", one->path);
+		diff_serial_lock();
 		if (o->word_diff)
 			free_diff_words_data(&ecbdata);
 		if (textconv_one)
@@ -6513,9 +6653,186 @@ static void create_filepairs_for_header_only_notifications(struct diff_options *
 	strset_clear(&present);
 }
 
+struct patch_job {
+	struct diff_filepair *pair;
+	struct emitted_diff_symbols esm;
+	unsigned done : 1;
+};
+
+struct patch_pool {
+	struct diff_options *o;
+	struct patch_job *jobs;
+	int nr;
+	int next; /* the next job to be picked up by a worker */
+	int emitted; /* jobs before this one have been written out */
+	int window; /* how far workers may run ahead of the output */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+};
+
+static void *run_patch_jobs(void *data)
+{
+	struct patch_pool *pool = data;
+
+	pthread_mutex_lock(&pool->mutex);
+	for (;;) {
+		struct patch_job *job;
+		struct diff_options opt;
+
+		while (pool->next < pool->nr &&
+		       pool->next >= pool->emitted + pool->window)
+			pthread_cond_wait(&pool->cond, &pool->mutex);
+		if (pool->next >= pool->nr)
+			break;
+
+		job = &pool->jobs[pool->next++];
+		memcpy(&opt, pool->o, sizeof(opt));
+		opt.emitted_symbols = &job->esm;
+		pthread_mutex_unlock(&pool->mutex);
+
+		diff_serial_lock();
+		diff_flush_patch(job->pair, &opt);
+		diff_serial_unlock();
+
+		pthread_mutex_lock(&pool->mutex);
+		if (opt.found_changes)
+			pool->o->found_changes = 1;
+		job->done = 1;
+		pthread_cond_broadcast(&pool->cond);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	return NULL;
+}
+
+static int driver_needs_serial_patch(struct userdiff_driver *drv,
+				     enum userdiff_driver_type type UNUSED,
+				     void *data)
+{
+	struct diff_options *o = data;
+
+	return (o->flags.allow_external && drv->external) ||
+	       (!o->ignore_driver_algorithm && drv->algorithm);
+}
+
+/*
+ * Return the number of threads to compute the patches in 'q' with, or 1
+ * if any of them needs something that cannot run out of order: output
+ * written without going through emit_diff_symbol(), state carried from
+ * one file pair to the next, or a filespec shared between pairs.
+ */
+static int patch_threads(struct diff_options *o, struct diff_queue_struct *q)
+{
+	int i, threads = diff_threads ? diff_threads : online_cpus();
+
+	if (threads < 2 || q->nr < 2)
+		return 1;
+	if (o->output_prefix || o->word_diff ||
+	    o->submodule_format != DIFF_SUBMODULE_SHORT)
+		return 1;
+	if (o->flags.allow_external && external_diff())
+		return 1;
+	if (for_each_userdiff_driver(driver_needs_serial_patch, o))
+		return 1;
+
+	for (i = 0; i < q->nr; i++) {
+		struct diff_filepair *p = q->queue[i];
+
+		if (p->status == DIFF_STATUS_UNMERGED ||
+		    p->one->count > 1 || p->two->count > 1)
+			return 1;
+	}
+
+	return threads;
+}
+
+static void diff_flush_patch_threaded(struct diff_options *o,
+				      struct diff_queue_struct *q,
+				      int threads)
+{
+	struct patch_pool pool = { .o = o };
+	pthread_t *workers;
+	int i, j;
+
+	ALLOC_ARRAY(pool.jobs, q->nr);
+	for (i = 0; i < q->nr; i++) {
+		struct diff_filepair *p = q->queue[i];
+		struct patch_job *job;
+
+		if (!check_pair_status(p))
+			continue;
+		job = &pool.jobs[pool.nr++];
+		job->pair = p;
+		job->esm.buf = NULL;
+		job->esm.nr = job->esm.alloc = 0;
+		job->done = 0;
+	}
+	if (threads > pool.nr)
+		threads = pool.nr;
+	pool.window = threads * 16;
+	trace2_data_intmax("diff", o->repo, "patch_threads", threads);
+
+	/* settle any lazily checked color.ui=auto before going parallel */
+	want_color(o->use_color);
+
+	pthread_mutex_init(&pool.mutex, NULL);
+	pthread_cond_init(&pool.cond, NULL);
+	pthread_mutex_init(&diff_serial_mutex, NULL);
+	diff_serial_mutex_active = 1;
+
+	CALLOC_ARRAY(workers, threads);
+	for (i = 0; i < threads; i++) {
+		int err = pthread_create(&workers[i], NULL, run_patch_jobs,
+					 &pool);
+		if (err)
+			die(_("unable to create diff thread: %s"),
+			    strerror(err));
+	}
+
+	for (i = 0; i < pool.nr; i++) {
+		struct patch_job *job = &pool.jobs[i];
+
+		pthread_mutex_lock(&pool.mutex);
+		while (!job->done)
+			pthread_cond_wait(&pool.cond, &pool.mutex);
+		pthread_mutex_unlock(&pool.mutex);
+
+		for (j = 0; j < job->esm.nr; j++) {
+			struct emitted_diff_symbol *e = &job->esm.buf[j];
+
+			if (o->emitted_symbols) {
+				/* hand the line over to the color-moved pass */
+				ALLOC_GROW(o->emitted_symbols->buf,
+					   o->emitted_symbols->nr + 1,
+					   o->emitted_symbols->alloc);
+				o->emitted_symbols->buf[o->emitted_symbols->nr++] = *e;
+			} else {
+				emit_diff_symbol_from_struct(o, e);
+				free((void *)e->line);
+			}
+		}
+		free(job->esm.buf);
+
+		pthread_mutex_lock(&pool.mutex);
+		pool.emitted = i + 1;
+		pthread_cond_broadcast(&pool.cond);
+		pthread_mutex_unlock(&pool.mutex);
+	}
+
+	for (i = 0; i < threads; i++)
+		pthread_join(workers[i], NULL);
+	free(workers);
+
+	diff_serial_mutex_active = 0;
+	pthread_mutex_destroy(&diff_serial_mutex);
+	pthread_cond_destroy(&pool.cond);
+	pthread_mutex_destroy(&pool.mutex);
+	free(pool.jobs);
+}
+
 static void diff_flush_patch_all_file_pairs(struct diff_options *o)
 {
-	int i;
+	int i, threads;
 	static struct emitted_diff_symbols esm = EMITTED_DIFF_SYMBOLS_INIT;
 	struct diff_queue_struct *q = &diff_queued_diff;
 
@@ -6528,24 +6845,33 @@ static void diff_flush_patch_all_file_pairs(struct diff_options *o)
 	if (o->additional_path_headers)
 		create_filepairs_for_header_only_notifications(o);
 
-	for (i = 0; i < q->nr; i++) {
-		struct diff_filepair *p = q->queue[i];
-		if (check_pair_status(p))
-			diff_flush_patch(p, o);
+	threads = patch_threads(o, q);
+	if (threads > 1) {
+		diff_flush_patch_threaded(o, q, threads);
+	} else {
+		for (i = 0; i < q->nr; i++) {
+			struct diff_filepair *p = q->queue[i];
+			if (check_pair_status(p))
+				diff_flush_patch(p, o);
+		}
 	}
 
 	if (o->emitted_symbols) {
 		if (o->color_moved) {
 			struct mem_pool entry_pool;
 			struct moved_entry_list *entry_list;
+			struct hashmap bigrams;
 
 			mem_pool_init(&entry_pool, 1024 * 1024);
+			hashmap_init(&bigrams, moved_bigram_cmp, NULL, 0);
 			entry_list = add_lines_to_move_detection(o,
-								 &entry_pool);
-			mark_color_as_moved(o, entry_list);
+								 &entry_pool,
+								 &bigrams);
+			mark_color_as_moved(o, entry_list, &bigrams);
 			if (o->color_moved == COLOR_MOVED_ZEBRA_DIM)
 				dim_moved_lines(o);
 
+			hashmap_clear(&bigrams);
 			mem_pool_discard(&entry_pool, 0);
 			free(entry_list);
 		}
@@ -19,6 +19,7 @@
 #include "git-compat-util.h"
 #include "alloc.h"
 #include "ewok.h"
+#include "ewok_rlw.h"
 
 #define EWAH_MASK(x) ((eword_t)1 << (x % BITS_IN_EWORD))
 #define EWAH_BLOCK(x) (x / BITS_IN_EWORD)
@@ -59,6 +60,21 @@ void bitmap_set(struct bitmap *self, size_t pos)
 	self->words[block] |= EWAH_MASK(pos);
 }
 
+void bitmap_or_word(struct bitmap *self, size_t pos, eword_t word)
+{
+	size_t block = EWAH_BLOCK(pos);
+	size_t shift = pos % BITS_IN_EWORD;
+	eword_t carry = shift ? word >> (BITS_IN_EWORD - shift) : 0;
+
+	if (!word)
+		return;
+
+	bitmap_grow(self, block + (carry ? 2 : 1));
+	self->words[block] |= word << shift;
+	if (carry)
+		self->words[block + 1] |= carry;
+}
+
 void bitmap_unset(struct bitmap *self, size_t pos)
 {
 	size_t block = EWAH_BLOCK(pos);
@@ -101,21 +117,40 @@ struct ewah_bitmap *bitmap_to_ewah(struct bitmap *bitmap)
 	return ewah;
 }
 
-struct bitmap *ewah_to_bitmap(struct ewah_bitmap *ewah)
+/*
+ * OR the words of "other" into "self", walking the compressed form
+ * directly so that runs of clean words are handled as a whole rather
+ * than expanded one at a time. Words that would land past the end of
+ * "self" are ignored.
+ */
+static void or_ewah_words(struct bitmap *self, struct ewah_bitmap *other)
 {
-	struct bitmap *bitmap = bitmap_new();
-	struct ewah_iterator it;
-	eword_t blowup;
-	size_t i = 0;
-
-	ewah_iterator_init(&it, ewah);
-
-	while (ewah_iterator_next(&blowup, &it)) {
-		ALLOC_GROW(bitmap->words, i + 1, bitmap->word_alloc);
-		bitmap->words[i++] = blowup;
+	size_t i = 0, pointer = 0;
+
+	while (pointer < other->buffer_size) {
+		eword_t *rlw = &other->buffer[pointer++];
+		size_t run = rlw_get_running_len(rlw);
+		size_t literals = rlw_get_literal_words(rlw);
+
+		if (run > self->word_alloc - i)
+			run = self->word_alloc - i;
+		if (rlw_get_run_bit(rlw))
+			memset(self->words + i, 0xff, run * sizeof(eword_t));
+		i += run;
+
+		for (; literals && pointer < other->buffer_size &&
+		       i < self->word_alloc; literals--)
+			self->words[i++] |= other->buffer[pointer++];
+		pointer += literals;
 	}
+}
 
-	bitmap->word_alloc = i;
+struct bitmap *ewah_to_bitmap(struct ewah_bitmap *ewah)
+{
+	struct bitmap *bitmap;
+
+	bitmap = bitmap_word_alloc(DIV_ROUND_UP(ewah->bit_size, BITS_IN_EWORD));
+	or_ewah_words(bitmap, ewah);
 	return bitmap;
 }
 
@@ -143,9 +178,6 @@ void bitmap_or_ewah(struct bitmap *self, struct ewah_bitmap *other)
 {
 	size_t original_size = self->word_alloc;
 	size_t other_final = (other->bit_size / BITS_IN_EWORD) + 1;
-	size_t i = 0;
-	struct ewah_iterator it;
-	eword_t word;
 
 	if (self->word_alloc < other_final) {
 		self->word_alloc = other_final;
@@ -154,10 +186,7 @@ void bitmap_or_ewah(struct bitmap *self, struct ewah_bitmap *other)
 			(self->word_alloc - original_size) * sizeof(eword_t));
 	}
 
-	ewah_iterator_init(&it, other);
-
-	while (ewah_iterator_next(&word, &it))
-		self->words[i++] |= word;
+	or_ewah_words(self, other);
 }
 
 size_t bitmap_popcount(struct bitmap *self)
@@ -170,6 +199,35 @@ size_t bitmap_popcount(struct bitmap *self)
 	return count;
 }
 
+size_t bitmap_and_ewah_popcount(struct bitmap *self, struct ewah_bitmap *mask)
+{
+	size_t i = 0, pointer = 0, count = 0;
+
+	while (pointer < mask->buffer_size && i < self->word_alloc) {
+		eword_t *rlw = &mask->buffer[pointer++];
+		size_t run = rlw_get_running_len(rlw);
+		size_t literals = rlw_get_literal_words(rlw);
+		size_t end = i + run;
+
+		if (end > self->word_alloc)
+			end = self->word_alloc;
+
+		if (rlw_get_run_bit(rlw)) {
+			for (; i < end; i++)
+				count += ewah_bit_popcount64(self->words[i]);
+		}
+		i = end;
+
+		for (; literals && pointer < mask->buffer_size &&
+		       i < self->word_alloc; literals--)
+			count += ewah_bit_popcount64(self->words[i++] &
+						     mask->buffer[pointer++]);
+		pointer += literals;
+	}
+
+	return count;
+}
+
 int bitmap_equals(struct bitmap *self, struct bitmap *other)
 {
 	struct bitmap *big, *small;
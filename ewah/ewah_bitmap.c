@@ -269,6 +269,31 @@ void ewah_each_bit(struct ewah_bitmap *self, void (*callback)(size_t, void*), vo
 	}
 }
 
+int ewah_get(struct ewah_bitmap *self, size_t pos)
+{
+	size_t word_pos = pos / BITS_IN_EWORD;
+	size_t pointer = 0;
+
+	while (pointer < self->buffer_size) {
+		eword_t *word = &self->buffer[pointer];
+		size_t run_len = rlw_get_running_len(word);
+		size_t literals = rlw_get_literal_words(word);
+
+		if (word_pos < run_len)
+			return rlw_get_run_bit(word);
+		word_pos -= run_len;
+		++pointer;
+
+		if (word_pos < literals)
+			return !!(self->buffer[pointer + word_pos] &
+				  ((eword_t)1 << (pos % BITS_IN_EWORD)));
+		word_pos -= literals;
+		pointer += literals;
+	}
+
+	return 0;
+}
+
 /**
  * Clear all the bits in the bitmap. Does not free or resize
  * memory.
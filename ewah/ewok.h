@@ -114,6 +114,13 @@ void ewah_each_bit(struct ewah_bitmap *self, ewah_callback callback, void *paylo
  */
 void ewah_set(struct ewah_bitmap *self, size_t i);
 
+/**
+ * Return whether the bit at position `pos` is set, without
+ * decompressing the bitmap. Clean runs are skipped in constant
+ * time, so the cost is bounded by the compressed size.
+ */
+int ewah_get(struct ewah_bitmap *self, size_t pos);
+
 struct ewah_iterator {
 	const eword_t *buffer;
 	size_t buffer_size;
@@ -175,6 +182,8 @@ struct bitmap *bitmap_new(void);
 struct bitmap *bitmap_word_alloc(size_t word_alloc);
 struct bitmap *bitmap_dup(const struct bitmap *src);
 void bitmap_set(struct bitmap *self, size_t pos);
+/* OR the bits of `word` into the bitmap, starting at bit `pos`. */
+void bitmap_or_word(struct bitmap *self, size_t pos, eword_t word);
 void bitmap_unset(struct bitmap *self, size_t pos);
 int bitmap_get(struct bitmap *self, size_t pos);
 void bitmap_free(struct bitmap *self);
@@ -189,5 +198,7 @@ void bitmap_or_ewah(struct bitmap *self, struct ewah_bitmap *other);
 void bitmap_or(struct bitmap *self, const struct bitmap *other);
 
 size_t bitmap_popcount(struct bitmap *self);
+/* Count the bits set in both `self` and `mask`, without expanding `mask`. */
+size_t bitmap_and_ewah_popcount(struct bitmap *self, struct ewah_bitmap *mask);
 
 #endif
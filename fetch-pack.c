@@ -23,6 +23,7 @@
 #include "oid-array.h"
 #include "oidset.h"
 #include "packfile.h"
+#include "object-file.h"
 #include "object-store.h"
 #include "connected.h"
 #include "fetch-negotiator.h"
@@ -51,6 +52,10 @@ static const char *alternate_shallow_file;
 static struct fsck_options fsck_options = FSCK_OPTIONS_MISSING_GITMODULES;
 static struct strbuf fsck_msg_types = STRBUF_INIT;
 static struct string_list uri_protocols = STRING_LIST_INIT_DUP;
+static int use_negotiation_cache;
+static struct commit_list *negotiation_cache_haves;
+static struct oidset negotiation_cache_sent = OIDSET_INIT;
+static struct oidset negotiation_cache_acked = OIDSET_INIT;
 
 /* Remember to update object flag allocation in object.h */
 #define COMPLETE	(1U << 0)
@@ -286,6 +291,232 @@ static int next_flush(int stateless_rpc, int count)
 	return count;
 }
 
+/*
+ * The negotiation cache remembers the commits that a remote acknowledged
+ * as common during the last fetch from it, in
+ * $GIT_DIR/negotiation-cache/<hash of the URL>:
+ *
+ *   "negotiation-cache v1" LF
+ *   <commit> LF
+ *   ...
+ *
+ * The next fetch from the same URL sends them as the very first "have"
+ * lines, and tells the negotiator that the server has them, so that their
+ * ancestors are neither walked nor sent.  When the server still has them,
+ * it can usually say "ready" after the first round.  Only commits still
+ * reachable from our refs are used, and the server decides by itself what
+ * is common, so a stale entry costs at most a larger pack, never a broken
+ * one.  At most INITIAL_FLUSH entries are kept, so that they all fit in
+ * the first round.
+ */
+#define NEGOTIATION_CACHE_HEADER "negotiation-cache v1"
+
+struct commit_array {
+	struct commit **items;
+	size_t nr, alloc;
+};
+
+static int negotiation_cache_enabled(const struct fetch_pack_args *args)
+{
+	return use_negotiation_cache && args->url && !args->refetch &&
+	       !args->deepen && !args->negotiation_tips &&
+	       !is_repository_shallow(the_repository) &&
+	       the_repository->settings.fetch_negotiation_algorithm !=
+	       FETCH_NEGOTIATION_NOOP;
+}
+
+static char *negotiation_cache_path(const struct fetch_pack_args *args)
+{
+	git_hash_ctx ctx;
+	unsigned char hash[GIT_MAX_RAWSZ];
+
+	the_hash_algo->init_fn(&ctx);
+	the_hash_algo->update_fn(&ctx, args->url, strlen(args->url));
+	the_hash_algo->final_fn(hash, &ctx);
+	return git_pathdup("negotiation-cache/%s", hash_to_hex(hash));
+}
+
+static void remember_common(const struct object_id *oid)
+{
+	if (use_negotiation_cache)
+		oidset_insert(&negotiation_cache_acked, oid);
+}
+
+/*
+ * Return the next "have" to send: the cached commits first, then what the
+ * negotiator comes up with.
+ */
+static const struct object_id *next_have(struct fetch_negotiator *negotiator)
+{
+	const struct object_id *oid;
+
+	if (negotiation_cache_haves) {
+		struct commit *c = pop_commit(&negotiation_cache_haves);
+
+		oidset_insert(&negotiation_cache_sent, &c->object.oid);
+		return &c->object.oid;
+	}
+	while ((oid = negotiator->next(negotiator)) &&
+	       oidset_contains(&negotiation_cache_sent, oid))
+		; /* already sent */
+	return oid;
+}
+
+static int add_ref_commit(const char *refname UNUSED,
+			  const struct object_id *oid,
+			  int flag UNUSED,
+			  void *cb_data)
+{
+	struct commit_array *tips = cb_data;
+	struct commit *c = deref_without_lazy_fetch(oid, 0);
+
+	if (c) {
+		ALLOC_GROW(tips->items, tips->nr + 1, tips->alloc);
+		tips->items[tips->nr++] = c;
+	}
+	return 0;
+}
+
+/*
+ * fetch_pack() may run more than once in a process (e.g. to backfill
+ * tags); do not let one negotiation see the state of the previous one.
+ */
+static void clear_negotiation_cache_state(void)
+{
+	free_commit_list(negotiation_cache_haves);
+	negotiation_cache_haves = NULL;
+	oidset_clear(&negotiation_cache_sent);
+	oidset_clear(&negotiation_cache_acked);
+}
+
+static void mark_cached_common(struct fetch_negotiator *negotiator,
+			       struct fetch_pack_args *args)
+{
+	struct strbuf buf = STRBUF_INIT;
+	struct commit_array cached = { 0 }, tips = { 0 };
+	struct commit_list *l;
+	int seeded = 0;
+	char *path;
+	FILE *fp;
+
+	clear_negotiation_cache_state();
+	if (!negotiation_cache_enabled(args))
+		return;
+
+	path = negotiation_cache_path(args);
+	fp = fopen(path, "r");
+	free(path);
+	if (!fp)
+		return;
+	if (strbuf_getline_lf(&buf, fp) ||
+	    strcmp(buf.buf, NEGOTIATION_CACHE_HEADER))
+		goto out;
+
+	while (strbuf_getline_lf(&buf, fp) != EOF) {
+		struct object_id oid;
+		struct commit *c;
+
+		if (get_oid_hex(buf.buf, &oid) ||
+		    !(c = deref_without_lazy_fetch(&oid, 0)))
+			continue;
+		/* Already known to be reachable from a local ref */
+		if (c->object.flags & COMPLETE) {
+			commit_list_insert(c, &negotiation_cache_haves);
+			continue;
+		}
+		ALLOC_GROW(cached.items, cached.nr + 1, cached.alloc);
+		cached.items[cached.nr++] = c;
+	}
+
+	if (cached.nr) {
+		struct commit_list *reachable;
+
+		for_each_rawref(add_ref_commit, &tips);
+		reachable = get_reachable_subset(tips.items, tips.nr,
+						 cached.items, cached.nr, 0);
+		while (reachable)
+			commit_list_insert(pop_commit(&reachable),
+					   &negotiation_cache_haves);
+	}
+
+	commit_list_sort_by_date(&negotiation_cache_haves);
+	for (l = negotiation_cache_haves; l; l = l->next) {
+		negotiator->known_common(negotiator, l->item);
+		seeded++;
+	}
+	trace2_data_intmax("fetch-pack", the_repository,
+			   "negotiation_cache/seeded", seeded);
+
+out:
+	fclose(fp);
+	strbuf_release(&buf);
+	free(cached.items);
+	free(tips.items);
+}
+
+static void write_negotiation_cache(struct fetch_pack_args *args,
+				    const struct ref *refs)
+{
+	struct lock_file lock = LOCK_INIT;
+	struct strbuf buf = STRBUF_INIT;
+	struct commit_list *heads = NULL, *l;
+	struct oidset_iter iter;
+	const struct object_id *oid;
+	char *path;
+	int nr = 0;
+
+	if (!negotiation_cache_enabled(args))
+		return;
+
+	/*
+	 * The server has what it acknowledged, and what we just fetched
+	 * from it.  Keep only the most recent of them that are not
+	 * ancestors of one another.
+	 */
+	oidset_iter_init(&negotiation_cache_acked, &iter);
+	while ((oid = oidset_iter_next(&iter))) {
+		struct commit *c = deref_without_lazy_fetch(oid, 0);
+		if (c)
+			commit_list_insert(c, &heads);
+	}
+	for (; refs; refs = refs->next) {
+		struct commit *c = deref_without_lazy_fetch(&refs->old_oid, 0);
+		if (c)
+			commit_list_insert(c, &heads);
+	}
+	if (!heads)
+		return;
+
+	commit_list_sort_by_date(&heads);
+	for (l = heads; l->next; l = l->next) {
+		if (++nr == INITIAL_FLUSH) {
+			free_commit_list(l->next);
+			l->next = NULL;
+			break;
+		}
+	}
+	reduce_heads_replace(&heads);
+
+	strbuf_addstr(&buf, NEGOTIATION_CACHE_HEADER "\n");
+	for (l = heads; l; l = l->next)
+		strbuf_addf(&buf, "%s\n", oid_to_hex(&l->item->object.oid));
+	free_commit_list(heads);
+
+	/*
+	 * This is only a cache; if another process holds the lock or we
+	 * cannot write, just skip it.
+	 */
+	path = negotiation_cache_path(args);
+	if (safe_create_leading_directories(path) == SCLD_OK &&
+	    hold_lock_file_for_update(&lock, path, 0) >= 0) {
+		if (write_in_full(get_lock_file_fd(&lock), buf.buf, buf.len) < 0 ||
+		    commit_lock_file(&lock) < 0)
+			rollback_lock_file(&lock);
+	}
+	free(path);
+	strbuf_release(&buf);
+}
+
 static void mark_tips(struct fetch_negotiator *negotiator,
 		      const struct oid_array *negotiation_tips)
 {
@@ -466,7 +697,7 @@ static int find_common(struct fetch_negotiator *negotiator,
 	trace2_region_enter("fetch-pack", "negotiation_v0_v1", the_repository);
 	flushes = 0;
 	retval = -1;
-	while ((oid = negotiator->next(negotiator))) {
+	while ((oid = next_have(negotiator))) {
 		packet_buf_write(&req_buf, "have %s\n", oid_to_hex(oid));
 		print_verbose(args, "have %s", oid_to_hex(oid));
 		in_vain++;
@@ -504,6 +735,7 @@ static int find_common(struct fetch_negotiator *negotiator,
 						      ack, oid_to_hex(result_oid));
 				switch (ack) {
 				case ACK:
+					remember_common(result_oid);
 					trace2_region_leave_printf("negotiation_v0_v1", "round",
 								   the_repository, "%d",
 								   negotiation_round);
@@ -522,6 +754,12 @@ static int find_common(struct fetch_negotiator *negotiator,
 					if (!commit)
 						die(_("invalid commit %s"), oid_to_hex(result_oid));
 					was_common = negotiator->ack(negotiator, commit);
+					/*
+					 * "ready" and "continue" may name a
+					 * commit the server does not have.
+					 */
+					if (ack == ACK_common)
+						remember_common(result_oid);
 					if (args->stateless_rpc
 					 && ack == ACK_common
 					 && !was_common) {
@@ -1201,6 +1439,7 @@ static struct ref *do_fetch_pack(struct fetch_pack_args *args,
 		die(_("Server does not support this repository's object format"));
 
 	mark_complete_and_common_ref(negotiator, args, &ref);
+	mark_cached_common(negotiator, args);
 	filter_refs(args, &ref, sought, nr_sought);
 	if (!args->refetch && everything_local(args, &ref)) {
 		packet_flush(fd[1]);
@@ -1306,7 +1545,7 @@ static int add_haves(struct fetch_negotiator *negotiator,
 	int haves_added = 0;
 	const struct object_id *oid;
 
-	while ((oid = negotiator->next(negotiator))) {
+	while ((oid = next_have(negotiator))) {
 		packet_buf_write(req_buf, "have %s\n", oid_to_hex(oid));
 		if (++haves_added >= *haves_to_send)
 			break;
@@ -1695,6 +1934,7 @@ static struct ref *do_fetch_pack_v2(struct fetch_pack_args *args,
 
 			/* Filter 'ref' by 'sought' and those that aren't local */
 			mark_complete_and_common_ref(negotiator, args, &ref);
+			mark_cached_common(negotiator, args);
 			filter_refs(args, &ref, sought, nr_sought);
 			if (!args->refetch && everything_local(args, &ref))
 				state = FETCH_DONE;
@@ -1737,6 +1977,7 @@ static struct ref *do_fetch_pack_v2(struct fetch_pack_args *args,
 				in_vain = 0;
 				seen_ack = 1;
 				oidset_insert(&common, &common_oid);
+				remember_common(&common_oid);
 			}
 			trace2_region_leave_printf("negotiation_v2", "round",
 						   the_repository, "%d",
@@ -1892,6 +2133,7 @@ static void fetch_pack_config(void)
 	git_config_get_bool("fetch.fsckobjects", &fetch_fsck_objects);
 	git_config_get_bool("transfer.fsckobjects", &transfer_fsck_objects);
 	git_config_get_bool("transfer.advertisesid", &advertise_sid);
+	git_config_get_bool("fetch.negotiationcache", &use_negotiation_cache);
 	if (!uri_protocols.nr) {
 		char *str;
 
@@ -2097,7 +2339,9 @@ struct ref *fetch_pack(struct fetch_pack_args *args,
 	}
 
 	update_shallow(args, sought, nr_sought, &si);
+	write_negotiation_cache(args, ref_cpy);
 cleanup:
+	clear_negotiation_cache_state();
 	clear_shallow_info(&si);
 	oid_array_clear(&shallows_scratch);
 	return ref_cpy;
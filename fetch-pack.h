@@ -24,6 +24,12 @@ struct fetch_pack_args {
 	 */
 	const struct oid_array *negotiation_tips;
 
+	/*
+	 * The URL of the remote, used to look up the commits it had in
+	 * common with us during earlier fetches (see fetch.negotiationCache).
+	 */
+	const char *url;
+
 	unsigned deepen_relative:1;
 	unsigned quiet:1;
 	unsigned keep_pack:1;
@@ -85,6 +85,14 @@
 #define GIT_CURL_HAVE_CURL_HTTP_VERSION_2 1
 #endif
 
+/**
+ * CURLPIPE_MULTIPLEX and CURLOPT_PIPEWAIT were added in 7.43.0,
+ * released in June 2015.
+ */
+#if LIBCURL_VERSION_NUM >= 0x072b00
+#define GIT_CURL_HAVE_CURLPIPE_MULTIPLEX 1
+#endif
+
 /**
  * CURLSSLOPT_NO_REVOKE was added in 7.44.0, released in August 2015.
  *
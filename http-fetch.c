@@ -49,6 +49,21 @@ static int fetch_using_walker(const char *raw_url, int get_verbosely,
 	return rc;
 }
 
+static NORETURN void die_unable_to_get_pack(const char *pack_url)
+{
+	struct url_info url;
+	char *nurl = url_normalize(pack_url, &url);
+	if (!nurl || !git_env_bool("GIT_TRACE_REDACT", 1)) {
+		die("unable to get pack file '%s'\n%s", pack_url,
+		    curl_errorstr);
+	} else {
+		die("failed to get '%.*s' url from '%.*s' "
+		    "(full URL redacted due to GIT_TRACE_REDACT setting)\n%s",
+		    (int)url.scheme_len, url.url,
+		    (int)url.host_len, &url.url[url.host_off], curl_errorstr);
+	}
+}
+
 static void fetch_single_packfile(struct object_id *packfile_hash,
 				  const char *url,
 				  const char **index_pack_args) {
@@ -58,6 +73,16 @@ static void fetch_single_packfile(struct object_id *packfile_hash,
 
 	http_init(NULL, url, 0);
 
+	ret = http_fetch_pack_ranges(packfile_hash->hash, url, index_pack_args);
+	if (ret == -1)
+		die_unable_to_get_pack(url);
+	if (ret < 0)
+		die("unable to store pack file %s", oid_to_hex(packfile_hash));
+	if (!ret) {
+		http_cleanup();
+		return;
+	}
+
 	preq = new_direct_http_pack_request(packfile_hash->hash, xstrdup(url));
 	if (!preq)
 		die("couldn't create http pack request");
@@ -67,19 +92,8 @@ static void fetch_single_packfile(struct object_id *packfile_hash,
 
 	if (start_active_slot(preq->slot)) {
 		run_active_slot(preq->slot);
-		if (results.curl_result != CURLE_OK) {
-			struct url_info url;
-			char *nurl = url_normalize(preq->url, &url);
-			if (!nurl || !git_env_bool("GIT_TRACE_REDACT", 1)) {
-				die("unable to get pack file '%s'\n%s", preq->url,
-				    curl_errorstr);
-			} else {
-				die("failed to get '%.*s' url from '%.*s' "
-				    "(full URL redacted due to GIT_TRACE_REDACT setting)\n%s",
-				    (int)url.scheme_len, url.url,
-				    (int)url.host_len, &url.url[url.host_off], curl_errorstr);
-			}
-		}
+		if (results.curl_result != CURLE_OK)
+			die_unable_to_get_pack(preq->url);
 	} else {
 		die("Unable to start request");
 	}
@@ -19,6 +19,10 @@
 #include "string-list.h"
 #include "object-file.h"
 #include "object-store.h"
+#include "lockfile.h"
+#include "sigchain.h"
+#include "trace2.h"
+#include "wrapper.h"
 
 static struct trace_key trace_curl = TRACE_KEY_INIT(CURL);
 static int trace_curl_data = 1;
@@ -31,6 +35,7 @@ ssize_t http_post_buffer = 16 * LARGE_PACKET_MAX;
 static int min_curl_sessions = 1;
 static int curl_session_count;
 static int max_requests = -1;
+static int pack_ranges = 1;
 static CURLM *curlm;
 static CURL *curl_default;
 
@@ -422,6 +427,10 @@ static int http_options(const char *var, const char *value, void *cb)
 		max_requests = git_config_int(var, value);
 		return 0;
 	}
+	if (!strcmp("http.packranges", var)) {
+		pack_ranges = git_config_int(var, value);
+		return 0;
+	}
 	if (!strcmp("http.lowspeedlimit", var)) {
 		curl_low_speed_limit = (long)git_config_int(var, value);
 		return 0;
@@ -1259,6 +1268,9 @@ void http_init(struct remote *remote, const char *url, int proactive_auth)
 	curlm = curl_multi_init();
 	if (!curlm)
 		die("curl_multi_init failed");
+#ifdef GIT_CURL_HAVE_CURLPIPE_MULTIPLEX
+	curl_multi_setopt(curlm, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
 
 	if (getenv("GIT_SSL_NO_VERIFY"))
 		curl_ssl_verify = 0;
@@ -1428,6 +1440,9 @@ struct active_request_slot *get_active_slot(void)
 	curl_easy_setopt(slot->curl, CURLOPT_HTTPGET, 1);
 	curl_easy_setopt(slot->curl, CURLOPT_FAILONERROR, 1);
 	curl_easy_setopt(slot->curl, CURLOPT_RANGE, NULL);
+#ifdef GIT_CURL_HAVE_CURLPIPE_MULTIPLEX
+	curl_easy_setopt(slot->curl, CURLOPT_PIPEWAIT, 0L);
+#endif
 
 	/*
 	 * Default following to off unless "ALWAYS" is configured; this gives
@@ -2206,6 +2221,146 @@ int http_get_file(const char *url, const char *filename,
 	return ret;
 }
 
+struct file_download {
+	struct strbuf tmpfile;
+	FILE *result;
+	struct active_request_slot *slot;
+	struct slot_results results;
+	struct curl_slist *headers;
+	int finished;
+	int other_origin;
+};
+
+/*
+ * The credentials in http_auth are those for the URL given to
+ * http_init(); tell whether "url" may be sent them.
+ */
+static int same_origin_as_http_auth(const char *url)
+{
+	struct credential c = CREDENTIAL_INIT;
+	int ret = 0;
+
+	if (!credential_from_url_gently(&c, url, 1) &&
+	    c.protocol && c.host && http_auth.protocol && http_auth.host)
+		ret = !strcmp(c.protocol, http_auth.protocol) &&
+		      !strcasecmp(c.host, http_auth.host);
+	credential_clear(&c);
+	return ret;
+}
+
+static int start_file_download(const char *url, struct file_download *dl)
+{
+	const char *accept_language;
+	off_t posn;
+
+	dl->result = fopen(dl->tmpfile.buf, "a");
+	if (!dl->result)
+		return error("Unable to open local file %s", dl->tmpfile.buf);
+
+	dl->slot = get_active_slot();
+	curl_easy_setopt(dl->slot->curl, CURLOPT_HTTPGET, 1);
+	curl_easy_setopt(dl->slot->curl, CURLOPT_NOBODY, 0);
+	curl_easy_setopt(dl->slot->curl, CURLOPT_WRITEDATA, dl->result);
+	curl_easy_setopt(dl->slot->curl, CURLOPT_WRITEFUNCTION, fwrite);
+	posn = ftello(dl->result);
+	if (posn > 0)
+		http_opt_request_remainder(dl->slot->curl, posn);
+	curl_easy_setopt(dl->slot->curl, CURLOPT_HEADERFUNCTION, fwrite_wwwauth);
+
+	dl->headers = http_copy_default_headers();
+	accept_language = http_get_accept_language_header();
+	if (accept_language)
+		dl->headers = curl_slist_append(dl->headers, accept_language);
+	dl->headers = curl_slist_append(dl->headers, "Pragma:");
+
+	curl_easy_setopt(dl->slot->curl, CURLOPT_URL, url);
+	curl_easy_setopt(dl->slot->curl, CURLOPT_HTTPHEADER, dl->headers);
+	curl_easy_setopt(dl->slot->curl, CURLOPT_ENCODING, "");
+	/*
+	 * Unlike http_request(), do not let an error page end up in the
+	 * file: http_get_file() resumes from whatever it holds.
+	 */
+	curl_easy_setopt(dl->slot->curl, CURLOPT_FAILONERROR, 1);
+#ifdef GIT_CURL_HAVE_CURLPIPE_MULTIPLEX
+	/*
+	 * Have downloads started while a TLS connection to the same host
+	 * is being set up wait to learn whether they can be multiplexed
+	 * over it, instead of opening connections of their own.  Over
+	 * plain HTTP this would only serialize them.
+	 */
+	if (starts_with(url, "https:"))
+		curl_easy_setopt(dl->slot->curl, CURLOPT_PIPEWAIT, 1L);
+#endif
+
+	/*
+	 * Other downloads may complete, and their slots be reused, while
+	 * we wait for this one; have the slot report to us directly.
+	 */
+	dl->slot->results = &dl->results;
+	dl->slot->finished = &dl->finished;
+	if (!start_active_slot(dl->slot)) {
+		curl_slist_free_all(dl->headers);
+		fclose(dl->result);
+		dl->result = NULL;
+		return error("failed to start HTTP request");
+	}
+	return 0;
+}
+
+int http_get_files(struct http_file_request *requests, size_t nr)
+{
+	struct file_download *dls;
+	size_t i;
+	int failed = 0;
+
+	CALLOC_ARRAY(dls, nr);
+	for (i = 0; i < nr; i++) {
+		strbuf_init(&dls[i].tmpfile, 0);
+		strbuf_addf(&dls[i].tmpfile, "%s.temp", requests[i].filename);
+		if (!same_origin_as_http_auth(requests[i].url)) {
+			error(_("not downloading '%s' from another host"),
+			      requests[i].url);
+			dls[i].other_origin = 1;
+			continue;
+		}
+		if (start_file_download(requests[i].url, &dls[i]))
+			dls[i].finished = 1;
+	}
+
+	for (i = 0; i < nr; i++) {
+		struct file_download *dl = &dls[i];
+		int ret = HTTP_ERROR;
+
+		if (dl->result) {
+			if (!dl->finished)
+				run_active_slot(dl->slot);
+			fclose(dl->result);
+			curl_slist_free_all(dl->headers);
+			ret = handle_curl_result(&dl->results);
+		}
+
+		/*
+		 * Anything unusual, like the server asking for credentials,
+		 * is left to http_get_file(), which resumes the download.
+		 */
+		if (ret == HTTP_OK) {
+			if (finalize_object_file(dl->tmpfile.buf,
+						 requests[i].filename))
+				ret = HTTP_ERROR;
+		} else if (ret != HTTP_MISSING_TARGET && !dl->other_origin) {
+			ret = http_get_file(requests[i].url,
+					    requests[i].filename, NULL);
+		}
+
+		requests[i].result = ret;
+		if (ret != HTTP_OK)
+			failed++;
+		strbuf_release(&dl->tmpfile);
+	}
+	free(dls);
+	return failed;
+}
+
 int http_fetch_ref(const char *base, struct ref *ref)
 {
 	struct http_get_options options = {0};
@@ -2455,6 +2610,443 @@ struct http_pack_request *new_direct_http_pack_request(
 	return NULL;
 }
 
+#define PACK_RANGES_HEADER "pack-ranges v1"
+
+/* Save the download state after this many bytes of new data. */
+#define PACK_RANGES_SAVE_INTERVAL (16 * 1024 * 1024)
+
+struct pack_ranges;
+
+struct pack_range {
+	struct pack_ranges *pack;
+	struct active_request_slot *slot;
+	struct slot_results results;
+	char range[64];
+	off_t start, end, done;
+	int finished;
+	unsigned not_partial:1;
+};
+
+struct pack_ranges {
+	struct pack_range *ranges;
+	int nr;
+	off_t size;
+	off_t fed;
+	off_t unsaved;
+	int fd;
+	struct strbuf data_path;
+	struct strbuf state_path;
+	struct child_process index_pack;
+};
+
+struct pack_probe {
+	off_t size;
+	int accept_ranges;
+};
+
+static size_t probe_pack_header(char *ptr, size_t eltsize, size_t nmemb,
+				void *data)
+{
+	struct pack_probe *probe = data;
+	size_t size = st_mult(eltsize, nmemb);
+	struct strbuf buf = STRBUF_INIT;
+	const char *val;
+	size_t val_len;
+
+	fwrite_wwwauth(ptr, eltsize, nmemb, NULL);
+
+	/* Only the headers of the last response, after redirects, count. */
+	if (size >= 5 && !strncmp(ptr, "HTTP/", 5)) {
+		probe->size = -1;
+		probe->accept_ranges = 0;
+	} else if (skip_iprefix_mem(ptr, size, "content-length:",
+				    &val, &val_len)) {
+		char *end;
+		intmax_t len;
+
+		strbuf_add(&buf, val, val_len);
+		strbuf_trim(&buf);
+		len = strtoimax(buf.buf, &end, 10);
+		if (buf.len && !*end && len > 0 &&
+		    len == (intmax_t)(off_t)len)
+			probe->size = len;
+	} else if (skip_iprefix_mem(ptr, size, "accept-ranges:",
+				    &val, &val_len)) {
+		strbuf_add(&buf, val, val_len);
+		strbuf_trim(&buf);
+		probe->accept_ranges = !strcasecmp(buf.buf, "bytes");
+	}
+	strbuf_release(&buf);
+	return size;
+}
+
+/*
+ * Ask the server for the size of the pack, and whether it accepts
+ * range requests for it.  Returns the size, or -1 if ranges cannot be
+ * used.
+ */
+static off_t probe_pack(const char *url)
+{
+	struct active_request_slot *slot;
+	struct slot_results results;
+	struct pack_probe probe = { .size = -1 };
+	int ret;
+
+	slot = get_active_slot();
+	curl_easy_setopt(slot->curl, CURLOPT_NOBODY, 1);
+	curl_easy_setopt(slot->curl, CURLOPT_URL, url);
+	curl_easy_setopt(slot->curl, CURLOPT_HTTPHEADER, no_pragma_header);
+	curl_easy_setopt(slot->curl, CURLOPT_HEADERFUNCTION, probe_pack_header);
+	curl_easy_setopt(slot->curl, CURLOPT_HEADERDATA, &probe);
+
+	ret = run_one_slot(slot, &results);
+
+	curl_easy_setopt(slot->curl, CURLOPT_HEADERFUNCTION, fwrite_wwwauth);
+	curl_easy_setopt(slot->curl, CURLOPT_HEADERDATA, NULL);
+
+	if (ret != HTTP_OK || !probe.accept_ranges)
+		return -1;
+	return probe.size;
+}
+
+static void save_pack_ranges(struct pack_ranges *p)
+{
+	struct lock_file lk = LOCK_INIT;
+	struct strbuf buf = STRBUF_INIT;
+	int i;
+
+	strbuf_addf(&buf, "%s\n%"PRIuMAX"\n", PACK_RANGES_HEADER,
+		    (uintmax_t)p->size);
+	for (i = 0; i < p->nr; i++)
+		strbuf_addf(&buf, "%"PRIuMAX" %"PRIuMAX" %"PRIuMAX"\n",
+			    (uintmax_t)p->ranges[i].start,
+			    (uintmax_t)p->ranges[i].end,
+			    (uintmax_t)p->ranges[i].done);
+
+	/*
+	 * The state is only needed to resume an interrupted download;
+	 * failing to save it is not an error.
+	 */
+	if (hold_lock_file_for_update(&lk, p->state_path.buf, 0) >= 0) {
+		if (write_in_full(get_lock_file_fd(&lk), buf.buf, buf.len) < 0 ||
+		    commit_lock_file(&lk))
+			rollback_lock_file(&lk);
+	}
+	p->unsaved = 0;
+	strbuf_release(&buf);
+}
+
+/*
+ * Read the state of a previous, interrupted download of the same pack.
+ * Returns 0 if it can be resumed.
+ */
+static int load_pack_ranges(struct pack_ranges *p)
+{
+	struct strbuf buf = STRBUF_INIT;
+	struct string_list lines = STRING_LIST_INIT_NODUP;
+	struct stat st;
+	off_t last_data = 0, next = 0;
+	int i, ret = -1;
+
+	if (strbuf_read_file(&buf, p->state_path.buf, 0) < 0)
+		goto out;
+	string_list_split_in_place(&lines, buf.buf, '\n', -1);
+	if (lines.nr < 4 || strcmp(lines.items[0].string, PACK_RANGES_HEADER) ||
+	    strtoumax(lines.items[1].string, NULL, 10) != (uintmax_t)p->size)
+		goto out;
+
+	/* The split leaves an empty string after the final newline. */
+	p->nr = lines.nr - 3;
+	CALLOC_ARRAY(p->ranges, p->nr);
+	for (i = 0; i < p->nr; i++) {
+		struct pack_range *r = &p->ranges[i];
+		uintmax_t start, end, done;
+
+		if (sscanf(lines.items[i + 2].string,
+			   "%"SCNuMAX" %"SCNuMAX" %"SCNuMAX,
+			   &start, &end, &done) != 3 ||
+		    start != (uintmax_t)next || end <= start ||
+		    done > end - start)
+			goto out;
+		r->start = start;
+		r->end = end;
+		r->done = done;
+		next = r->end;
+		if (r->done)
+			last_data = r->start + r->done;
+	}
+	if (next != p->size)
+		goto out;
+
+	p->fd = open(p->data_path.buf, O_RDWR);
+	if (p->fd < 0)
+		goto out;
+	if (fstat(p->fd, &st) || st.st_size < last_data) {
+		close(p->fd);
+		goto out;
+	}
+	ret = 0;
+
+out:
+	if (ret)
+		FREE_AND_NULL(p->ranges);
+	string_list_clear(&lines, 0);
+	strbuf_release(&buf);
+	return ret;
+}
+
+static void init_pack_ranges(struct pack_ranges *p, int nr)
+{
+	off_t len = p->size / nr;
+	int i;
+
+	p->nr = nr;
+	CALLOC_ARRAY(p->ranges, nr);
+	for (i = 0; i < nr; i++) {
+		p->ranges[i].start = i * len;
+		p->ranges[i].end = i + 1 < nr ? (i + 1) * len : p->size;
+	}
+}
+
+/*
+ * Give index-pack whatever follows what it has already been given and
+ * has been downloaded.
+ */
+static int feed_index_pack(struct pack_ranges *p)
+{
+	off_t avail = 0;
+	int i;
+
+	for (i = 0; i < p->nr; i++) {
+		struct pack_range *r = &p->ranges[i];
+
+		avail = r->start + r->done;
+		if (avail < r->end)
+			break;
+	}
+
+	while (p->fed < avail) {
+		char buf[65536];
+		size_t len = sizeof(buf);
+
+		if (len > avail - p->fed)
+			len = avail - p->fed;
+		if (pread_in_full(p->fd, buf, len, p->fed) != len)
+			return error_errno(_("unable to read '%s'"),
+					   p->data_path.buf);
+		if (write_in_full(p->index_pack.in, buf, len) < 0)
+			return error_errno(_("unable to write to index-pack"));
+		p->fed += len;
+	}
+	return 0;
+}
+
+static size_t write_pack_range(char *ptr, size_t eltsize, size_t nmemb,
+			       void *data)
+{
+	struct pack_range *r = data;
+	struct pack_ranges *p = r->pack;
+	size_t size = st_mult(eltsize, nmemb);
+	long code = 0;
+
+	/* A server that ignores the range would send the whole pack. */
+	curl_easy_getinfo(r->slot->curl, CURLINFO_RESPONSE_CODE, &code);
+	if (code != 206 || size > r->end - r->start - r->done) {
+		r->not_partial = 1;
+		return 0;
+	}
+
+	if (lseek(p->fd, r->start + r->done, SEEK_SET) < 0 ||
+	    write_in_full(p->fd, ptr, size) < 0) {
+		error_errno(_("unable to write '%s'"), p->data_path.buf);
+		return 0;
+	}
+	r->done += size;
+
+	p->unsaved += size;
+	if (p->unsaved >= PACK_RANGES_SAVE_INTERVAL)
+		save_pack_ranges(p);
+	if (feed_index_pack(p))
+		return 0;
+	return size;
+}
+
+static int start_pack_range(const char *url, struct pack_range *r)
+{
+	r->slot = get_active_slot();
+	curl_easy_setopt(r->slot->curl, CURLOPT_WRITEDATA, r);
+	curl_easy_setopt(r->slot->curl, CURLOPT_WRITEFUNCTION, write_pack_range);
+	curl_easy_setopt(r->slot->curl, CURLOPT_URL, url);
+	curl_easy_setopt(r->slot->curl, CURLOPT_HTTPHEADER, no_pragma_header);
+	xsnprintf(r->range, sizeof(r->range), "%"PRIuMAX"-%"PRIuMAX,
+		  (uintmax_t)(r->start + r->done), (uintmax_t)(r->end - 1));
+	curl_easy_setopt(r->slot->curl, CURLOPT_RANGE, r->range);
+
+	/* See start_file_download(). */
+	r->slot->results = &r->results;
+	r->slot->finished = &r->finished;
+	return start_active_slot(r->slot);
+}
+
+static int download_pack_ranges(struct pack_ranges *p, const char *url)
+{
+	int i, ret = 0;
+
+	for (i = 0; i < p->nr; i++) {
+		struct pack_range *r = &p->ranges[i];
+
+		r->pack = p;
+		if (r->done == r->end - r->start)
+			r->finished = 1;
+		else if (!start_pack_range(url, r)) {
+			error(_("unable to start request"));
+			return -2;
+		}
+	}
+
+	for (i = 0; i < p->nr; i++) {
+		struct pack_range *r = &p->ranges[i];
+
+		if (!r->finished)
+			run_active_slot(r->slot);
+		if (r->not_partial) {
+			strlcpy(curl_errorstr,
+				"The server did not honor the range request",
+				sizeof(curl_errorstr));
+			ret = -1;
+			break;
+		}
+		if (r->done != r->end - r->start) {
+			normalize_curl_result(&r->results.curl_result,
+					      r->results.http_code,
+					      curl_errorstr, sizeof(curl_errorstr));
+			ret = -1;
+			break;
+		}
+		if (feed_index_pack(p)) {
+			ret = -2;
+			break;
+		}
+	}
+
+	/*
+	 * On error, let the other requests run to the end anyway, so
+	 * that there is as much as possible to resume from.
+	 */
+	if (ret)
+		finish_all_active_slots();
+	return ret;
+}
+
+int http_fetch_pack_ranges(const unsigned char *packed_git_hash,
+			   const char *url, const char **index_pack_args)
+{
+	struct pack_ranges p = {
+		.fd = -1,
+		.data_path = STRBUF_INIT,
+		.state_path = STRBUF_INIT,
+		.index_pack = CHILD_PROCESS_INIT,
+	};
+	off_t min_len = git_env_ulong("GIT_TEST_HTTP_PACK_RANGE_SIZE",
+				      1024 * 1024);
+	int ret = -1, i;
+
+	if (pack_ranges < 2)
+		return 1;
+	if (min_len < 1)
+		min_len = 1;
+	p.size = probe_pack(url);
+	if (p.size < 0)
+		return 1;
+	curl_errorstr[0] = '\0';
+
+	strbuf_addf(&p.data_path, "%s.partial",
+		    sha1_pack_name(packed_git_hash));
+	strbuf_addf(&p.state_path, "%s.partial-state",
+		    sha1_pack_name(packed_git_hash));
+
+	if (!load_pack_ranges(&p)) {
+		off_t resumed = 0;
+
+		for (i = 0; i < p.nr; i++)
+			resumed += p.ranges[i].done;
+		if (http_is_verbose)
+			fprintf(stderr,
+				"Resuming fetch of pack %s with %"PRIuMAX" bytes\n",
+				hash_to_hex(packed_git_hash), (uintmax_t)resumed);
+		trace2_data_intmax("http", the_repository,
+				   "pack-ranges/resumed", resumed);
+	} else {
+		int nr = pack_ranges;
+
+		if (p.size / nr < min_len)
+			nr = p.size / min_len;
+		if (nr < 2) {
+			ret = 1;
+			goto out;
+		}
+		init_pack_ranges(&p, nr);
+		p.fd = open(p.data_path.buf, O_RDWR | O_CREAT | O_TRUNC, 0666);
+		if (p.fd < 0) {
+			error_errno(_("unable to create '%s'"), p.data_path.buf);
+			ret = -2;
+			goto out;
+		}
+		save_pack_ranges(&p);
+	}
+	trace2_data_intmax("http", the_repository, "pack-ranges/count", p.nr);
+
+	p.index_pack.git_cmd = 1;
+	p.index_pack.in = -1;
+	strvec_pushv(&p.index_pack.args, index_pack_args ?
+		     index_pack_args : default_index_pack_args);
+	if (start_command(&p.index_pack)) {
+		ret = -2;
+		goto out;
+	}
+
+	/*
+	 * index-pack verifies the pack as it arrives in order; whatever
+	 * was downloaded in a previous attempt is given to it first.
+	 */
+	sigchain_push(SIGPIPE, SIG_IGN);
+	if (feed_index_pack(&p))
+		ret = -2;
+	else
+		ret = download_pack_ranges(&p, url);
+	sigchain_pop(SIGPIPE);
+
+	close(p.index_pack.in);
+	if (ret == -1) {
+		/* A download failed; keep what we have to resume from. */
+		save_pack_ranges(&p);
+		finish_command(&p.index_pack);
+		goto out;
+	}
+	if (finish_command(&p.index_pack)) {
+		/*
+		 * index-pack rejected the pack, possibly before all of it
+		 * was fed; the next attempt starts over.
+		 */
+		error(_("index-pack rejected pack %s"),
+		      hash_to_hex(packed_git_hash));
+		ret = -2;
+	} else if (ret) {
+		save_pack_ranges(&p);
+		goto out;
+	}
+	unlink(p.data_path.buf);
+	unlink(p.state_path.buf);
+
+out:
+	if (p.fd >= 0)
+		close(p.fd);
+	free(p.ranges);
+	strbuf_release(&p.data_path);
+	strbuf_release(&p.state_path);
+	return ret;
+}
+
 /* Helpers for fetching objects (loose) */
 static size_t fwrite_sha1_file(char *ptr, size_t eltsize, size_t nmemb,
 			       void *data)
@@ -174,6 +174,24 @@ int http_get_strbuf(const char *url, struct strbuf *result, struct http_get_opti
 int http_get_file(const char *url, const char *filename,
 		  struct http_get_options *options);
 
+struct http_file_request {
+	const char *url;
+	const char *filename;
+
+	/* The outcome of the download, one of the HTTP_* codes above. */
+	int result;
+};
+
+/*
+ * Downloads several URLs, each to its own file, like http_get_file().
+ * Up to http.maxRequests downloads are in flight at the same time, and
+ * they are multiplexed over a single connection when the server speaks
+ * HTTP/2.  URLs of another origin than the one given to http_init() are
+ * refused, so that no credentials asked for that one are sent to them.
+ * Returns the number of downloads that failed.
+ */
+int http_get_files(struct http_file_request *requests, size_t nr);
+
 int http_fetch_ref(const char *base, struct ref *ref);
 
 /* Helpers for fetching packs */
@@ -206,6 +224,23 @@ struct http_pack_request *new_direct_http_pack_request(
 int finish_http_pack_request(struct http_pack_request *preq);
 void release_http_pack_request(struct http_pack_request *preq);
 
+/*
+ * Downloads the pack with the given hash from "url" with up to
+ * http.packRanges concurrent range requests, and feeds it to index-pack
+ * as it arrives in order; see "index_pack_args" above.  The progress of
+ * the download is kept next to the pack, so that an interrupted
+ * download is resumed by the next call.
+ *
+ * Returns 0 on success, -1 if the download failed, with curl_errorstr
+ * describing why, and -2 after reporting an error if the pack could not
+ * be stored or was rejected by index-pack.  Returns 1 if the pack is not
+ * downloaded in ranges, because http.packRanges is not set, the pack is
+ * small, or the server does not accept range requests; the caller
+ * should then use new_direct_http_pack_request().
+ */
+int http_fetch_pack_ranges(const unsigned char *packed_git_hash,
+			   const char *url, const char **index_pack_args);
+
 /*
  * Remove p from the given list, and invoke install_packed_git() on it.
  *
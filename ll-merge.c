@@ -370,6 +370,34 @@ static void normalize_file(mmfile_t *mm, const char *path, struct index_state *i
 	}
 }
 
+static void prepare_ll_merge(struct ll_merge_prepared *prep,
+			     const char *path,
+			     struct index_state *istate,
+			     const struct ll_merge_options *opts)
+{
+	struct attr_check *check = load_merge_attributes();
+	const char *ll_driver_name = NULL;
+
+	prep->marker_size = DEFAULT_CONFLICT_MARKER_SIZE;
+
+	git_check_attr(istate, NULL, path, check);
+	ll_driver_name = check->items[0].value;
+	if (check->items[1].value) {
+		prep->marker_size = atoi(check->items[1].value);
+		if (prep->marker_size <= 0)
+			prep->marker_size = DEFAULT_CONFLICT_MARKER_SIZE;
+	}
+	prep->driver = find_ll_merge_driver(ll_driver_name);
+
+	if (opts->virtual_ancestor) {
+		if (prep->driver->recursive)
+			prep->driver = find_ll_merge_driver(prep->driver->recursive);
+	}
+	if (opts->extra_marker_size) {
+		prep->marker_size += opts->extra_marker_size;
+	}
+}
+
 enum ll_merge_result ll_merge(mmbuffer_t *result_buf,
 	     const char *path,
 	     mmfile_t *ancestor, const char *ancestor_label,
@@ -378,11 +406,8 @@ enum ll_merge_result ll_merge(mmbuffer_t *result_buf,
 	     struct index_state *istate,
 	     const struct ll_merge_options *opts)
 {
-	struct attr_check *check = load_merge_attributes();
 	static const struct ll_merge_options default_opts;
-	const char *ll_driver_name = NULL;
-	int marker_size = DEFAULT_CONFLICT_MARKER_SIZE;
-	const struct ll_merge_driver *driver;
+	struct ll_merge_prepared prep;
 
 	if (!opts)
 		opts = &default_opts;
@@ -393,25 +418,38 @@ enum ll_merge_result ll_merge(mmbuffer_t *result_buf,
 		normalize_file(theirs, path, istate);
 	}
 
-	git_check_attr(istate, NULL, path, check);
-	ll_driver_name = check->items[0].value;
-	if (check->items[1].value) {
-		marker_size = atoi(check->items[1].value);
-		if (marker_size <= 0)
-			marker_size = DEFAULT_CONFLICT_MARKER_SIZE;
-	}
-	driver = find_ll_merge_driver(ll_driver_name);
+	prepare_ll_merge(&prep, path, istate, opts);
+	return ll_merge_prepared(&prep, result_buf, path,
+				 ancestor, ancestor_label,
+				 ours, our_label, theirs, their_label, opts);
+}
 
-	if (opts->virtual_ancestor) {
-		if (driver->recursive)
-			driver = find_ll_merge_driver(driver->recursive);
-	}
-	if (opts->extra_marker_size) {
-		marker_size += opts->extra_marker_size;
-	}
-	return driver->fn(driver, result_buf, path, ancestor, ancestor_label,
-			  ours, our_label, theirs, their_label,
-			  opts, marker_size);
+int ll_merge_prepare(struct ll_merge_prepared *prep,
+		     const char *path,
+		     struct index_state *istate,
+		     const struct ll_merge_options *opts)
+{
+	if (opts->renormalize)
+		return -1;
+	prepare_ll_merge(prep, path, istate, opts);
+	/* external drivers write temporary files and spawn processes */
+	if (prep->driver->fn == ll_ext_merge)
+		return -1;
+	return 0;
+}
+
+enum ll_merge_result ll_merge_prepared(const struct ll_merge_prepared *prep,
+				       mmbuffer_t *result_buf,
+				       const char *path,
+				       mmfile_t *ancestor, const char *ancestor_label,
+				       mmfile_t *ours, const char *our_label,
+				       mmfile_t *theirs, const char *their_label,
+				       const struct ll_merge_options *opts)
+{
+	return prep->driver->fn(prep->driver, result_buf, path,
+				ancestor, ancestor_label,
+				ours, our_label, theirs, their_label,
+				opts, prep->marker_size);
 }
 
 int ll_merge_marker_size(struct index_state *istate, const char *path)
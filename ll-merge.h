@@ -103,6 +103,34 @@ enum ll_merge_result ll_merge(mmbuffer_t *result_buf,
 	     struct index_state *istate,
 	     const struct ll_merge_options *opts);
 
+/**
+ * `ll_merge()` split in two, for callers that want to run many merges in
+ * parallel.  `ll_merge_prepare()` looks up the attributes and the merge
+ * driver for `path`; it is not thread-safe.  It returns -1 if the merge
+ * cannot be run from a thread, either because it needs renormalization
+ * or because it uses an external driver; use `ll_merge()` then.
+ * Otherwise `ll_merge_prepared()` can be called from any thread to do
+ * the actual merge.
+ */
+struct ll_merge_driver;
+struct ll_merge_prepared {
+	const struct ll_merge_driver *driver;
+	int marker_size;
+};
+
+int ll_merge_prepare(struct ll_merge_prepared *prep,
+		     const char *path,
+		     struct index_state *istate,
+		     const struct ll_merge_options *opts);
+
+enum ll_merge_result ll_merge_prepared(const struct ll_merge_prepared *prep,
+				       mmbuffer_t *result_buf,
+				       const char *path,
+				       mmfile_t *ancestor, const char *ancestor_label,
+				       mmfile_t *ours, const char *our_label,
+				       mmfile_t *theirs, const char *their_label,
+				       const struct ll_merge_options *opts);
+
 int ll_merge_marker_size(struct index_state *istate, const char *path);
 void reset_merge_attributes(void);
 
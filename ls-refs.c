@@ -1,7 +1,11 @@
 #include "git-compat-util.h"
+#include "cache.h"
+#include "dir.h"
 #include "environment.h"
 #include "gettext.h"
 #include "hex.h"
+#include "lockfile.h"
+#include "object-file.h"
 #include "repository.h"
 #include "refs.h"
 #include "remote.h"
@@ -10,6 +14,9 @@
 #include "pkt-line.h"
 #include "config.h"
 #include "string-list.h"
+#include "trace2.h"
+#include "wrapper.h"
+#include "write-or-die.h"
 
 static enum {
 	UNBORN_IGNORE = 0,
@@ -72,6 +79,7 @@ struct ls_refs_data {
 	struct strvec prefixes;
 	struct strbuf buf;
 	struct string_list hidden_refs;
+	struct strbuf *cache;
 	unsigned unborn : 1;
 };
 
@@ -114,6 +122,8 @@ static int send_ref(const char *refname, const struct object_id *oid,
 
 	strbuf_addch(&data->buf, '\n');
 	packet_fwrite(stdout, data->buf.buf, data->buf.len);
+	if (data->cache)
+		packet_buf_write(data->cache, "%s", data->buf.buf);
 
 	return 0;
 }
@@ -135,6 +145,193 @@ static void send_possibly_unborn_head(struct ls_refs_data *data)
 	strbuf_release(&namespaced);
 }
 
+/*
+ * With lsrefs.cache, the encoded response for the refs other than HEAD is
+ * kept in $GIT_DIR/ls-refs-cache/.  <key> hashes the request options, the
+ * namespace and the hidden refs.  As clients choose the options, there
+ * is a fixed number of slots, picked by the first digit of <key>; a
+ * request that finds another one's response in its slot replaces it.
+ * The file holds
+ *
+ *   "ls-refs-cache v1 " <key> SP <state> LF <pkt-lines>
+ *
+ * where <state> hashes the stat data of packed-refs and of every
+ * directory below refs/.  Loose refs are always written by renaming a
+ * lockfile into place, or deleted, so any change to the refs changes the
+ * mtime of the directory holding them, or packed-refs.
+ */
+#define LS_REFS_CACHE_HEADER "ls-refs-cache v1 "
+
+static void hash_stat(git_hash_ctx *ctx, const char *path,
+		      const struct stat *st, time_t *newest)
+{
+	struct strbuf sb = STRBUF_INIT;
+
+	strbuf_addf(&sb, "%s %"PRIuMAX" %"PRIuMAX" %"PRIuMAX".%u",
+		    path, (uintmax_t)st->st_ino, (uintmax_t)st->st_size,
+		    (uintmax_t)st->st_mtime, ST_MTIME_NSEC(*st));
+	the_hash_algo->update_fn(ctx, sb.buf, sb.len + 1);
+	if (st->st_mtime > *newest)
+		*newest = st->st_mtime;
+	strbuf_release(&sb);
+}
+
+static int hash_ref_dirs(git_hash_ctx *ctx, struct strbuf *path,
+			 time_t *newest)
+{
+	struct stat st;
+	struct dirent *de;
+	size_t len;
+	DIR *dir;
+
+	if (lstat(path->buf, &st))
+		return -1;
+	hash_stat(ctx, path->buf, &st, newest);
+
+	dir = opendir(path->buf);
+	if (!dir)
+		return -1;
+	strbuf_addch(path, '/');
+	len = path->len;
+	while ((de = readdir(dir))) {
+		int dtype = DTYPE(de);
+
+		if (is_dot_or_dotdot(de->d_name))
+			continue;
+		strbuf_setlen(path, len);
+		strbuf_addstr(path, de->d_name);
+		if (dtype == DT_UNKNOWN) {
+			if (lstat(path->buf, &st))
+				continue;
+			if (S_ISDIR(st.st_mode))
+				dtype = DT_DIR;
+		}
+		if (dtype == DT_DIR && hash_ref_dirs(ctx, path, newest)) {
+			closedir(dir);
+			return -1;
+		}
+	}
+	closedir(dir);
+	strbuf_setlen(path, len - 1);
+	return 0;
+}
+
+/*
+ * Compute the <state> of the refs.  Return -1 if it cannot be trusted,
+ * i.e. the refs changed less than a second ago, as another change in
+ * the same second might leave the mtimes unchanged.
+ */
+static int ls_refs_cache_state(struct repository *r, struct strbuf *state)
+{
+	git_hash_ctx ctx;
+	unsigned char hash[GIT_MAX_RAWSZ];
+	struct strbuf path = STRBUF_INIT;
+	struct stat st;
+	time_t newest = 0;
+	int ret = -1;
+
+	the_hash_algo->init_fn(&ctx);
+	strbuf_addf(&path, "%s/packed-refs", r->commondir);
+	if (!stat(path.buf, &st))
+		hash_stat(&ctx, "packed-refs", &st, &newest);
+	strbuf_reset(&path);
+	strbuf_addf(&path, "%s/refs", r->commondir);
+	if (hash_ref_dirs(&ctx, &path, &newest) ||
+	    newest >= time(NULL) - 1)
+		goto out;
+
+	the_hash_algo->final_fn(hash, &ctx);
+	strbuf_addstr(state, hash_to_hex(hash));
+	ret = 0;
+out:
+	strbuf_release(&path);
+	return ret;
+}
+
+static char *ls_refs_cache_path(struct repository *r,
+				struct ls_refs_data *data,
+				struct strbuf *key_hex)
+{
+	git_hash_ctx ctx;
+	unsigned char hash[GIT_MAX_RAWSZ];
+	struct strbuf key = STRBUF_INIT;
+	int i;
+
+	strbuf_addf(&key, "peel=%u symrefs=%u namespace=%s",
+		    data->peel, data->symrefs, get_git_namespace());
+	strbuf_addch(&key, '\0');
+	for (i = 0; i < data->prefixes.nr; i++)
+		strbuf_add(&key, data->prefixes.v[i],
+			   strlen(data->prefixes.v[i]) + 1);
+	strbuf_addch(&key, '\0');
+	for (i = 0; i < data->hidden_refs.nr; i++)
+		strbuf_add(&key, data->hidden_refs.items[i].string,
+			   strlen(data->hidden_refs.items[i].string) + 1);
+
+	the_hash_algo->init_fn(&ctx);
+	the_hash_algo->update_fn(&ctx, key.buf, key.len);
+	the_hash_algo->final_fn(hash, &ctx);
+	strbuf_release(&key);
+	strbuf_addstr(key_hex, hash_to_hex(hash));
+	return xstrfmt("%s/ls-refs-cache/%c", r->commondir, key_hex->buf[0]);
+}
+
+/*
+ * Send the cached response if it is still valid, and return 0.
+ * Otherwise return -1, and leave the path to the cache in *path and the
+ * key and current state in *state, if there is one that can be cached.
+ */
+static int send_cached_refs(struct repository *r, struct ls_refs_data *data,
+			    char **path, struct strbuf *state)
+{
+	struct strbuf buf = STRBUF_INIT, key = STRBUF_INIT;
+	const char *p;
+	int ret = -1;
+
+	*path = NULL;
+	if (ls_refs_cache_state(r, state))
+		goto out;
+	*path = ls_refs_cache_path(r, data, &key);
+	strbuf_insertf(state, 0, "%s ", key.buf);
+	if (strbuf_read_file(&buf, *path, 0) < 0)
+		goto out;
+	if (!skip_prefix(buf.buf, LS_REFS_CACHE_HEADER, &p) ||
+	    !skip_prefix(p, state->buf, &p) || *p++ != '\n')
+		goto out;
+
+	fwrite_or_die(stdout, p, buf.buf + buf.len - p);
+	ret = 0;
+out:
+	trace2_data_string("ls-refs", r, "cache", ret ? "miss" : "hit");
+	strbuf_release(&buf);
+	strbuf_release(&key);
+	return ret;
+}
+
+static void write_cached_refs(const char *path, const struct strbuf *state,
+			      const struct strbuf *refs)
+{
+	struct lock_file lock = LOCK_INIT;
+	struct strbuf buf = STRBUF_INIT;
+	char *p = xstrdup(path);
+
+	strbuf_addf(&buf, LS_REFS_CACHE_HEADER "%s\n", state->buf);
+	strbuf_addbuf(&buf, refs);
+
+	/*
+	 * This is only a cache; if another process holds the lock or we
+	 * cannot write, just skip it.
+	 */
+	if (safe_create_leading_directories(p) == SCLD_OK &&
+	    hold_lock_file_for_update(&lock, p, 0) >= 0) {
+		if (write_in_full(get_lock_file_fd(&lock), buf.buf, buf.len) < 0 ||
+		    commit_lock_file(&lock) < 0)
+			rollback_lock_file(&lock);
+	}
+	free(p);
+	strbuf_release(&buf);
+}
+
 static int ls_refs_config(const char *var, const char *value,
 			  void *cb_data)
 {
@@ -150,6 +347,9 @@ static int ls_refs_config(const char *var, const char *value,
 int ls_refs(struct repository *r, struct packet_reader *request)
 {
 	struct ls_refs_data data;
+	struct strbuf cache_state = STRBUF_INIT, cache = STRBUF_INIT;
+	char *cache_path = NULL;
+	int use_cache = 0;
 
 	memset(&data, 0, sizeof(data));
 	strvec_init(&data.prefixes);
@@ -190,10 +390,26 @@ int ls_refs(struct repository *r, struct packet_reader *request)
 	send_possibly_unborn_head(&data);
 	if (!data.prefixes.nr)
 		strvec_push(&data.prefixes, "");
+
+	repo_config_get_bool(r, "lsrefs.cache", &use_cache);
+	if (use_cache &&
+	    !send_cached_refs(r, &data, &cache_path, &cache_state)) {
+		packet_fflush(stdout);
+		goto out;
+	}
+	if (cache_path)
+		data.cache = &cache;
+
 	refs_for_each_fullref_in_prefixes(get_main_ref_store(r),
 					  get_git_namespace(), data.prefixes.v,
 					  send_ref, &data);
 	packet_fflush(stdout);
+	if (cache_path)
+		write_cached_refs(cache_path, &cache_state, &cache);
+out:
+	free(cache_path);
+	strbuf_release(&cache_state);
+	strbuf_release(&cache);
 	strvec_clear(&data.prefixes);
 	strbuf_release(&data.buf);
 	string_list_clear(&data.hidden_refs, 0);
@@ -20,6 +20,7 @@
 #include "alloc.h"
 #include "attr.h"
 #include "blob.h"
+#include "bulk-checkin.h"
 #include "cache-tree.h"
 #include "commit.h"
 #include "commit-reach.h"
@@ -31,7 +32,9 @@
 #include "hex.h"
 #include "entry.h"
 #include "ll-merge.h"
+#include "lockfile.h"
 #include "mem-pool.h"
+#include "object-file.h"
 #include "object-name.h"
 #include "object-store.h"
 #include "oid-array.h"
@@ -40,9 +43,11 @@
 #include "strmap.h"
 #include "submodule-config.h"
 #include "submodule.h"
+#include "thread-utils.h"
 #include "trace2.h"
 #include "tree.h"
 #include "unpack-trees.h"
+#include "wrapper.h"
 #include "xdiff-interface.h"
 
 /*
@@ -297,6 +302,18 @@ struct rename_info {
 	 * this value remains 0.
 	 */
 	int needed_limit;
+
+	/*
+	 * rename_cache_sides: sides whose cached_* data can be written to
+	 * the on-disk rename cache (see merge.renameCache)
+	 *
+	 * Bit (1 << side) is set if the cached data for that side was
+	 * computed for exactly the trees being merged (or loaded from disk
+	 * for them), rather than carried over from a previous merge in a
+	 * rebase sequence.  It is cleared if the data also depends on the
+	 * other side, e.g. through directory renames.
+	 */
+	unsigned rename_cache_sides;
 };
 
 struct merge_options_internal {
@@ -397,6 +414,13 @@ struct merge_options_internal {
 
 	/* field that holds submodule conflict information */
 	struct string_list conflicted_submodules;
+
+	/*
+	 * content_merges: results of three-way content merges that were
+	 * done ahead of time by several threads (see premerge_contents()),
+	 * keyed by path.  Only non-NULL while process_entries() runs.
+	 */
+	struct strmap *content_merges;
 };
 
 struct conflicted_submodule_item {
@@ -632,6 +656,35 @@ static void free_strmap_strings(struct strmap *map)
 	}
 }
 
+static void clear_conflict_messages(struct strmap *conflicts, int partial)
+{
+	struct hashmap_iter iter;
+	struct strmap_entry *e;
+
+	/* Release and free each strbuf found in output */
+	strmap_for_each_entry(conflicts, &iter, e) {
+		struct string_list *list = e->value;
+		for (int i = 0; i < list->nr; i++) {
+			struct logical_conflict_info *info =
+				list->items[i].util;
+			strvec_clear(&info->paths);
+		}
+		/*
+		 * While strictly speaking we don't need to free(conflicts)
+		 * here because we could pass free_values=1 when calling
+		 * strmap_clear() on conflicts, that would require
+		 * strmap_clear to do another strmap_for_each_entry() loop,
+		 * so we just free it while we're iterating anyway.
+		 */
+		string_list_clear(list, 1);
+		free(list);
+	}
+	if (partial)
+		strmap_partial_clear(conflicts, 0);
+	else
+		strmap_clear(conflicts, 0);
+}
+
 static void clear_or_reinit_internal_opts(struct merge_options_internal *opti,
 					  int reinitialize)
 {
@@ -681,31 +734,8 @@ static void clear_or_reinit_internal_opts(struct merge_options_internal *opti,
 	renames->cached_pairs_valid_side = 0;
 	renames->dir_rename_mask = 0;
 
-	if (!reinitialize) {
-		struct hashmap_iter iter;
-		struct strmap_entry *e;
-
-		/* Release and free each strbuf found in output */
-		strmap_for_each_entry(&opti->conflicts, &iter, e) {
-			struct string_list *list = e->value;
-			for (int i = 0; i < list->nr; i++) {
-				struct logical_conflict_info *info =
-					list->items[i].util;
-				strvec_clear(&info->paths);
-			}
-			/*
-			 * While strictly speaking we don't need to
-			 * free(conflicts) here because we could pass
-			 * free_values=1 when calling strmap_clear() on
-			 * opti->conflicts, that would require strmap_clear
-			 * to do another strmap_for_each_entry() loop, so we
-			 * just free it while we're iterating anyway.
-			 */
-			string_list_clear(list, 1);
-			free(list);
-		}
-		strmap_clear(&opti->conflicts, 0);
-	}
+	if (!reinitialize)
+		clear_conflict_messages(&opti->conflicts, 0);
 
 	mem_pool_discard(&opti->pool, 0);
 
@@ -1960,6 +1990,69 @@ static void initialize_attr_index(struct merge_options *opt)
 	}
 }
 
+static void setup_ll_merge_options(struct merge_options *opt,
+				   int extra_marker_size,
+				   struct ll_merge_options *ll_opts)
+{
+	ll_opts->renormalize = opt->renormalize;
+	ll_opts->extra_marker_size = extra_marker_size;
+	ll_opts->xdl_opts = opt->xdl_opts;
+
+	if (opt->priv->call_depth) {
+		ll_opts->virtual_ancestor = 1;
+		ll_opts->variant = 0;
+	} else {
+		switch (opt->recursive_variant) {
+		case MERGE_VARIANT_OURS:
+			ll_opts->variant = XDL_MERGE_FAVOR_OURS;
+			break;
+		case MERGE_VARIANT_THEIRS:
+			ll_opts->variant = XDL_MERGE_FAVOR_THEIRS;
+			break;
+		default:
+			ll_opts->variant = 0;
+			break;
+		}
+	}
+}
+
+/*
+ * A three-way content merge done ahead of time by premerge_contents().
+ * It is only valid for the blobs and the marker size it was done with.
+ */
+struct premerged_content {
+	const char *path;
+	struct object_id o, a, b;
+	int extra_marker_size;
+	struct ll_merge_prepared prep;
+	mmfile_t orig, src1, src2;
+	mmbuffer_t result_buf;
+	enum ll_merge_result status;
+	struct object_id result;
+	unsigned done : 1;
+};
+
+static struct premerged_content *find_premerged_content(struct merge_options *opt,
+							 const char *path,
+							 const struct object_id *o,
+							 const struct object_id *a,
+							 const struct object_id *b,
+							 const char *pathnames[3],
+							 int extra_marker_size)
+{
+	struct premerged_content *pm;
+
+	if (!opt->priv->content_merges)
+		return NULL;
+	pm = strmap_get(opt->priv->content_merges, path);
+	if (!pm || !pm->done ||
+	    pm->extra_marker_size != extra_marker_size ||
+	    pathnames[0] != pathnames[1] || pathnames[1] != pathnames[2] ||
+	    !oideq(&pm->o, o) || !oideq(&pm->a, a) || !oideq(&pm->b, b))
+		return NULL;
+	return pm;
+}
+
 static int merge_3way(struct merge_options *opt,
 		      const char *path,
 		      const struct object_id *o,
@@ -1977,26 +2070,7 @@ static int merge_3way(struct merge_options *opt,
 	if (!opt->priv->attr_index.initialized)
 		initialize_attr_index(opt);
 
-	ll_opts.renormalize = opt->renormalize;
-	ll_opts.extra_marker_size = extra_marker_size;
-	ll_opts.xdl_opts = opt->xdl_opts;
-
-	if (opt->priv->call_depth) {
-		ll_opts.virtual_ancestor = 1;
-		ll_opts.variant = 0;
-	} else {
-		switch (opt->recursive_variant) {
-		case MERGE_VARIANT_OURS:
-			ll_opts.variant = XDL_MERGE_FAVOR_OURS;
-			break;
-		case MERGE_VARIANT_THEIRS:
-			ll_opts.variant = XDL_MERGE_FAVOR_THEIRS;
-			break;
-		default:
-			ll_opts.variant = 0;
-			break;
-		}
-	}
+	setup_ll_merge_options(opt, extra_marker_size, &ll_opts);
 
 	assert(pathnames[0] && pathnames[1] && pathnames[2] && opt->ancestor);
 	if (pathnames[0] == pathnames[1] && pathnames[1] == pathnames[2]) {
@@ -2102,6 +2176,7 @@ static int handle_content_merge(struct merge_options *opt,
 	/* Remaining rules depend on file vs. submodule vs. symlink. */
 	else if (S_ISREG(a->mode)) {
 		mmbuffer_t result_buf;
+		struct premerged_content *pm;
 		int ret = 0, merge_status;
 		int two_way;
 
@@ -2111,24 +2186,38 @@ static int handle_content_merge(struct merge_options *opt,
 		 */
 		two_way = ((S_IFMT & o->mode) != (S_IFMT & a->mode));
 
-		merge_status = merge_3way(opt, path,
-					  two_way ? null_oid() : &o->oid,
-					  &a->oid, &b->oid,
-					  pathnames, extra_marker_size,
-					  &result_buf);
-
-		if ((merge_status < 0) || !result_buf.ptr)
-			ret = err(opt, _("Failed to execute internal merge"));
-
-		if (!ret &&
-		    write_object_file(result_buf.ptr, result_buf.size,
-				      OBJ_BLOB, &result->oid))
-			ret = err(opt, _("Unable to add %s to database"),
-				  path);
-
-		free(result_buf.ptr);
-		if (ret)
-			return -1;
+		pm = two_way ? NULL :
+			find_premerged_content(opt, path, &o->oid,
+					       &a->oid, &b->oid,
+					       pathnames, extra_marker_size);
+		if (pm) {
+			merge_status = pm->status;
+			oidcpy(&result->oid, &pm->result);
+			if (merge_status == LL_MERGE_BINARY_CONFLICT)
+				path_msg(opt, CONFLICT_BINARY, 0,
+					 path, NULL, NULL, NULL,
+					 "warning: Cannot merge binary files: %s (%s vs. %s)",
+					 path, opt->branch1, opt->branch2);
+		} else {
+			merge_status = merge_3way(opt, path,
+						  two_way ? null_oid() : &o->oid,
+						  &a->oid, &b->oid,
+						  pathnames, extra_marker_size,
+						  &result_buf);
+
+			if ((merge_status < 0) || !result_buf.ptr)
+				ret = err(opt, _("Failed to execute internal merge"));
+
+			if (!ret &&
+			    write_object_file(result_buf.ptr, result_buf.size,
+					      OBJ_BLOB, &result->oid))
+				ret = err(opt, _("Unable to add %s to database"),
+					  path);
+
+			free(result_buf.ptr);
+			if (ret)
+				return -1;
+		}
 		clean &= (merge_status == 0);
 		path_msg(opt, INFO_AUTO_MERGING, 1, path, NULL, NULL, NULL,
 			 _("Auto-merging %s"), path);
@@ -2830,6 +2919,7 @@ static int process_renames(struct merge_options *opt,
 				 */
 				for (j = 0; j < 3; j++)
 					ri->merge_trees[j] = NULL;
+				ri->rename_cache_sides = 0;
 
 				/* We handled both renames, i.e. i+1 handled */
 				i++;
@@ -3126,6 +3216,15 @@ static void use_cached_pairs(struct merge_options *opt,
 		struct diff_filespec *one, *two;
 		const char *old_name = entry->key;
 		const char *new_name = entry->value;
+
+		/*
+		 * If the rename target was not walked, the source is not
+		 * relevant to this merge (see handle_deferred_entries()),
+		 * so the rename is not needed.  This happens when the same
+		 * trees were merged before against a different other side.
+		 */
+		if (new_name && !strmap_contains(&opt->priv->paths, new_name))
+			continue;
 		if (!new_name)
 			new_name = old_name;
 
@@ -3180,6 +3279,7 @@ static void possibly_cache_new_pair(struct rename_info *renames,
 		 * the side that adds new files to the old directory.
 		 */
 		dir_renamed_side = 3 - side;
+		renames->rename_cache_sides = 0;
 	} else {
 		int val = strintmap_get(&renames->relevant_sources[side],
 					p->one->path);
@@ -3358,6 +3458,7 @@ static int detect_and_process_renames(struct merge_options *opt,
 	if (renames->needed_limit) {
 		renames->cached_pairs_valid_side = 0;
 		renames->redo_after_renames = 0;
+		renames->rename_cache_sides = 0;
 	}
 	if (renames->redo_after_renames && detection_run) {
 		int i, side;
@@ -4265,6 +4366,188 @@ static void prefetch_for_content_merges(struct merge_options *opt,
 	oid_array_clear(&to_fetch);
 }
 
+/*
+ * Number of content merges handed to the threads at once, per thread;
+ * this bounds the number of blobs that are held in memory.
+ */
+#define PREMERGE_JOBS_PER_THREAD 16
+
+struct premerge_data {
+	struct merge_options *opt;
+	const struct ll_merge_options *ll_opts;
+	struct premerged_content **jobs;
+	size_t nr, next;
+	pthread_mutex_t mutex;
+};
+
+static void *premerge_worker(void *data_)
+{
+	struct premerge_data *data = data_;
+	struct merge_options *opt = data->opt;
+
+	for (;;) {
+		struct premerged_content *pm;
+		size_t i;
+
+		pthread_mutex_lock(&data->mutex);
+		i = data->next++;
+		pthread_mutex_unlock(&data->mutex);
+		if (i >= data->nr)
+			break;
+
+		pm = data->jobs[i];
+		pm->status = ll_merge_prepared(&pm->prep, &pm->result_buf,
+					       pm->path,
+					       &pm->orig, opt->ancestor,
+					       &pm->src1, opt->branch1,
+					       &pm->src2, opt->branch2,
+					       data->ll_opts);
+	}
+	return NULL;
+}
+
+static void premerge_window(struct premerge_data *data, int nr_threads)
+{
+	pthread_t *threads;
+	size_t i;
+	int t;
+
+	for (i = 0; i < data->nr; i++) {
+		struct premerged_content *pm = data->jobs[i];
+
+		read_mmblob(&pm->orig, &pm->o);
+		read_mmblob(&pm->src1, &pm->a);
+		read_mmblob(&pm->src2, &pm->b);
+	}
+
+	data->next = 0;
+	/* the main thread works too */
+	CALLOC_ARRAY(threads, nr_threads - 1);
+	for (t = 0; t < nr_threads - 1; t++) {
+		int err = pthread_create(&threads[t], NULL,
+					 premerge_worker, data);
+		if (err)
+			die(_("unable to create thread: %s"), strerror(err));
+	}
+	premerge_worker(data);
+	for (t = 0; t < nr_threads - 1; t++)
+		pthread_join(threads[t], NULL);
+	free(threads);
+
+	/*
+	 * The object database is not thread-safe, so results are written
+	 * out here.  Anything that fails is left for handle_content_merge()
+	 * to redo and report.
+	 */
+	for (i = 0; i < data->nr; i++) {
+		struct premerged_content *pm = data->jobs[i];
+
+		if (pm->status >= 0 && pm->result_buf.ptr &&
+		    !write_object_file(pm->result_buf.ptr, pm->result_buf.size,
+				       OBJ_BLOB, &pm->result))
+			pm->done = 1;
+
+		FREE_AND_NULL(pm->orig.ptr);
+		FREE_AND_NULL(pm->src1.ptr);
+		FREE_AND_NULL(pm->src2.ptr);
+		FREE_AND_NULL(pm->result_buf.ptr);
+	}
+}
+
+/*
+ * Run the three-way content merges of files modified on both sides of
+ * history using opt->threads threads, before process_entries() gets to
+ * them one by one.  Only plain merges of a path that was not renamed
+ * are handled here; the results are picked up by handle_content_merge().
+ */
+static void premerge_contents(struct merge_options *opt,
+			      struct string_list *plist,
+			      struct strmap *content_merges)
+{
+	struct string_list_item *e;
+	struct ll_merge_options ll_opts = { 0 };
+	struct premerge_data data = { 0 };
+	struct premerged_content **jobs = NULL;
+	size_t nr = 0, alloc = 0, window, i;
+	int nr_threads = opt->threads;
+	int extra_marker_size = opt->priv->call_depth * 2;
+
+	if (!nr_threads)
+		nr_threads = online_cpus();
+	if (!HAVE_THREADS || nr_threads < 2 || opt->renormalize)
+		return;
+
+	if (!opt->priv->attr_index.initialized)
+		initialize_attr_index(opt);
+	setup_ll_merge_options(opt, extra_marker_size, &ll_opts);
+
+	for (e = &plist->items[plist->nr-1]; e >= plist->items; --e) {
+		struct conflict_info *ci = e->util;
+		struct premerged_content *pm;
+		struct ll_merge_prepared prep;
+
+		if (ci->merged.clean)
+			continue;
+
+		/* Only three-way merges of regular files... */
+		if (ci->match_mask || ci->filemask != 7 ||
+		    !S_ISREG(ci->stages[0].mode) ||
+		    !S_ISREG(ci->stages[1].mode) ||
+		    !S_ISREG(ci->stages[2].mode) ||
+		    oideq(&ci->stages[0].oid, &ci->stages[1].oid) ||
+		    oideq(&ci->stages[0].oid, &ci->stages[2].oid) ||
+		    oideq(&ci->stages[1].oid, &ci->stages[2].oid))
+			continue;
+
+		/* ...of a path that was not involved in a rename... */
+		if (ci->pathnames[0] != e->string ||
+		    ci->pathnames[1] != e->string ||
+		    ci->pathnames[2] != e->string)
+			continue;
+
+		/* ...and that can be done by a built-in driver. */
+		if (ll_merge_prepare(&prep, e->string,
+				     &opt->priv->attr_index, &ll_opts))
+			continue;
+
+		CALLOC_ARRAY(pm, 1);
+		pm->path = e->string;
+		oidcpy(&pm->o, &ci->stages[0].oid);
+		oidcpy(&pm->a, &ci->stages[1].oid);
+		oidcpy(&pm->b, &ci->stages[2].oid);
+		pm->extra_marker_size = extra_marker_size;
+		pm->prep = prep;
+		strmap_put(content_merges, e->string, pm);
+
+		ALLOC_GROW(jobs, nr + 1, alloc);
+		jobs[nr++] = pm;
+	}
+
+	if (nr < 2) {
+		free(jobs);
+		return;
+	}
+
+	trace2_region_enter("merge", "premerge_contents", opt->repo);
+	trace2_data_intmax("merge", opt->repo, "premerge_contents/count", nr);
+
+	data.opt = opt;
+	data.ll_opts = &ll_opts;
+	pthread_mutex_init(&data.mutex, NULL);
+	window = st_mult(nr_threads, PREMERGE_JOBS_PER_THREAD);
+	begin_odb_transaction();
+	for (i = 0; i < nr; i += window) {
+		data.jobs = jobs + i;
+		data.nr = (nr - i < window) ? nr - i : window;
+		premerge_window(&data, nr_threads);
+	}
+	end_odb_transaction();
+	pthread_mutex_destroy(&data.mutex);
+
+	trace2_region_leave("merge", "premerge_contents", opt->repo);
+	free(jobs);
+}
+
 static int process_entries(struct merge_options *opt,
 			   struct object_id *result_oid)
 {
@@ -4275,6 +4558,7 @@ static int process_entries(struct merge_options *opt,
 	struct directory_versions dir_metadata = { STRING_LIST_INIT_NODUP,
 						   STRING_LIST_INIT_NODUP,
 						   NULL, 0 };
+	struct strmap content_merges = STRMAP_INIT;
 	int ret = 0;
 
 	trace2_region_enter("merge", "process_entries setup", opt->repo);
@@ -4313,6 +4597,8 @@ static int process_entries(struct merge_options *opt,
 	 */
 	trace2_region_enter("merge", "processing", opt->repo);
 	prefetch_for_content_merges(opt, &plist);
+	premerge_contents(opt, &plist, &content_merges);
+	opt->priv->content_merges = &content_merges;
 	for (entry = &plist.items[plist.nr-1]; entry >= plist.items; --entry) {
 		char *path = entry->string;
 		/*
@@ -4353,6 +4639,8 @@ static int process_entries(struct merge_options *opt,
 		       opt->repo->hash_algo->rawsz) < 0)
 		ret = -1;
 cleanup:
+	opt->priv->content_merges = NULL;
+	strmap_clear(&content_merges, 1);
 	string_list_clear(&plist, 0);
 	string_list_clear(&dir_metadata.versions, 0);
 	string_list_clear(&dir_metadata.offsets, 0);
@@ -4640,6 +4928,14 @@ void merge_display_update_messages(struct merge_options *opt,
 	trace2_region_leave("merge", "display messages", opt->repo);
 }
 
+void merge_discard_messages(struct merge_result *result)
+{
+	struct merge_options_internal *opti = result->priv;
+
+	if (opti)
+		clear_conflict_messages(&opti->conflicts, 1);
+}
+
 void merge_get_conflicted_files(struct merge_result *result,
 				struct string_list *conflicted_files)
 {
@@ -4931,6 +5227,29 @@ static void merge_check_renames_reusable(struct merge_options *opt,
 	 */
 	assert(merge_trees[0] && merge_trees[1] && merge_trees[2]);
 
+	/*
+	 * If a side has the same trees as in the previous merge (e.g. when
+	 * merging many topics into the same upstream), and what we cached
+	 * for it does not depend on the other side, it can be reused as is
+	 * when the user asked for renames to be shared that way.
+	 */
+	if (opt->rename_cache &&
+	    oideq(&merge_base->object.oid, &merge_trees[0]->object.oid)) {
+		int same1 = oideq(&side1->object.oid,
+				  &merge_trees[1]->object.oid) &&
+			(renames->rename_cache_sides & (1 << MERGE_SIDE1));
+		int same2 = oideq(&side2->object.oid,
+				  &merge_trees[2]->object.oid) &&
+			(renames->rename_cache_sides & (1 << MERGE_SIDE2));
+
+		if (same1 || same2) {
+			renames->cached_pairs_valid_side =
+				(same1 && same2) ? -1 :
+				same1 ? MERGE_SIDE1 : MERGE_SIDE2;
+			return;
+		}
+	}
+
 	/* Check if we meet a condition for re-using cached_pairs */
 	if (oideq(&merge_base->object.oid, &merge_trees[2]->object.oid) &&
 	    oideq(&side1->object.oid, &result->tree->object.oid))
@@ -4940,6 +5259,258 @@ static void merge_check_renames_reusable(struct merge_options *opt,
 		renames->cached_pairs_valid_side = MERGE_SIDE2;
 	else
 		renames->cached_pairs_valid_side = 0; /* neither side valid */
+
+	/* What is kept was computed for other trees */
+	renames->rename_cache_sides = 0;
+}
+
+/*** Function Grouping: functions related to the on-disk rename cache ***/
+
+/*
+ * The rename cache records what cached_pairs[side], cached_irrelevant[side]
+ * and dir_rename_count[side] held after a merge, in
+ * $GIT_DIR/rename-cache/<base-tree>-<side-tree>-<side>, so that a later
+ * process merging the same trees on the same side can start from there,
+ * just like the next pick of a rebase does in memory.  The file starts
+ * with a header line, followed by records of NUL-terminated fields:
+ *
+ *   'R' <old-path> NUL <new-path> NUL	rename
+ *   'D' <old-path> NUL			delete
+ *   'I' <old-path> NUL			cached_irrelevant
+ *   'C' <old-dir> NUL <new-dir> NUL <count> NUL	dir_rename_count
+ */
+#define RENAME_CACHE_HEADER "rename-cache v1 score=%d limit=%d\n"
+
+static char *rename_cache_path(struct merge_options *opt,
+			       struct tree *merge_base,
+			       struct tree *side_tree,
+			       int side)
+{
+	return repo_git_path(opt->repo, "rename-cache/%s-%s-%d",
+			     oid_to_hex(&merge_base->object.oid),
+			     oid_to_hex(&side_tree->object.oid), side);
+}
+
+static const char *rename_cache_field(const char **p, const char *end)
+{
+	const char *field = *p;
+	const char *nul = memchr(field, '\0', end - field);
+
+	if (!nul)
+		return NULL;
+	*p = nul + 1;
+	return field;
+}
+
+static void clear_side_cache(struct rename_info *renames, int side)
+{
+	strset_partial_clear(&renames->cached_target_names[side]);
+	strmap_partial_clear(&renames->cached_pairs[side], 1);
+	strset_partial_clear(&renames->cached_irrelevant[side]);
+	partial_clear_dir_rename_count(&renames->dir_rename_count[side]);
+}
+
+static int parse_rename_cache(struct merge_options *opt, int side,
+			      const char *p, const char *end)
+{
+	struct rename_info *renames = &opt->priv->renames;
+
+	while (p < end) {
+		const char *old_path, *new_path, *count;
+		char type = *p++;
+		struct strintmap *counts;
+
+		if (!(old_path = rename_cache_field(&p, end)))
+			return -1;
+		switch (type) {
+		case 'R':
+			if (!(new_path = rename_cache_field(&p, end)))
+				return -1;
+			cache_new_pair(renames, side, (char *)old_path,
+				       (char *)new_path, 1);
+			break;
+		case 'D':
+			strmap_put(&renames->cached_pairs[side],
+				   old_path, NULL);
+			break;
+		case 'I':
+			strset_add(&renames->cached_irrelevant[side],
+				   old_path);
+			break;
+		case 'C':
+			if (!(new_path = rename_cache_field(&p, end)) ||
+			    !(count = rename_cache_field(&p, end)))
+				return -1;
+			counts = strmap_get(&renames->dir_rename_count[side],
+					    old_path);
+			if (!counts) {
+				counts = xmalloc(sizeof(*counts));
+				strintmap_init_with_options(counts, 0, NULL, 1);
+				strmap_put(&renames->dir_rename_count[side],
+					   old_path, counts);
+			}
+			strintmap_set(counts, new_path, atoi(count));
+			break;
+		default:
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static void load_rename_cache(struct merge_options *opt,
+			      struct tree *merge_base,
+			      struct tree *side1,
+			      struct tree *side2)
+{
+	struct rename_info *renames = &opt->priv->renames;
+	struct tree *sides[3] = { NULL, side1, side2 };
+	struct strbuf buf = STRBUF_INIT;
+	struct strbuf header = STRBUF_INIT;
+	int side;
+
+	strbuf_addf(&header, RENAME_CACHE_HEADER,
+		    opt->rename_score, opt->rename_limit);
+	for (side = MERGE_SIDE1; side <= MERGE_SIDE2; side++) {
+		char *path;
+
+		/*
+		 * Leave data carried over from a previous merge alone;
+		 * merge_check_renames_reusable() already decided whether
+		 * it is specific to these trees.
+		 */
+		if (!strmap_empty(&renames->cached_pairs[side]) ||
+		    !strset_empty(&renames->cached_irrelevant[side]))
+			continue;
+		renames->rename_cache_sides |= (1 << side);
+		if (!opt->rename_cache || opt->subtree_shift)
+			continue;
+
+		path = rename_cache_path(opt, merge_base, sides[side], side);
+		strbuf_reset(&buf);
+		if (strbuf_read_file(&buf, path, 0) >= 0 &&
+		    starts_with(buf.buf, header.buf)) {
+			if (parse_rename_cache(opt, side, buf.buf + header.len,
+					       buf.buf + buf.len) < 0) {
+				clear_side_cache(renames, side);
+			} else {
+				/* Tell "git gc" that the entry is in use. */
+				utime(path, NULL);
+				trace2_data_intmax("merge", opt->repo,
+						   "rename_cache/loaded",
+						   strmap_get_size(&renames->cached_pairs[side]));
+			}
+		}
+		free(path);
+	}
+	strbuf_release(&buf);
+	strbuf_release(&header);
+}
+
+/*
+ * What is cached for a side only depends on the merge base and that side
+ * as long as no directory rename can matter; otherwise which sources are
+ * relevant, and the directory rename counts, depend on the other side too.
+ * Stop sharing such sides, and return 1 if data loaded for one of them
+ * has to be thrown away, in which case the caller must start over.
+ */
+static int drop_side_specific_rename_cache(struct merge_options *opt)
+{
+	struct rename_info *renames = &opt->priv->renames;
+	struct hashmap_iter iter;
+	struct strmap_entry *e;
+	int side, redo = 0;
+
+	for (side = MERGE_SIDE1; side <= MERGE_SIDE2; side++) {
+		if (!(renames->rename_cache_sides & (1 << side)))
+			continue;
+		strintmap_for_each_entry(&renames->dirs_removed[side],
+					 &iter, e) {
+			if ((intptr_t)e->value == NOT_RELEVANT)
+				continue;
+			renames->rename_cache_sides &= ~(1 << side);
+			if (!strmap_empty(&renames->cached_pairs[side]) ||
+			    !strset_empty(&renames->cached_irrelevant[side])) {
+				clear_side_cache(renames, side);
+				redo = 1;
+			}
+			break;
+		}
+	}
+	if (redo) {
+		/* The pairs point into the pool that is about to go away */
+		for (side = MERGE_SIDE1; side <= MERGE_SIDE2; side++) {
+			free(renames->pairs[side].queue);
+			DIFF_QUEUE_CLEAR(&renames->pairs[side]);
+		}
+	}
+	return redo;
+}
+
+static void write_rename_cache_side(struct merge_options *opt,
+				    struct tree *merge_base,
+				    struct tree *side_tree,
+				    int side)
+{
+	struct rename_info *renames = &opt->priv->renames;
+	struct lock_file lock = LOCK_INIT;
+	struct strbuf buf = STRBUF_INIT;
+	struct hashmap_iter iter, count_iter;
+	struct strmap_entry *e, *count_e;
+	char *path = rename_cache_path(opt, merge_base, side_tree, side);
+
+	strbuf_addf(&buf, RENAME_CACHE_HEADER,
+		    opt->rename_score, opt->rename_limit);
+	strmap_for_each_entry(&renames->cached_pairs[side], &iter, e) {
+		strbuf_addch(&buf, e->value ? 'R' : 'D');
+		strbuf_add(&buf, e->key, strlen(e->key) + 1);
+		if (e->value)
+			strbuf_add(&buf, e->value, strlen(e->value) + 1);
+	}
+	strset_for_each_entry(&renames->cached_irrelevant[side], &iter, e) {
+		strbuf_addch(&buf, 'I');
+		strbuf_add(&buf, e->key, strlen(e->key) + 1);
+	}
+	strmap_for_each_entry(&renames->dir_rename_count[side], &iter, e) {
+		struct strintmap *counts = e->value;
+
+		strintmap_for_each_entry(counts, &count_iter, count_e) {
+			strbuf_addch(&buf, 'C');
+			strbuf_add(&buf, e->key, strlen(e->key) + 1);
+			strbuf_add(&buf, count_e->key, strlen(count_e->key) + 1);
+			strbuf_addf(&buf, "%"PRIuMAX,
+				    (uintmax_t)(uintptr_t)count_e->value);
+			strbuf_addch(&buf, '\0');
+		}
+	}
+
+	/*
+	 * This is only a cache; if another process holds the lock or we
+	 * cannot write, just skip it.
+	 */
+	if (safe_create_leading_directories(path) == SCLD_OK &&
+	    hold_lock_file_for_update(&lock, path, 0) >= 0) {
+		if (write_in_full(get_lock_file_fd(&lock), buf.buf, buf.len) < 0 ||
+		    commit_lock_file(&lock) < 0)
+			rollback_lock_file(&lock);
+	}
+	strbuf_release(&buf);
+	free(path);
+}
+
+static void write_rename_cache(struct merge_options *opt,
+			       struct tree *merge_base,
+			       struct tree *side1,
+			       struct tree *side2)
+{
+	struct rename_info *renames = &opt->priv->renames;
+
+	trace2_region_enter("merge", "write_rename_cache", opt->repo);
+	if (renames->rename_cache_sides & (1 << MERGE_SIDE1))
+		write_rename_cache_side(opt, merge_base, side1, MERGE_SIDE1);
+	if (renames->rename_cache_sides & (1 << MERGE_SIDE2))
+		write_rename_cache_side(opt, merge_base, side2, MERGE_SIDE2);
+	trace2_region_leave("merge", "write_rename_cache", opt->repo);
 }
 
 /*** Function Grouping: merge_incore_*() and their internal variants ***/
@@ -4962,6 +5533,9 @@ static void merge_ort_nonrecursive_internal(struct merge_options *opt,
 					       opt->subtree_shift);
 	}
 
+	if (!opt->priv->call_depth)
+		load_rename_cache(opt, merge_base, side1, side2);
+
 redo:
 	trace2_region_enter("merge", "collect_merge_info", opt->repo);
 	if (collect_merge_info(opt, merge_base, side1, side2) != 0) {
@@ -4978,6 +5552,14 @@ static void merge_ort_nonrecursive_internal(struct merge_options *opt,
 	}
 	trace2_region_leave("merge", "collect_merge_info", opt->repo);
 
+	if (drop_side_specific_rename_cache(opt)) {
+		/* Keep what is cached for the other side */
+		opt->priv->renames.cached_pairs_valid_side = -1;
+		opt->priv->renames.redo_after_renames = 0;
+		clear_or_reinit_internal_opts(opt->priv, 1);
+		goto redo;
+	}
+
 	trace2_region_enter("merge", "renames", opt->repo);
 	result->clean = detect_and_process_renames(opt, merge_base,
 						   side1, side2);
@@ -4994,6 +5576,11 @@ static void merge_ort_nonrecursive_internal(struct merge_options *opt,
 		result->clean = -1;
 	trace2_region_leave("merge", "process_entries", opt->repo);
 
+	if (!opt->priv->call_depth && result->clean >= 0 &&
+	    opt->rename_cache && !opt->subtree_shift &&
+	    opt->priv->renames.rename_cache_sides)
+		write_rename_cache(opt, merge_base, side1, side2);
+
 	/* Set return values */
 	result->path_messages = &opt->priv->conflicts;
 
@@ -5130,7 +5717,29 @@ void merge_incore_recursive(struct merge_options *opt,
 	assert(opt->ancestor == NULL);
 
 	trace2_region_enter("merge", "merge_start", opt->repo);
-	merge_start(opt, result);
+	/*
+	 * With a single merge base, this is a non-recursive merge, so the
+	 * same caching of renames applies.  With several, the merges of
+	 * the merge bases would get in the way.
+	 */
+	if (merge_bases && !merge_bases->next) {
+		struct tree *base_tree, *side1_tree, *side2_tree;
+
+		base_tree = repo_get_commit_tree(opt->repo, merge_bases->item);
+		side1_tree = repo_get_commit_tree(opt->repo, side1);
+		side2_tree = repo_get_commit_tree(opt->repo, side2);
+		merge_check_renames_reusable(opt, result, base_tree,
+					     side1_tree, side2_tree);
+		merge_start(opt, result);
+		opt->priv->renames.merge_trees[0] = base_tree;
+		opt->priv->renames.merge_trees[1] = side1_tree;
+		opt->priv->renames.merge_trees[2] = side2_tree;
+	} else {
+		merge_start(opt, result);
+		opt->priv->renames.merge_trees[0] = NULL;
+		opt->priv->renames.merge_trees[1] = NULL;
+		opt->priv->renames.merge_trees[2] = NULL;
+	}
 	trace2_region_leave("merge", "merge_start", opt->repo);
 
 	merge_ort_internal(opt, merge_bases, side1, side2, result);
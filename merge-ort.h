@@ -90,6 +90,14 @@ void merge_display_update_messages(struct merge_options *opt,
 				   int detailed,
 				   struct merge_result *result);
 
+/*
+ * Forget the messages recorded in result->path_messages.  When result is
+ * passed to another merge_incore_*() call, the messages of the new merge
+ * are otherwise added to the old ones, as callers merging a sequence of
+ * commits want; callers doing unrelated merges call this in between.
+ */
+void merge_discard_messages(struct merge_result *result);
+
 struct stage_info {
 	struct object_id oid;
 	int mode;
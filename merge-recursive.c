@@ -3853,12 +3853,18 @@ int merge_recursive_generic(struct merge_options *opt,
 static void merge_recursive_config(struct merge_options *opt)
 {
 	char *value = NULL;
-	int renormalize = 0;
+	int renormalize = 0, rename_cache = 0;
 	git_config_get_int("merge.verbosity", &opt->verbosity);
 	git_config_get_int("diff.renamelimit", &opt->rename_limit);
 	git_config_get_int("merge.renamelimit", &opt->rename_limit);
 	git_config_get_bool("merge.renormalize", &renormalize);
 	opt->renormalize = renormalize;
+	if (!git_config_get_int("merge.threads", &opt->threads) &&
+	    opt->threads < 0)
+		die(_("invalid number of threads specified (%d) for %s"),
+		    opt->threads, "merge.threads");
+	git_config_get_bool("merge.renamecache", &rename_cache);
+	opt->rename_cache = rename_cache;
 	if (!git_config_get_string("diff.renames", &value)) {
 		opt->detect_renames = git_config_rename("diff.renames", value);
 		free(value);
@@ -3899,6 +3905,7 @@ void init_merge_options(struct merge_options *opt,
 	strbuf_init(&opt->obuf, 0);
 
 	opt->renormalize = 0;
+	opt->threads = 1;
 
 	merge_recursive_config(opt);
 	merge_verbosity = getenv("GIT_MERGE_VERBOSITY");
@@ -47,7 +47,9 @@ struct merge_options {
 	const char *subtree_shift;
 	unsigned renormalize : 1;
 	unsigned record_conflict_msgs_as_headers : 1;
+	unsigned rename_cache : 1; /* ort: keep rename results on disk */
 	const char *msg_header_prefix;
+	int threads; /* content merges run in parallel; 0: online_cpus() */
 
 	/* internal fields used by the implementation */
 	struct merge_options_internal *priv;
@@ -21,6 +21,7 @@
 #include "submodule.h"
 #include "midx.h"
 #include "commit-reach.h"
+#include "commit-graph.h"
 #include "date.h"
 
 static int get_oid_oneline(struct repository *r, const char *, struct object_id *, struct commit_list *);
@@ -1068,7 +1069,7 @@ static enum get_oid_result get_nth_ancestor(struct repository *r,
 					    int generation)
 {
 	struct object_id oid;
-	struct commit *commit;
+	struct commit *commit, *ancestor;
 	int ret;
 
 	ret = get_oid_1(r, name, len, &oid, GET_OID_COMMITTISH);
@@ -1078,6 +1079,14 @@ static enum get_oid_result get_nth_ancestor(struct repository *r,
 	if (!commit)
 		return MISSING_OBJECT;
 
+	if (generation > 1 &&
+	    !first_parent_ancestor_in_graph(r, commit, generation, &ancestor)) {
+		if (!ancestor)
+			return MISSING_OBJECT;
+		commit = ancestor;
+		generation = 0;
+	}
+
 	while (generation--) {
 		if (repo_parse_commit(r, commit) || !commit->parents)
 			return MISSING_OBJECT;
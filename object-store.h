@@ -141,6 +141,7 @@ struct packed_git {
 };
 
 struct multi_pack_index;
+struct bitmap_index;
 
 static inline int pack_map_entry_cmp(const void *cmp_data UNUSED,
 				     const struct hashmap_entry *entry,
@@ -186,6 +187,15 @@ struct raw_object_store {
 	struct commit_graph *commit_graph;
 	unsigned commit_graph_attempted : 1; /* if loading has been attempted */
 
+	/*
+	 * private data
+	 *
+	 * Reachability bitmap used to answer commit-reach queries; should
+	 * only be accessed directly by pack-bitmap.c and packfile.c
+	 */
+	struct bitmap_index *reachability_bitmap;
+	unsigned reachability_bitmap_attempted : 1;
+
 	/*
 	 * private data
 	 *
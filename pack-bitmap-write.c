@@ -396,7 +396,8 @@ static int fill_bitmap_commit(struct bb_commit *ent,
 			      struct prio_queue *queue,
 			      struct prio_queue *tree_queue,
 			      struct bitmap_index *old_bitmap,
-			      const uint32_t *mapping)
+			      const uint32_t *mapping,
+			      struct bitmap *contiguous)
 {
 	int found;
 	uint32_t pos;
@@ -416,7 +417,8 @@ static int fill_bitmap_commit(struct bb_commit *ent,
 			 * bitmap and add its bits to this one. No need to walk
 			 * parents or the tree for this commit.
 			 */
-			if (old && !rebuild_bitmap(mapping, old, ent->bitmap)) {
+			if (old && !rebuild_bitmap(mapping, contiguous,
+						  old, ent->bitmap)) {
 				reused_bitmaps_nr++;
 				continue;
 			}
@@ -476,6 +478,7 @@ int bitmap_writer_build(struct packing_data *to_pack)
 	struct prio_queue tree_queue = { NULL };
 	struct bitmap_index *old_bitmap;
 	uint32_t *mapping;
+	struct bitmap *contiguous = NULL;
 	int closed = 1; /* until proven otherwise */
 
 	writer.bitmaps = kh_init_oid_map();
@@ -487,10 +490,15 @@ int bitmap_writer_build(struct packing_data *to_pack)
 			    the_repository);
 
 	old_bitmap = prepare_bitmap_git(to_pack->repo);
-	if (old_bitmap)
-		mapping = create_bitmap_mapping(old_bitmap, to_pack);
-	else
+	if (old_bitmap) {
+		mapping = create_bitmap_mapping(old_bitmap, to_pack,
+						&contiguous);
+		trace2_data_intmax("pack-bitmap-write", the_repository,
+				   "building_bitmaps_contiguous_words",
+				   bitmap_popcount(contiguous));
+	} else {
 		mapping = NULL;
+	}
 
 	bitmap_builder_init(&bb, &writer, old_bitmap);
 	for (i = bb.commits_nr; i > 0; i--) {
@@ -500,7 +508,7 @@ int bitmap_writer_build(struct packing_data *to_pack)
 		int reused = 0;
 
 		if (fill_bitmap_commit(ent, commit, &queue, &tree_queue,
-				       old_bitmap, mapping) < 0) {
+				       old_bitmap, mapping, contiguous) < 0) {
 			closed = 0;
 			break;
 		}
@@ -533,6 +541,7 @@ int bitmap_writer_build(struct packing_data *to_pack)
 	bitmap_builder_clear(&bb);
 	free_bitmap_index(old_bitmap);
 	free(mapping);
+	bitmap_free(contiguous);
 
 	trace2_region_leave("pack-bitmap-write", "building_bitmaps_total",
 			    the_repository);
@@ -21,6 +21,7 @@
 #include "list-objects-filter-options.h"
 #include "midx.h"
 #include "config.h"
+#include "commit-graph.h"
 
 /*
  * An entry on the bitmap index, representing the bitmap for a given
@@ -1164,33 +1165,30 @@ static void show_extended_objects(struct bitmap_index *bitmap_git,
 	}
 }
 
-static void init_type_iterator(struct ewah_iterator *it,
-			       struct bitmap_index *bitmap_git,
-			       enum object_type type)
+static struct ewah_bitmap *type_bitmap(struct bitmap_index *bitmap_git,
+				       enum object_type type)
 {
 	switch (type) {
 	case OBJ_COMMIT:
-		ewah_iterator_init(it, bitmap_git->commits);
-		break;
-
+		return bitmap_git->commits;
 	case OBJ_TREE:
-		ewah_iterator_init(it, bitmap_git->trees);
-		break;
-
+		return bitmap_git->trees;
 	case OBJ_BLOB:
-		ewah_iterator_init(it, bitmap_git->blobs);
-		break;
-
+		return bitmap_git->blobs;
 	case OBJ_TAG:
-		ewah_iterator_init(it, bitmap_git->tags);
-		break;
-
+		return bitmap_git->tags;
 	default:
 		BUG("object type %d not stored by bitmap type index", type);
-		break;
 	}
 }
 
+static void init_type_iterator(struct ewah_iterator *it,
+			       struct bitmap_index *bitmap_git,
+			       enum object_type type)
+{
+	ewah_iterator_init(it, type_bitmap(bitmap_git, type));
+}
+
 static void show_objects_for_type(
 	struct bitmap_index *bitmap_git,
 	enum object_type object_type,
@@ -1637,11 +1635,29 @@ struct bitmap_index *prepare_bitmap_walk(struct rev_info *revs,
 	return NULL;
 }
 
+off_t bitmapped_pack_pos_to_offset(struct bitmapped_pack *pack, uint32_t pos)
+{
+	if (pos < pack->bitmap_pos || pos >= pack->bitmap_pos + pack->bitmap_nr)
+		BUG("bitmap position %"PRIu32" outside of pack %s",
+		    pos, pack->p->pack_name);
+
+	/*
+	 * If every object in the pack has a bit in this pack's range,
+	 * then bit order and pack order coincide.
+	 */
+	if (pack->bitmap_nr == pack->p->num_objects)
+		return pack_pos_to_offset(pack->p, pos - pack->bitmap_pos);
+
+	return nth_midxed_offset(pack->from_midx,
+				 pack_pos_to_midx(pack->from_midx, pos));
+}
+
 /*
  * -1 means "stop trying further objects"; 0 means we may or may not have
  * reused, but you can keep feeding bits.
  */
-static int try_partial_reuse(struct packed_git *pack,
+static int try_partial_reuse(struct bitmap_index *bitmap_git,
+			     struct bitmapped_pack *pack,
 			     size_t pos,
 			     struct bitmap *reuse,
 			     struct pack_window **w_curs)
@@ -1653,37 +1669,28 @@ static int try_partial_reuse(struct packed_git *pack,
 	/*
 	 * try_partial_reuse() is called either on (a) objects in the
 	 * bitmapped pack (in the case of a single-pack bitmap) or (b)
-	 * objects in the preferred pack of a multi-pack bitmap.
-	 * Importantly, the latter can pretend as if only a single pack
-	 * exists because:
-	 *
-	 *   - The first pack->num_objects bits of a MIDX bitmap are
-	 *     reserved for the preferred pack, and
-	 *
-	 *   - Ties due to duplicate objects are always resolved in
-	 *     favor of the preferred pack.
-	 *
-	 * Therefore we do not need to ever ask the MIDX for its copy of
-	 * an object by OID, since it will always select it from the
-	 * preferred pack. Likewise, the selected copy of the base
-	 * object for any deltas will reside in the same pack.
+	 * objects from one of the packs of a multi-pack bitmap.
 	 *
-	 * This means that we can reuse pos when looking up the bit in
-	 * the reuse bitmap, too, since bits corresponding to the
-	 * preferred pack precede all bits from other packs.
+	 * Objects of the MIDX's preferred pack occupy the first
+	 * pack->num_objects bits, in pack order, since ties due to
+	 * duplicate objects are always resolved in favor of the
+	 * preferred pack. Every other pack occupies a contiguous range
+	 * of bits following it (in order of pack identifier), again in
+	 * pack order but with gaps wherever the MIDX selected a
+	 * duplicate from some other pack.
 	 */
+	if (pos >= pack->bitmap_pos + pack->bitmap_nr)
+		return -1; /* not actually in the pack */
 
-	if (pos >= pack->num_objects)
-		return -1; /* not actually in the pack or MIDX preferred pack */
-
-	offset = delta_obj_offset = pack_pos_to_offset(pack, pos);
-	type = unpack_object_header(pack, w_curs, &offset, &size);
+	offset = delta_obj_offset = bitmapped_pack_pos_to_offset(pack, pos);
+	type = unpack_object_header(pack->p, w_curs, &offset, &size);
 	if (type < 0)
 		return -1; /* broken packfile, punt */
 
 	if (type == OBJ_REF_DELTA || type == OBJ_OFS_DELTA) {
 		off_t base_offset;
 		uint32_t base_pos;
+		uint32_t base_bitmap_pos;
 
 		/*
 		 * Find the position of the base object so we can look it up
@@ -1693,13 +1700,33 @@ static int try_partial_reuse(struct packed_git *pack,
 		 * and the normal slow path will complain about it in
 		 * more detail.
 		 */
-		base_offset = get_delta_base(pack, w_curs, &offset, type,
+		base_offset = get_delta_base(pack->p, w_curs, &offset, type,
 					     delta_obj_offset);
 		if (!base_offset)
 			return 0;
-		if (offset_to_pack_pos(pack, base_offset, &base_pos) < 0)
+		if (offset_to_pack_pos(pack->p, base_offset, &base_pos) < 0)
 			return 0;
 
+		if (pack->bitmap_nr == pack->p->num_objects) {
+			base_bitmap_pos = pack->bitmap_pos + base_pos;
+		} else {
+			/*
+			 * The MIDX may have selected the base from a
+			 * different pack. That copy is the one we would
+			 * send, so look up its bit instead. The writer
+			 * then refers to the base by name.
+			 */
+			struct object_id base_oid;
+			int bit;
+
+			nth_packed_object_id(&base_oid, pack->p,
+					     pack_pos_to_index(pack->p, base_pos));
+			bit = bitmap_position(bitmap_git, &base_oid);
+			if (bit < 0)
+				return 0;
+			base_bitmap_pos = bit;
+		}
+
 		/*
 		 * We assume delta dependencies always point backwards. This
 		 * lets us do a single pass, and is basically always true
@@ -1707,9 +1734,10 @@ static int try_partial_reuse(struct packed_git *pack,
 		 * find REF_DELTA in a bitmapped pack, since we only bitmap
 		 * packs we write fresh, and OFS_DELTA is the default). But
 		 * let's double check to make sure the pack wasn't written with
-		 * odd parameters.
+		 * odd parameters. Bases selected from another pack must
+		 * likewise come from an earlier one.
 		 */
-		if (base_pos >= pos)
+		if (base_bitmap_pos >= pos)
 			return 0;
 
 		/*
@@ -1720,7 +1748,7 @@ static int try_partial_reuse(struct packed_git *pack,
 		 * to REF_DELTA on the fly. Better to just let the normal
 		 * object_entry code path handle it.
 		 */
-		if (!bitmap_get(reuse, base_pos))
+		if (!bitmap_get(reuse, base_bitmap_pos))
 			return 0;
 	}
 
@@ -1739,86 +1767,191 @@ uint32_t midx_preferred_pack(struct bitmap_index *bitmap_git)
 	return nth_midxed_pack_int_id(m, pack_pos_to_midx(bitmap_git->midx, 0));
 }
 
+/*
+ * Return the first position in pseudo-pack order whose object comes
+ * neither from the preferred pack nor from a pack with an identifier
+ * below 'pack_int_id'.
+ */
+static uint32_t midx_pack_bitmap_pos(struct multi_pack_index *m,
+				     uint32_t preferred,
+				     uint32_t pack_int_id)
+{
+	uint32_t lo = 0, hi = m->num_objects;
+
+	while (lo < hi) {
+		uint32_t mi = lo + (hi - lo) / 2;
+		uint32_t got = nth_midxed_pack_int_id(m, pack_pos_to_midx(m, mi));
+
+		if (got == preferred || got < pack_int_id)
+			lo = mi + 1;
+		else
+			hi = mi;
+	}
+
+	return lo;
+}
+
+static void prepare_reuse_packs(struct bitmap_index *bitmap_git,
+				int multi_pack_reuse,
+				struct bitmapped_pack **packs,
+				size_t *packs_nr)
+{
+	size_t packs_alloc = 0;
+	struct multi_pack_index *m = bitmap_git->midx;
+	uint32_t preferred, i;
+
+	*packs = NULL;
+	*packs_nr = 0;
+
+	if (!bitmap_is_midx(bitmap_git)) {
+		ALLOC_GROW(*packs, 1, packs_alloc);
+		(*packs)[0].p = bitmap_git->pack;
+		(*packs)[0].from_midx = NULL;
+		(*packs)[0].pack_int_id = 0;
+		(*packs)[0].bitmap_pos = 0;
+		(*packs)[0].bitmap_nr = bitmap_git->pack->num_objects;
+		*packs_nr = 1;
+		return;
+	}
+
+	preferred = midx_preferred_pack(bitmap_git);
+	ALLOC_GROW(*packs, 1, packs_alloc);
+	(*packs)[0].p = m->packs[preferred];
+	(*packs)[0].from_midx = m;
+	(*packs)[0].pack_int_id = preferred;
+	(*packs)[0].bitmap_pos = 0;
+	(*packs)[0].bitmap_nr = m->packs[preferred]->num_objects;
+	*packs_nr = 1;
+
+	if (!multi_pack_reuse)
+		return;
+
+	for (i = 0; i < m->num_packs; i++) {
+		struct bitmapped_pack *pack;
+		uint32_t start, end;
+
+		if (i == preferred)
+			continue;
+
+		start = midx_pack_bitmap_pos(m, preferred, i);
+		end = midx_pack_bitmap_pos(m, preferred, i + 1);
+		if (start == end)
+			continue;
+
+		ALLOC_GROW(*packs, *packs_nr + 1, packs_alloc);
+		pack = &(*packs)[(*packs_nr)++];
+		pack->p = m->packs[i];
+		pack->from_midx = m;
+		pack->pack_int_id = i;
+		pack->bitmap_pos = start;
+		pack->bitmap_nr = end - start;
+	}
+}
+
 int reuse_partial_packfile_from_bitmap(struct bitmap_index *bitmap_git,
-				       struct packed_git **packfile_out,
+				       struct bitmapped_pack **packs_out,
+				       size_t *packs_nr_out,
 				       uint32_t *entries,
-				       struct bitmap **reuse_out)
+				       struct bitmap **reuse_out,
+				       int multi_pack_reuse)
 {
-	struct packed_git *pack;
+	struct bitmapped_pack *packs;
+	size_t packs_nr, j;
 	struct bitmap *result = bitmap_git->result;
 	struct bitmap *reuse;
 	struct pack_window *w_curs = NULL;
 	size_t i = 0;
 	uint32_t offset;
-	uint32_t objects_nr;
 
 	assert(result);
 
 	load_reverse_index(bitmap_git);
-
-	if (bitmap_is_midx(bitmap_git))
-		pack = bitmap_git->midx->packs[midx_preferred_pack(bitmap_git)];
-	else
-		pack = bitmap_git->pack;
-	objects_nr = pack->num_objects;
+	prepare_reuse_packs(bitmap_git, multi_pack_reuse, &packs, &packs_nr);
 
 	while (i < result->word_alloc && result->words[i] == (eword_t)~0)
 		i++;
 
 	/*
-	 * Don't mark objects not in the packfile or preferred pack. This bitmap
-	 * marks objects eligible for reuse, but the pack-reuse code only
-	 * understands how to reuse a single pack. Since the preferred pack is
-	 * guaranteed to have all bases for its deltas (in a multi-pack bitmap),
-	 * we use it instead of another pack. In single-pack bitmaps, the choice
-	 * is made for us.
+	 * Don't mark objects beyond the first pack in bulk. Its bits come
+	 * first and are in pack order, so whole words can be reused
+	 * as-is; the bits of any other pack are inspected one by one
+	 * below.
 	 */
-	if (i > objects_nr / BITS_IN_EWORD)
-		i = objects_nr / BITS_IN_EWORD;
+	if (i > packs[0].bitmap_nr / BITS_IN_EWORD)
+		i = packs[0].bitmap_nr / BITS_IN_EWORD;
 
 	reuse = bitmap_word_alloc(i);
 	memset(reuse->words, 0xFF, i * sizeof(eword_t));
 
-	for (; i < result->word_alloc; ++i) {
-		eword_t word = result->words[i];
-		size_t pos = (i * BITS_IN_EWORD);
+	for (j = 0; j < packs_nr; j++) {
+		struct bitmapped_pack *pack = &packs[j];
+		size_t pos = pack->bitmap_pos;
+		size_t end = pack->bitmap_pos + pack->bitmap_nr;
 
-		for (offset = 0; offset < BITS_IN_EWORD; ++offset) {
-			if ((word >> offset) == 0)
+		if (pos < i * BITS_IN_EWORD)
+			pos = i * BITS_IN_EWORD;
+
+		for (; pos < end; pos++) {
+			size_t word_idx = pos / BITS_IN_EWORD;
+			eword_t word;
+
+			if (word_idx >= result->word_alloc)
 				break;
 
-			offset += ewah_bit_ctz64(word >> offset);
-			if (try_partial_reuse(pack, pos + offset,
+			word = result->words[word_idx] >> (pos % BITS_IN_EWORD);
+			if (!word) {
+				/* skip to the next word */
+				pos = (word_idx + 1) * BITS_IN_EWORD - 1;
+				continue;
+			}
+
+			offset = ewah_bit_ctz64(word);
+			pos += offset;
+			if (pos >= end)
+				break;
+
+			if (try_partial_reuse(bitmap_git, pack, pos,
 					      reuse, &w_curs) < 0) {
 				/*
 				 * try_partial_reuse indicated we couldn't reuse
 				 * any bits, so there is no point in trying more
-				 * bits in the current word, or any other words
-				 * in result.
-				 *
-				 * Jump out of both loops to avoid future
-				 * unnecessary calls to try_partial_reuse.
+				 * bits in this pack.
 				 */
-				goto done;
+				break;
 			}
 		}
 	}
 
-done:
 	unuse_pack(&w_curs);
 
 	*entries = bitmap_popcount(reuse);
 	if (!*entries) {
 		bitmap_free(reuse);
+		free(packs);
 		return -1;
 	}
 
+	/* Drop any packs from which nothing is reused. */
+	for (i = j = 0; j < packs_nr; j++) {
+		struct bitmapped_pack *pack = &packs[j];
+		size_t pos;
+
+		for (pos = pack->bitmap_pos;
+		     pos < pack->bitmap_pos + pack->bitmap_nr; pos++)
+			if (bitmap_get(reuse, pos))
+				break;
+		if (pos < pack->bitmap_pos + pack->bitmap_nr)
+			packs[i++] = *pack;
+	}
+	packs_nr = i;
+
 	/*
 	 * Drop any reused objects from the result, since they will not
 	 * need to be handled separately.
 	 */
 	bitmap_and_not(result, reuse);
-	*packfile_out = pack;
+	*packs_out = packs;
+	*packs_nr_out = packs_nr;
 	*reuse_out = reuse;
 	return 0;
 }
@@ -1835,6 +1968,126 @@ int bitmap_walk_contains(struct bitmap_index *bitmap_git,
 	return idx >= 0 && bitmap_get(bitmap, idx);
 }
 
+struct bitmap_index *prepare_reachability_bitmap(struct repository *r)
+{
+	struct raw_object_store *o = r->objects;
+
+	if (o->reachability_bitmap_attempted)
+		return o->reachability_bitmap;
+	o->reachability_bitmap_attempted = 1;
+
+	/*
+	 * Bitmaps record the history as written, so they cannot answer
+	 * questions about a history altered by grafts, replace objects
+	 * or shallow boundaries.
+	 */
+	if (!commit_graph_compatible(r))
+		return NULL;
+
+	o->reachability_bitmap = prepare_bitmap_git(r);
+	return o->reachability_bitmap;
+}
+
+int bitmap_tips_reachable_from_bases(struct repository *r,
+				     struct commit_list *bases,
+				     struct commit **tips, size_t tips_nr,
+				     unsigned int mark)
+{
+	struct bitmap_index *bitmap_git = prepare_reachability_bitmap(r);
+	struct bitmap *reachable;
+	size_t i;
+
+	if (!bitmap_git)
+		return -1;
+
+	/*
+	 * Only combine stored bitmaps; filling in the gaps would need a
+	 * revision walk, whose object flags belong to our caller.
+	 */
+	reachable = bitmap_new();
+	for (; bases; bases = bases->next) {
+		struct ewah_bitmap *stored;
+
+		stored = bitmap_for_commit(bitmap_git, bases->item);
+		if (!stored) {
+			bitmap_free(reachable);
+			return -1;
+		}
+		bitmap_or_ewah(reachable, stored);
+	}
+
+	for (i = 0; i < tips_nr; i++)
+		if (bitmap_walk_contains(bitmap_git, reachable,
+					 &tips[i]->object.oid))
+			tips[i]->object.flags |= mark;
+
+	bitmap_free(reachable);
+	return 0;
+}
+
+int bitmap_commit_reaches_any(struct repository *r,
+			      struct commit *from,
+			      struct commit_list *to)
+{
+	struct bitmap_index *bitmap_git = prepare_reachability_bitmap(r);
+	struct ewah_bitmap *reachable;
+
+	if (!bitmap_git)
+		return -1;
+
+	reachable = bitmap_for_commit(bitmap_git, from);
+	if (!reachable)
+		return -1;
+
+	for (; to; to = to->next) {
+		int pos = bitmap_position(bitmap_git, &to->item->object.oid);
+
+		if (pos >= 0 && (uint32_t)pos < bitmap_num_objects(bitmap_git) &&
+		    ewah_get(reachable, pos))
+			return 1;
+	}
+
+	return 0;
+}
+
+struct bitmap *bitmap_selected_reachable(struct bitmap_index *bitmap_git)
+{
+	struct bitmap *result = bitmap_new();
+
+	if (bitmap_git->table_lookup) {
+		uint32_t i;
+
+		for (i = 0; i < bitmap_git->entry_count; i++) {
+			struct bitmap_lookup_table_triplet triplet;
+			struct object_id oid;
+			struct commit *commit;
+			struct ewah_bitmap *bitmap;
+
+			if (bitmap_lookup_table_get_triplet(bitmap_git, i, &triplet) < 0 ||
+			    nth_bitmap_object_oid(bitmap_git, &oid, triplet.commit_pos) < 0)
+				goto fail;
+			commit = lookup_commit(the_repository, &oid);
+			if (!commit)
+				goto fail;
+			bitmap = bitmap_for_commit(bitmap_git, commit);
+			if (!bitmap)
+				goto fail;
+			bitmap_or_ewah(result, bitmap);
+		}
+	} else {
+		struct stored_bitmap *sb;
+
+		kh_foreach_value(bitmap_git->bitmaps, sb, {
+			bitmap_or_ewah(result, lookup_stored_bitmap(sb));
+		});
+	}
+	return result;
+
+fail:
+	bitmap_free(result);
+	return NULL;
+}
+
 void traverse_bitmap_commit_list(struct bitmap_index *bitmap_git,
 				 struct rev_info *revs,
 				 show_reachable_fn show_reachable)
@@ -1858,16 +2111,9 @@ static uint32_t count_object_type(struct bitmap_index *bitmap_git,
 	struct bitmap *objects = bitmap_git->result;
 	struct eindex *eindex = &bitmap_git->ext_index;
 
-	uint32_t i = 0, count = 0;
-	struct ewah_iterator it;
-	eword_t filter;
-
-	init_type_iterator(&it, bitmap_git, type);
+	uint32_t i, count;
 
-	while (i < objects->word_alloc && ewah_iterator_next(&filter, &it)) {
-		eword_t word = objects->words[i++] & filter;
-		count += ewah_bit_popcount64(word);
-	}
+	count = bitmap_and_ewah_popcount(objects, type_bitmap(bitmap_git, type));
 
 	for (i = 0; i < eindex->count; ++i) {
 		if (eindex->objects[i]->type == type &&
@@ -2101,6 +2347,7 @@ int test_bitmap_hashes(struct repository *r)
 }
 
 int rebuild_bitmap(const uint32_t *reposition,
+		   struct bitmap *contiguous,
 		   struct ewah_bitmap *source,
 		   struct bitmap *dest)
 {
@@ -2113,6 +2360,17 @@ int rebuild_bitmap(const uint32_t *reposition,
 	while (ewah_iterator_next(&word, &it)) {
 		uint32_t offset, bit_pos;
 
+		if (word && contiguous &&
+		    bitmap_get(contiguous, pos / BITS_IN_EWORD)) {
+			/*
+			 * Every object in this word moved by the same
+			 * amount, so we can translate the word as a whole.
+			 */
+			bitmap_or_word(dest, reposition[pos] - 1, word);
+			pos += BITS_IN_EWORD;
+			continue;
+		}
+
 		for (offset = 0; offset < BITS_IN_EWORD; ++offset) {
 			if ((word >> offset) == 0)
 				break;
@@ -2132,7 +2390,8 @@ int rebuild_bitmap(const uint32_t *reposition,
 }
 
 uint32_t *create_bitmap_mapping(struct bitmap_index *bitmap_git,
-				struct packing_data *mapping)
+				struct packing_data *mapping,
+				struct bitmap **contiguous)
 {
 	uint32_t i, num_objects;
 	uint32_t *reposition;
@@ -2165,6 +2424,29 @@ uint32_t *create_bitmap_mapping(struct bitmap_index *bitmap_git,
 		}
 	}
 
+	if (contiguous) {
+		/*
+		 * Mark the words of the old bitmap whose objects all
+		 * survived and kept their relative order. This is the
+		 * common case when new objects were merely added (e.g.,
+		 * a MIDX gaining a pack), and lets rebuild_bitmap()
+		 * translate those words without visiting each bit.
+		 */
+		*contiguous = bitmap_word_alloc(DIV_ROUND_UP(num_objects,
+							     BITS_IN_EWORD));
+		for (i = 0; i + BITS_IN_EWORD <= num_objects; i += BITS_IN_EWORD) {
+			uint32_t j;
+
+			if (!reposition[i])
+				continue;
+			for (j = 1; j < BITS_IN_EWORD; j++)
+				if (reposition[i + j] != reposition[i] + j)
+					break;
+			if (j == BITS_IN_EWORD)
+				bitmap_set(*contiguous, i / BITS_IN_EWORD);
+		}
+	}
+
 	return reposition;
 }
 
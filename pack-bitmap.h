@@ -8,6 +8,7 @@
 #include "string-list.h"
 
 struct commit;
+struct commit_list;
 struct repository;
 struct rev_info;
 
@@ -65,10 +66,39 @@ int test_bitmap_hashes(struct repository *r);
 struct bitmap_index *prepare_bitmap_walk(struct rev_info *revs,
 					 int filter_provided_objects);
 uint32_t midx_preferred_pack(struct bitmap_index *bitmap_git);
+
+/*
+ * A pack whose objects may be reused verbatim, along with the range of
+ * bit positions its objects occupy in the bitmap.
+ */
+struct bitmapped_pack {
+	struct packed_git *p;
+
+	uint32_t bitmap_pos;
+	uint32_t bitmap_nr;
+
+	struct multi_pack_index *from_midx; /* MIDX only */
+	uint32_t pack_int_id; /* MIDX only */
+};
+
+/*
+ * Return the offset within 'pack' of the object at bit position 'pos',
+ * which must be within the pack's range.
+ */
+off_t bitmapped_pack_pos_to_offset(struct bitmapped_pack *pack, uint32_t pos);
+
+/*
+ * Select objects from the result of the last walk that can be sent
+ * verbatim. On success, '*packs_out' holds the packs those objects come
+ * from, in bit order, and '*reuse_out' the reused objects. Only the
+ * MIDX's preferred pack is considered unless 'multi_pack_reuse' is set.
+ */
 int reuse_partial_packfile_from_bitmap(struct bitmap_index *,
-				       struct packed_git **packfile,
+				       struct bitmapped_pack **packs_out,
+				       size_t *packs_nr_out,
 				       uint32_t *entries,
-				       struct bitmap **reuse_out);
+				       struct bitmap **reuse_out,
+				       int multi_pack_reuse);
 int rebuild_existing_bitmaps(struct bitmap_index *, struct packing_data *mapping,
 			     kh_oid_map_t *reused_bitmaps, int show_progress);
 void free_bitmap_index(struct bitmap_index *);
@@ -82,6 +112,38 @@ int bitmap_walk_contains(struct bitmap_index *,
  */
 int bitmap_has_oid_in_uninteresting(struct bitmap_index *, const struct object_id *oid);
 
+/*
+ * Return the reachability bitmap of the repository, loading it on first
+ * use. The result is owned by the object store and released by
+ * close_object_store(); NULL is returned if there is no usable bitmap.
+ */
+struct bitmap_index *prepare_reachability_bitmap(struct repository *r);
+
+/*
+ * Add 'mark' to the flags of every commit in 'tips' that is reachable
+ * from at least one commit in 'bases'. Returns -1 without touching any
+ * flags unless every commit in 'bases' has a stored bitmap.
+ */
+int bitmap_tips_reachable_from_bases(struct repository *r,
+				     struct commit_list *bases,
+				     struct commit **tips, size_t tips_nr,
+				     unsigned int mark);
+
+/*
+ * Return 1 if any commit in 'to' is reachable from 'from', and 0 if none
+ * is. Returns -1 if 'from' has no stored bitmap.
+ */
+int bitmap_commit_reaches_any(struct repository *r,
+			      struct commit *from,
+			      struct commit_list *to);
+
+/*
+ * Return the objects reachable from any commit that has a stored bitmap.
+ * All objects reachable from these are known to be present, as they were
+ * all walked when the bitmaps were written. Returns NULL on error.
+ */
+struct bitmap *bitmap_selected_reachable(struct bitmap_index *bitmap_git);
+
 off_t get_disk_usage_from_bitmap(struct bitmap_index *, struct rev_info *);
 
 void bitmap_writer_show_progress(int show);
@@ -89,9 +151,17 @@ void bitmap_writer_set_checksum(const unsigned char *sha1);
 void bitmap_writer_build_type_index(struct packing_data *to_pack,
 				    struct pack_idx_entry **index,
 				    uint32_t index_nr);
+/*
+ * Map each object position of 'bitmap_git' to its (1-based) position in
+ * 'mapping', or 0 if the object is not part of it. If 'contiguous' is
+ * non-NULL, it receives a bitmap marking the words of the old order
+ * whose objects appear contiguously and in the same order in 'mapping'.
+ */
 uint32_t *create_bitmap_mapping(struct bitmap_index *bitmap_git,
-				struct packing_data *mapping);
+				struct packing_data *mapping,
+				struct bitmap **contiguous);
 int rebuild_bitmap(const uint32_t *reposition,
+		   struct bitmap *contiguous,
 		   struct ewah_bitmap *source,
 		   struct bitmap *dest);
 struct ewah_bitmap *bitmap_for_commit(struct bitmap_index *bitmap_git,
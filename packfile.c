@@ -23,6 +23,7 @@
 #include "midx.h"
 #include "commit-graph.h"
 #include "pack-revindex.h"
+#include "pack-bitmap.h"
 #include "promisor-remote.h"
 #include "wrapper.h"
 
@@ -365,6 +366,14 @@ void close_object_store(struct raw_object_store *o)
 {
 	struct packed_git *p;
 
+	/*
+	 * The bitmap may refer to the MIDX (and its reverse index), so
+	 * release it before closing the MIDX below.
+	 */
+	free_bitmap_index(o->reachability_bitmap);
+	o->reachability_bitmap = NULL;
+	o->reachability_bitmap_attempted = 0;
+
 	for (p = o->packed_git; p; p = p->next)
 		if (p->do_not_close)
 			BUG("want to close pack marked 'do-not-close'");
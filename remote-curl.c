@@ -1315,6 +1315,57 @@ static void parse_get(const char *arg)
 	fflush(stdout);
 }
 
+static void parse_get_batch(struct strbuf *buf)
+{
+	struct http_file_request *requests = NULL;
+	size_t nr = 0, alloc = 0, i;
+
+	/*
+	 * The files of a batch are downloaded at once, so that they can
+	 * be transferred concurrently, possibly over a single HTTP/2
+	 * connection.
+	 */
+	do {
+		const char *arg, *space;
+
+		if (!skip_prefix(buf->buf, "get-batch ", &arg))
+			die(_("http transport does not support %s"), buf->buf);
+
+		space = strchr(arg, ' ');
+		if (!space)
+			die(_("protocol error: expected '<url> <path>', missing space"));
+
+		ALLOC_GROW(requests, nr + 1, alloc);
+		requests[nr].url = xmemdupz(arg, space - arg);
+		requests[nr].filename = xstrdup(space + 1);
+		nr++;
+
+		strbuf_reset(buf);
+		if (strbuf_getline_lf(buf, stdin) == EOF)
+			goto cleanup;
+		if (!*buf->buf)
+			break;
+	} while (1);
+
+	if (http_get_files(requests, nr)) {
+		for (i = 0; i < nr; i++)
+			if (requests[i].result != HTTP_OK)
+				die(_("failed to download file at URL '%s'"),
+				    requests[i].url);
+	}
+
+	printf("\n");
+	fflush(stdout);
+	strbuf_reset(buf);
+
+cleanup:
+	for (i = 0; i < nr; i++) {
+		free((char *)requests[i].url);
+		free((char *)requests[i].filename);
+	}
+	free(requests);
+}
+
 static int push_dav(int nr_spec, const char **specs)
 {
 	struct child_process child = CHILD_PROCESS_INIT;
@@ -1597,10 +1648,14 @@ int cmd_main(int argc, const char **argv)
 			parse_get(arg);
 			fflush(stdout);
 
+		} else if (starts_with(buf.buf, "get-batch ")) {
+			parse_get_batch(&buf);
+
 		} else if (!strcmp(buf.buf, "capabilities")) {
 			printf("stateless-connect\n");
 			printf("fetch\n");
 			printf("get\n");
+			printf("get-batch\n");
 			printf("option\n");
 			printf("push\n");
 			printf("check-connectivity\n");
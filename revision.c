@@ -2353,14 +2353,12 @@ static int handle_revision_opt(struct rev_info *revs, int argc, const char **arg
 		revs->topo_order = 1;
 		revs->rewrite_parents = 1;
 		revs->simplify_history = 0;
-		revs->limited = 1;
 	} else if (!strcmp(arg, "--simplify-by-decoration")) {
 		revs->simplify_merges = 1;
 		revs->topo_order = 1;
 		revs->rewrite_parents = 1;
 		revs->simplify_history = 0;
 		revs->simplify_by_decoration = 1;
-		revs->limited = 1;
 		revs->prune = 1;
 	} else if (!strcmp(arg, "--date-order")) {
 		revs->sort_order = REV_SORT_BY_COMMIT_DATE;
@@ -2830,6 +2828,33 @@ static void NORETURN diagnose_missing_default(const char *def)
 	    refname);
 }
 
+/*
+ * --simplify-merges needs to see the whole history before it can show
+ * anything, unless it can lean on generation numbers to walk in topo
+ * order incrementally; see simplify_lazily().
+ */
+static int can_simplify_merges_incrementally(struct rev_info *revs)
+{
+	int i;
+
+	if (!revs->topo_order ||
+	    !generation_numbers_enabled(the_repository) ||
+	    revs->first_parent_only ||
+	    revs->remove_empty_trees ||
+	    revs->max_age != -1 ||
+	    revs->max_age_as_filter != -1 ||
+	    revs->boundary ||
+	    revs->reflog_info ||
+	    revs->line_level_traverse ||
+	    revs->exclude_promisor_objects)
+		return 0;
+
+	for (i = 0; i < revs->pending.nr; i++)
+		if (revs->pending.objects[i].item->flags & UNINTERESTING)
+			return 0;
+	return 1;
+}
+
 /*
  * Parse revision information, filling in the "rev_info" structure,
  * and removing the used arguments from the argument list.
@@ -2987,6 +3012,9 @@ int setup_revisions(int argc, const char **argv, struct rev_info *revs, struct s
 	if (revs->topo_order && !generation_numbers_enabled(the_repository))
 		revs->limited = 1;
 
+	if (revs->simplify_merges && !can_simplify_merges_incrementally(revs))
+		revs->limited = 1;
+
 	if (revs->prune_data.nr) {
 		copy_pathspec(&revs->pruning.pathspec, &revs->prune_data);
 		/* Can't prune commits with rename following: the paths change.. */
@@ -3116,6 +3144,16 @@ static int remove_duplicate_parents(struct rev_info *revs, struct commit *commit
 
 struct merge_simplify_state {
 	struct commit *simplified;
+
+	/*
+	 * Used only when merges are simplified lazily during an
+	 * incremental topo-order walk; see simplify_lazily().
+	 */
+	struct commit_list *orig_parents;
+	unsigned want_rewrite:1,
+		 topo_walked:1,
+		 parents_rewritten:1,
+		 rewritten:1;
 };
 
 static struct merge_simplify_state *locate_simplify_state(struct rev_info *revs, struct commit *commit)
@@ -3477,6 +3515,7 @@ static int topo_walk_atexit_registered;
 static unsigned int count_explore_walked;
 static unsigned int count_indegree_walked;
 static unsigned int count_topo_walked;
+static unsigned int count_simplify_walked;
 
 static void trace2_topo_walk_statistics_atexit(void)
 {
@@ -3486,6 +3525,7 @@ static void trace2_topo_walk_statistics_atexit(void)
 	jw_object_intmax(&jw, "count_explore_walked", count_explore_walked);
 	jw_object_intmax(&jw, "count_indegree_walked", count_indegree_walked);
 	jw_object_intmax(&jw, "count_topo_walked", count_topo_walked);
+	jw_object_intmax(&jw, "count_simplify_walked", count_simplify_walked);
 	jw_end(&jw);
 
 	trace2_data_json("topo_walk", the_repository, "statistics", &jw);
@@ -3502,6 +3542,24 @@ static inline void test_flag_and_insert(struct prio_queue *q, struct commit *c,
 	prio_queue_put(q, c);
 }
 
+/*
+ * When merges are simplified lazily, the parents of a commit may be
+ * rewritten before the topo walk reaches it; the walk itself must keep
+ * following the original history for its in-degree counts to add up.
+ */
+static struct commit_list *topo_walk_parents(struct rev_info *revs,
+					     struct commit *commit)
+{
+	struct merge_simplify_state *st;
+
+	if (!revs->simplify_merges)
+		return commit->parents;
+	st = lookup_decoration(&revs->merge_simplification, &commit->object);
+	if (st && st->parents_rewritten)
+		return st->orig_parents;
+	return commit->parents;
+}
+
 static void explore_walk_step(struct rev_info *revs)
 {
 	struct topo_walk_info *info = revs->topo_walk_info;
@@ -3528,7 +3586,7 @@ static void explore_walk_step(struct rev_info *revs)
 	if (c->object.flags & UNINTERESTING)
 		mark_parents_uninteresting(revs, c);
 
-	for (p = c->parents; p; p = p->next)
+	for (p = topo_walk_parents(revs, c); p; p = p->next)
 		test_flag_and_insert(&info->explore_queue, p->item, TOPO_WALK_EXPLORED);
 }
 
@@ -3558,7 +3616,7 @@ static void indegree_walk_step(struct rev_info *revs)
 
 	explore_to_depth(revs, commit_graph_generation(c));
 
-	for (p = c->parents; p; p = p->next) {
+	for (p = topo_walk_parents(revs, c); p; p = p->next) {
 		struct commit *parent = p->item;
 		int *pi = indegree_slab_at(&info->indegree, parent);
 
@@ -3706,7 +3764,7 @@ static void expand_topo_walk(struct rev_info *revs, struct commit *commit)
 
 	count_topo_walked++;
 
-	for (p = commit->parents; p; p = p->next) {
+	for (p = topo_walk_parents(revs, commit); p; p = p->next) {
 		struct commit *parent = p->item;
 		int *pi;
 		timestamp_t generation;
@@ -3734,6 +3792,164 @@ static void expand_topo_walk(struct rev_info *revs, struct commit *commit)
 	}
 }
 
+/*
+ * Before mark_redundant_parents() looks at the parents of a merge, every
+ * commit that reduce_heads() may walk through must already have had its
+ * own parents rewritten, exactly as simplify_merges() would have done
+ * for the whole history.  reduce_heads() never looks past the smallest
+ * generation number among the heads.  Queue the commits in that range
+ * that are not rewritten yet and return how many there were.
+ */
+static int push_unrewritten_ancestors(struct rev_info *revs,
+				      struct commit *commit,
+				      struct commit_list **stack)
+{
+	struct commit_list *p, *todo = NULL;
+	struct oidset seen = OIDSET_INIT;
+	timestamp_t cutoff = GENERATION_NUMBER_INFINITY;
+	int pushed = 0;
+
+	for (p = commit->parents; p; p = p->next) {
+		timestamp_t generation = commit_graph_generation(p->item);
+		if (generation < cutoff)
+			cutoff = generation;
+		commit_list_insert(p->item, &todo);
+	}
+
+	while (todo) {
+		struct commit *c = pop_commit(&todo);
+		struct merge_simplify_state *st;
+
+		if (oidset_insert(&seen, &c->object.oid) ||
+		    commit_graph_generation(c) < cutoff)
+			continue;
+
+		st = locate_simplify_state(revs, c);
+		if (!st->rewritten) {
+			st->want_rewrite = 1;
+			commit_list_insert(c, stack);
+			pushed++;
+			continue;
+		}
+		for (p = c->parents; p; p = p->next)
+			commit_list_insert(p->item, &todo);
+	}
+
+	oidset_clear(&seen);
+	return pushed;
+}
+
+/*
+ * The lazy counterpart of simplify_one().  Returns 1 after pushing the
+ * commits whose simplification is needed first, 0 once the commit is
+ * done.  Unlike simplify_one(), the simplification of a commit that
+ * touches the paths is known without looking at its parents, so a
+ * single-parent commit only has its parents rewritten when somebody
+ * asks for it (i.e. it is shown, or a merge looks through it).
+ */
+static int simplify_lazily_one(struct rev_info *revs, struct commit *commit,
+			       struct commit_list **stack)
+{
+	struct merge_simplify_state *st = locate_simplify_state(revs, commit);
+	struct commit_list *p;
+	struct commit *parent;
+	int cnt;
+
+	if (st->rewritten || (st->simplified && !st->want_rewrite))
+		return 0;
+
+	if (process_parents(revs, commit, NULL, NULL) < 0) {
+		if (!revs->ignore_missing_links)
+			die("Failed to traverse parents of commit %s",
+			    oid_to_hex(&commit->object.oid));
+	}
+
+	if ((commit->object.flags & UNINTERESTING) || !commit->parents) {
+		st->simplified = commit;
+		st->rewritten = 1;
+		count_simplify_walked++;
+		return 0;
+	}
+
+	if (!st->parents_rewritten) {
+		if (!st->want_rewrite && !commit->parents->next &&
+		    !(commit->object.flags & TREESAME)) {
+			st->simplified = commit;
+			count_simplify_walked++;
+			return 0;
+		}
+
+		for (cnt = 0, p = commit->parents; p; p = p->next) {
+			if (!locate_simplify_state(revs, p->item)->simplified) {
+				commit_list_insert(p->item, stack);
+				cnt++;
+			}
+		}
+		if (cnt)
+			return 1;
+
+		if (!st->topo_walked)
+			st->orig_parents = copy_commit_list(commit->parents);
+		for (p = commit->parents; p; p = p->next)
+			p->item = locate_simplify_state(revs, p->item)->simplified;
+		st->parents_rewritten = 1;
+		remove_duplicate_parents(revs, commit);
+	}
+
+	cnt = commit_list_count(commit->parents);
+	if (1 < cnt) {
+		int marked;
+
+		if (push_unrewritten_ancestors(revs, commit, stack))
+			return 1;
+
+		marked = mark_redundant_parents(commit);
+		marked += mark_treesame_root_parents(commit);
+		if (marked)
+			marked -= leave_one_treesame_to_parent(revs, commit);
+		if (marked)
+			cnt = remove_marked_parents(revs, commit);
+	}
+	st->rewritten = 1;
+	count_simplify_walked++;
+
+	if (!cnt ||
+	    (commit->object.flags & UNINTERESTING) ||
+	    !(commit->object.flags & TREESAME) ||
+	    (parent = one_relevant_parent(revs, commit->parents)) == NULL ||
+	    (revs->show_pulls && (commit->object.flags & PULL_MERGE)))
+		st->simplified = commit;
+	else
+		st->simplified = locate_simplify_state(revs, parent)->simplified;
+	return 0;
+}
+
+/*
+ * Work out what "commit" simplifies to, as simplify_merges() would have,
+ * but looking only at as much history as is needed to answer that.  If
+ * the commit simplifies to itself, its parents are rewritten so that it
+ * can be shown.
+ */
+static struct commit *simplify_lazily(struct rev_info *revs,
+				      struct commit *commit)
+{
+	struct merge_simplify_state *st = locate_simplify_state(revs, commit);
+	struct commit_list *stack = NULL;
+
+	/* The topo walk has expanded "commit" and needs its parents no more. */
+	st->topo_walked = 1;
+	free_commit_list(st->orig_parents);
+	st->orig_parents = NULL;
+
+	st->want_rewrite = 1;
+	commit_list_insert(commit, &stack);
+	while (stack) {
+		if (!simplify_lazily_one(revs, stack->item, &stack))
+			pop_commit(&stack);
+	}
+	return st->simplified;
+}
+
 int prepare_revision_walk(struct rev_info *revs)
 {
 	int i;
@@ -3788,7 +4004,8 @@ int prepare_revision_walk(struct rev_info *revs)
 		 * history traversal.
 		 */
 		line_log_filter(revs);
-	if (revs->simplify_merges)
+	/* the incremental topo walk simplifies merges as it goes */
+	if (revs->simplify_merges && !revs->topo_walk_info)
 		simplify_merges(revs);
 	if (revs->children.name)
 		set_children(revs);
@@ -4143,9 +4360,12 @@ static struct commit *get_revision_1(struct rev_info *revs)
 
 			if (revs->reflog_info)
 				try_to_simplify_commit(revs, commit);
-			else if (revs->topo_walk_info)
+			else if (revs->topo_walk_info) {
 				expand_topo_walk(revs, commit);
-			else if (process_parents(revs, commit, &revs->commits, NULL) < 0) {
+				if (revs->simplify_merges && revs->prune &&
+				    simplify_lazily(revs, commit) != commit)
+					continue;
+			} else if (process_parents(revs, commit, &revs->commits, NULL) < 0) {
 				if (!revs->ignore_missing_links)
 					die("Failed to traverse parents of commit %s",
 						oid_to_hex(&commit->object.oid));
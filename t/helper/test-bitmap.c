@@ -1,7 +1,11 @@
 #include "test-tool.h"
 #include "git-compat-util.h"
+#include "alloc.h"
+#include "ewah/ewok.h"
+#include "ewah/ewok_rlw.h"
 #include "pack-bitmap.h"
 #include "setup.h"
+#include "strbuf.h"
 
 static int bitmap_list_commits(void)
 {
@@ -13,13 +17,91 @@ static int bitmap_dump_hashes(void)
 	return test_bitmap_hashes(the_repository);
 }
 
-int cmd__bitmap(int argc, const char **argv)
+static void print_words(const char *name, struct bitmap *bitmap)
 {
-	setup_git_directory();
+	size_t i;
+
+	printf("%s:", name);
+	for (i = 0; i < bitmap->word_alloc; i++)
+		printf(" %"PRIx64, (uint64_t)bitmap->words[i]);
+	putchar('\n');
+}
+
+/*
+ * Build an EWAH bitmap word by word from stdin, so that malformed
+ * ones can be described too, and show the result of combining it
+ * with a flat bitmap. Input lines are one of:
+ *
+ *   bits <n>                       set the bit size of the EWAH bitmap
+ *   rlw <run-bit> <run> <literals> append a run-length word
+ *   literal <hex>                  append a literal word
+ *   flat <hex>                     append a word to the flat bitmap
+ */
+static int bitmap_ewah_ops(void)
+{
+	struct ewah_bitmap *ewah = ewah_new();
+	struct bitmap *flat = bitmap_word_alloc(0);
+	struct bitmap *result;
+	struct strbuf line = STRBUF_INIT;
+
+	/* Start from an empty buffer rather than the initial marker word. */
+	ewah->buffer_size = 0;
+
+	while (strbuf_getline(&line, stdin) != EOF) {
+		const char *arg;
+		char *end;
+
+		if (skip_prefix(line.buf, "bits ", &arg)) {
+			ewah->bit_size = strtoumax(arg, &end, 10);
+		} else if (skip_prefix(line.buf, "rlw ", &arg)) {
+			eword_t word = 0;
+
+			rlw_set_run_bit(&word, !!strtoumax(arg, &end, 10));
+			rlw_set_running_len(&word, strtoumax(end, &end, 10));
+			rlw_set_literal_words(&word, strtoumax(end, &end, 10));
+			ALLOC_GROW(ewah->buffer, ewah->buffer_size + 1,
+				   ewah->alloc_size);
+			ewah->buffer[ewah->buffer_size++] = word;
+		} else if (skip_prefix(line.buf, "literal ", &arg)) {
+			ALLOC_GROW(ewah->buffer, ewah->buffer_size + 1,
+				   ewah->alloc_size);
+			ewah->buffer[ewah->buffer_size++] = strtoumax(arg, &end, 16);
+		} else if (skip_prefix(line.buf, "flat ", &arg)) {
+			REALLOC_ARRAY(flat->words, flat->word_alloc + 1);
+			flat->words[flat->word_alloc++] = strtoumax(arg, &end, 16);
+		} else {
+			die("unknown input line: %s", line.buf);
+		}
+		if (*end)
+			die("malformed input line: %s", line.buf);
+	}
 
+	result = ewah_to_bitmap(ewah);
+	print_words("to-bitmap", result);
+	bitmap_free(result);
+
+	printf("and-popcount: %"PRIuMAX"\n",
+	       (uintmax_t)bitmap_and_ewah_popcount(flat, ewah));
+
+	bitmap_or_ewah(flat, ewah);
+	print_words("or-ewah", flat);
+
+	bitmap_free(flat);
+	ewah_free(ewah);
+	strbuf_release(&line);
+	return 0;
+}
+
+int cmd__bitmap(int argc, const char **argv)
+{
 	if (argc != 2)
 		goto usage;
 
+	if (!strcmp(argv[1], "ewah-ops"))
+		return bitmap_ewah_ops();
+
+	setup_git_directory();
+
 	if (!strcmp(argv[1], "list-commits"))
 		return bitmap_list_commits();
 	if (!strcmp(argv[1], "dump-hashes"))
@@ -27,7 +109,8 @@ int cmd__bitmap(int argc, const char **argv)
 
 usage:
 	usage("\ttest-tool bitmap list-commits\n"
-	      "\ttest-tool bitmap dump-hashes");
+	      "\ttest-tool bitmap dump-hashes\n"
+	      "\ttest-tool bitmap ewah-ops");
 
 	return -1;
 }
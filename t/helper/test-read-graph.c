@@ -44,6 +44,8 @@ int cmd__read_graph(int argc UNUSED, const char **argv UNUSED)
 		printf(" bloom_indexes");
 	if (graph->chunk_bloom_data)
 		printf(" bloom_data");
+	if (graph->chunk_first_parent_jumps)
+		printf(" first_parent_jumps");
 	printf("\n");
 
 	printf("options:");
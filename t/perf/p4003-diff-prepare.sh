@@ -0,0 +1,42 @@
+#!/bin/sh
+
+test_description='Test xdiff record preparation on large files'
+. ./perf-lib.sh
+
+test_perf_fresh_repo
+
+# Both pairs of files have the same lines. In "ends-*", only the first
+# and last lines differ, so after the common prefix and suffix are
+# trimmed there is nothing left for the diff algorithm to do, and the
+# time is spent splitting and hashing the records. In "spread-*", every
+# hundredth line differs, which adds the work of the algorithm itself.
+test_expect_success 'setup' '
+	test_seq 1 500000 |
+	sed "s/$/: the quick brown fox jumps over the lazy dog/" >lines &&
+
+	{ echo first-a && cat lines && echo last-a; } >ends-a &&
+	{ echo first-b && cat lines && echo last-b; } >ends-b &&
+
+	cp lines spread-a &&
+	awk "NR % 100 == 0 { print \$0 \" changed\"; next } 1" \
+		<lines >spread-b
+'
+
+for alg in myers histogram patience
+do
+	test_perf "diff --diff-algorithm=$alg, changes at the ends only" "
+		test_expect_code 1 git diff --no-index --diff-algorithm=$alg \
+			ends-a ends-b >/dev/null
+	"
+
+	test_perf "diff --diff-algorithm=$alg, changes spread throughout" "
+		test_expect_code 1 git diff --no-index --diff-algorithm=$alg \
+			spread-a spread-b >/dev/null
+	"
+done
+
+test_perf 'diff -w, changes at the ends only' '
+	test_expect_code 1 git diff --no-index -w ends-a ends-b >/dev/null
+'
+
+test_done
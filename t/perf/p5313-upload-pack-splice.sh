@@ -0,0 +1,28 @@
+#!/bin/sh
+
+test_description='upload-pack relaying pack data with and without splice()'
+. ./perf-lib.sh
+
+test_perf_default_repo
+
+test_expect_success 'repack' '
+	git repack -ad
+'
+
+for splice in true false
+do
+	if test "$splice" = true
+	then
+		no_splice=0
+	else
+		no_splice=1
+	fi
+
+	test_perf "clone (splice=$splice)" "
+		rm -rf clone.git &&
+		GIT_TEST_UPLOAD_PACK_NO_SPLICE=$no_splice \
+			git clone --no-local --bare . clone.git
+	"
+done
+
+test_done
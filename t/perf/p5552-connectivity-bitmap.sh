@@ -0,0 +1,40 @@
+#!/bin/sh
+
+test_description='connectivity check with many refs
+
+After a fetch or push, the received objects are checked to be connected
+to the existing history. With "rev-list --not --all" this has to look at
+every ref, so it gets slow in repositories with very many refs even if
+only a few objects were received.
+'
+. ./perf-lib.sh
+
+test_perf_default_repo
+
+test_expect_success 'create many refs and a bitmap' '
+	git rev-list --first-parent -n 1000 HEAD |
+	awk "{ print \"create refs/many/\" NR \" \" \$1 }" |
+	git update-ref --stdin &&
+	git rev-list HEAD -n 10000 |
+	awk "{ print \"create refs/more/\" NR \" \" \$1 }" |
+	git update-ref --stdin &&
+	git pack-refs --all &&
+	git repack -adb
+'
+
+test_expect_success 'create an unreachable commit' '
+	blob=$(echo new | git hash-object -w --stdin) &&
+	tree=$(printf "100644 blob $blob\tnew-file\n" | git mktree) &&
+	git commit-tree -p HEAD -m new $tree >new
+'
+
+for value in false true
+do
+	test_perf "quickfetch (transfer.bitmapConnectivityCheck=$value)" "
+		git update-ref -d refs/heads/new-commit &&
+		git -c transfer.bitmapConnectivityCheck=$value \
+			fetch . \$(cat new):refs/heads/new-commit
+	"
+done
+
+test_done
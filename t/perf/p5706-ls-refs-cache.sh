@@ -0,0 +1,42 @@
+#!/bin/sh
+
+test_description='ls-refs advertisement with many refs, with and without lsrefs.cache'
+. ./perf-lib.sh
+
+test_perf_default_repo
+
+test_expect_success 'create many refs' '
+	git rev-list --first-parent -n 1000 HEAD >commits &&
+	for i in $(test_seq 1 100)
+	do
+		awk -v i=$i "{ print \"create refs/many/\" i \"/\" NR \" \" \$1 }" \
+			commits || return 1
+	done | git update-ref --stdin &&
+	git pack-refs --all &&
+	find .git/refs -type d >dirs &&
+	test-tool chmtime =-10 .git/packed-refs $(cat dirs)
+'
+
+test_expect_success 'prepare ls-refs request' '
+	test-tool pkt-line pack >in <<-EOF
+	command=ls-refs
+	object-format=$(test_oid algo)
+	0001
+	symrefs
+	peel
+	0000
+	EOF
+'
+
+for value in false true
+do
+	test_expect_success "set lsrefs.cache=$value" "
+		git config lsrefs.cache $value
+	"
+
+	test_perf "ls-refs (lsrefs.cache=$value)" "
+		test-tool serve-v2 --stateless-rpc <in >/dev/null
+	"
+done
+
+test_done
@@ -0,0 +1,35 @@
+#!/bin/sh
+
+test_description='Tests git blame performance'
+. ./perf-lib.sh
+
+test_perf_default_repo
+
+# Pick the file that was changed most often in recent history, so that
+# blame has many diffs to run.
+test_expect_success 'select a file' '
+	git log --format= --name-only --no-renames -1000 HEAD |
+	sort | uniq -c | sort -rn -k 1,1 -k 2 |
+	sed -n "1s/^ *[0-9]* //p" >filelist
+'
+
+file=$(cat filelist)
+export file
+
+test_perf 'git blame (1 thread)' '
+	git -c blame.threads=1 blame -- "$file" >/dev/null
+'
+
+test_perf 'git blame (all CPUs)' '
+	git -c blame.threads=0 blame -- "$file" >/dev/null
+'
+
+test_perf 'git blame -M (1 thread)' '
+	git -c blame.threads=1 blame -M -- "$file" >/dev/null
+'
+
+test_perf 'git blame -M (all CPUs)' '
+	git -c blame.threads=0 blame -M -- "$file" >/dev/null
+'
+
+test_done
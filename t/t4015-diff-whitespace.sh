@@ -2299,6 +2299,47 @@ test_expect_success 'compare mixed whitespace delta across moved blocks' '
 	test_cmp expected actual
 '
 
+test_expect_success 'move detection with blocks starting at common lines' '
+	test_write_lines "}" "first line of the block that moves" \
+		"second line of the block that moves" "}" "" \
+		"unchanged context line one" "unchanged context line two" \
+		"unchanged context line three" "}" "" "}" \
+		"another moved line, also long enough" "}" >a &&
+	test_write_lines "unchanged context line one" \
+		"unchanged context line two" "unchanged context line three" \
+		"}" "another moved line, also long enough" "}" "" "}" \
+		"first line of the block that moves" \
+		"second line of the block that moves" "}" "" "}" >b &&
+	test_expect_code 1 git diff --no-index --color --color-moved=zebra \
+		a b >actual.raw &&
+	sed -n "/@@/,\$p" <actual.raw | test_decode_color >actual &&
+
+	cat <<-\EOF >expected &&
+	<CYAN>@@ -1,13 +1,13 @@<RESET>
+	<RED>-}<RESET>
+	<BOLD;MAGENTA>-first line of the block that moves<RESET>
+	<BOLD;MAGENTA>-second line of the block that moves<RESET>
+	<BOLD;MAGENTA>-}<RESET>
+	<BOLD;MAGENTA>-<RESET>
+	 unchanged context line one<RESET>
+	 unchanged context line two<RESET>
+	 unchanged context line three<RESET>
+	 }<RESET>
+	<BOLD;CYAN>+<RESET><BOLD;CYAN>another moved line, also long enough<RESET>
+	<GREEN>+<RESET><GREEN>}<RESET>
+	 <RESET>
+	 }<RESET>
+	<BOLD;MAGENTA>-another moved line, also long enough<RESET>
+	<BOLD;CYAN>+<RESET><BOLD;CYAN>first line of the block that moves<RESET>
+	<BOLD;CYAN>+<RESET><BOLD;CYAN>second line of the block that moves<RESET>
+	<BOLD;CYAN>+<RESET><BOLD;CYAN>}<RESET>
+	<BOLD;CYAN>+<RESET>
+	 }<RESET>
+	EOF
+
+	test_cmp expected actual
+'
+
 test_expect_success 'combine --ignore-blank-lines with --function-context' '
 	test_write_lines 1 "" 2 3 4 5 >a &&
 	test_write_lines 1    2 3 4   >b &&
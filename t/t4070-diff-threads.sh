@@ -0,0 +1,74 @@
+#!/bin/sh
+
+test_description='diff.threads produces the same output as a single thread'
+
+. ./test-lib.sh
+
+test_expect_success 'setup' '
+	for i in $(test_seq 1 40)
+	do
+		test_seq 1 $((i * 10)) >file$i &&
+		printf "func$i() {\n\treturn $i;\n}\n" >func$i.c || return 1
+	done &&
+	printf "\0binary" >bin &&
+	git add . &&
+	test_tick &&
+	git commit -m one &&
+
+	for i in $(test_seq 1 40)
+	do
+		test_seq 2 $((i * 10 + 3)) >file$i &&
+		printf "func$i() {\n\treturn -$i;\n}\n" >>func$i.c || return 1
+	done &&
+	git mv file40 moved40 &&
+	printf "\0other binary" >bin &&
+	sed -n "100,200p" file30 >>file1 &&
+	sed -e "100,200d" file30 >tmp &&
+	mv tmp file30 &&
+	git add . &&
+	test_tick &&
+	git commit -m two &&
+
+	echo "unstaged" >>file2 &&
+	echo "unstaged" >>file3 &&
+	echo "unstaged" >>func3.c &&
+	echo "*.c diff=cpp" >.gitattributes
+'
+
+test_diff_threads () {
+	test_expect_success "diff.threads: $*" "
+		git -c diff.threads=1 $* >expect &&
+		GIT_TRACE2_EVENT=\"\$(pwd)/trace2.txt\" \
+			git -c diff.threads=4 $* >actual &&
+		grep '\"key\":\"patch_threads\",\"value\":\"[2-4]\"' trace2.txt &&
+		rm trace2.txt &&
+		test_cmp expect actual
+	"
+}
+
+test_diff_threads diff HEAD^ HEAD
+test_diff_threads diff -M --stat -p HEAD^ HEAD
+test_diff_threads diff --binary HEAD^ HEAD
+test_diff_threads diff --color=always HEAD^ HEAD
+test_diff_threads diff --color=always --color-moved=zebra HEAD^ HEAD
+test_diff_threads diff -W HEAD^ HEAD
+test_diff_threads diff
+test_diff_threads diff HEAD
+test_diff_threads log -p --format=%s
+test_diff_threads diff-tree -r -p HEAD
+test_diff_threads format-patch --stdout -1
+
+test_expect_success 'diff.threads falls back to one thread for word diff' '
+	git -c diff.threads=1 diff --word-diff HEAD^ HEAD >expect &&
+	GIT_TRACE2_EVENT="$(pwd)/trace2.txt" \
+		git -c diff.threads=4 diff --word-diff HEAD^ HEAD >actual &&
+	! grep patch_threads trace2.txt &&
+	test_cmp expect actual
+'
+
+test_expect_success 'diff.threads reports changes for --exit-code' '
+	test_expect_code 1 git -c diff.threads=4 diff --exit-code HEAD^ HEAD >/dev/null &&
+	git -c diff.threads=4 diff --exit-code HEAD HEAD
+'
+
+test_done
@@ -922,4 +922,54 @@ test_expect_success 'check the input format when --stdin is passed' '
 	test_cmp expect actual
 '
 
+test_expect_success '--stdin merges into the same branch match separate merges' '
+	test_when_finished "rm -rf stdin-repo" &&
+	git init stdin-repo &&
+	(
+		cd stdin-repo &&
+		mkdir dir &&
+		test_seq 1 20 >dir/numbers &&
+		test_seq 21 40 >dir/other &&
+		test_write_lines a b c >greeting &&
+		git add . &&
+		git commit -m base &&
+
+		git branch topic1 &&
+		git branch topic2 &&
+		git switch -c upstream &&
+		git mv dir/numbers sequence &&
+		test_write_lines a b upstream >greeting &&
+		git commit -m upstream &&
+
+		git switch topic1 &&
+		test_seq 1 21 >dir/numbers &&
+		test_write_lines a b topic1 >greeting &&
+		git commit -a -m topic1 &&
+
+		git switch topic2 &&
+		test_seq 0 20 >dir/numbers &&
+		echo new >dir/new &&
+		git add dir/new &&
+		git commit -m topic2 &&
+
+		printf "upstream topic1\nupstream topic2\nupstream topic1\n" >input &&
+		git merge-tree --stdin <input >actual &&
+		>expect &&
+		while read -r line
+		do
+			echo "$line" | git merge-tree --stdin >>expect ||
+			return 1
+		done <input &&
+		test_cmp expect actual &&
+
+		# rename detection is not repeated for the same upstream
+		GIT_TRACE2_PERF="$(pwd)/trace.output" \
+			git -c merge.renameCache=true merge-tree --stdin \
+			<input >actual &&
+		test_cmp expect actual &&
+		grep region_enter.*diffcore_rename trace.output >calls &&
+		test_line_count = 1 calls
+	)
+'
+
 test_done
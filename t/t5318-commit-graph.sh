@@ -839,4 +839,62 @@ test_expect_success 'overflow during generation version upgrade' '
 	)
 '
 
+test_expect_success 'setup repo for first-parent jumps' '
+	cd "$TRASH_DIRECTORY" &&
+	git init -b main first-parent-jumps &&
+	(
+		cd first-parent-jumps &&
+		test_commit_bulk 40 &&
+		git checkout -b side HEAD~30 &&
+		test_commit_bulk --id=side 10 &&
+		git checkout main &&
+		git merge -m merge side &&
+		test_commit_bulk --id=after 10
+	)
+'
+
+test_expect_success 'write first-parent jumps' '
+	(
+		cd first-parent-jumps &&
+		git -c commitGraph.firstParentJumps=true \
+			commit-graph write --reachable &&
+		graph_read_expect 61 "generation_data first_parent_jumps" &&
+		git commit-graph verify
+	)
+'
+
+test_expect_success 'first-parent ancestors agree with and without jumps' '
+	(
+		cd first-parent-jumps &&
+		rm -f expect actual &&
+		for rev in main side main~9 main~11
+		do
+			for n in $(test_seq 0 52)
+			do
+				{
+					git -c core.commitGraph=false \
+						rev-parse --verify -q "$rev~$n" ||
+					echo "none: $rev~$n"
+				} >>expect &&
+				{
+					git rev-parse --verify -q "$rev~$n" ||
+					echo "none: $rev~$n"
+				} >>actual || return 1
+			done
+		done &&
+		test_cmp expect actual
+	)
+'
+
+test_expect_success 'first-parent jumps are kept unless disabled' '
+	(
+		cd first-parent-jumps &&
+		git commit-graph write --reachable &&
+		graph_read_expect 61 "generation_data first_parent_jumps" &&
+		git -c commitGraph.firstParentJumps=false \
+			commit-graph write --reachable &&
+		graph_read_expect 61 "generation_data"
+	)
+'
+
 test_done
@@ -648,4 +648,51 @@ test_expect_success 'write generation data chunk when commit-graph chain is repl
 	)
 '
 
+test_expect_success 'first-parent jumps across split layers' '
+	git init -b main split-jumps &&
+	(
+		cd split-jumps &&
+		test_commit_bulk 20 &&
+		git -c commitGraph.firstParentJumps=true \
+			commit-graph write --reachable --split=no-merge &&
+		test_commit_bulk --id=second 20 &&
+		git commit-graph write --reachable --split=no-merge &&
+		test_line_count = 2 $graphdir/commit-graph-chain &&
+		test-tool read-graph >output &&
+		grep "^chunks:.* first_parent_jumps" output &&
+		git commit-graph verify &&
+
+		for n in $(test_seq 0 40)
+		do
+			{
+				git -c core.commitGraph=false \
+					rev-parse --verify -q "main~$n" ||
+				echo "none: main~$n"
+			} >>expect &&
+			{
+				git rev-parse --verify -q "main~$n" ||
+				echo "none: main~$n"
+			} >>actual || return 1
+		done &&
+		test_cmp expect actual
+	)
+'
+
+test_expect_success 'no first-parent jumps on top of a layer without them' '
+	git init -b main split-no-jumps &&
+	(
+		cd split-no-jumps &&
+		test_commit_bulk 10 &&
+		git commit-graph write --reachable --split=no-merge &&
+		test_commit_bulk --id=second 10 &&
+		git -c commitGraph.firstParentJumps=true \
+			commit-graph write --reachable --split=no-merge &&
+		test_line_count = 2 $graphdir/commit-graph-chain &&
+		test-tool read-graph >output &&
+		! grep first_parent_jumps output &&
+		git commit-graph verify &&
+		git rev-parse main~15
+	)
+'
+
 test_done
@@ -410,6 +410,30 @@ test_expect_success 'preferred pack change with existing MIDX bitmap' '
 	)
 '
 
+test_expect_success 'existing MIDX bitmaps are reused word-wise' '
+	rm -fr repo &&
+	git init repo &&
+	test_when_finished "rm -fr repo" &&
+	(
+		cd repo &&
+
+		test_commit_bulk 128 &&
+		git tag old-tip &&
+		git repack -d &&
+		git multi-pack-index write --bitmap &&
+
+		test_commit_bulk --id=further 16 &&
+		git tag new-tip &&
+		git repack -d &&
+		GIT_TRACE2_EVENT="$(pwd)/trace" \
+			git multi-pack-index write --bitmap &&
+
+		grep "\"key\":\"building_bitmaps_contiguous_words\",\"value\":\"[1-9]" trace &&
+		git rev-list --test-bitmap refs/tags/old-tip &&
+		git rev-list --test-bitmap refs/tags/new-tip
+	)
+'
+
 test_expect_success 'tagged commits are selected for bitmapping' '
 	rm -fr repo &&
 	git init repo &&
@@ -0,0 +1,127 @@
+#!/bin/sh
+
+test_description='pack-objects multi-pack reuse'
+
+. ./test-lib.sh
+
+objdir=.git/objects
+packdir=$objdir/pack
+
+# test_reused <objects-reused> <packs-reused>
+test_reused () {
+	grep "\"key\":\"pack-reused\",\"value\":\"$1\"" trace2.txt &&
+	grep "\"key\":\"packs-reused\",\"value\":\"$2\"" trace2.txt
+}
+
+test_expect_success 'preferred pack is reused without pack.allowPackReuse=multi' '
+	for i in A B
+	do
+		test_commit "$i" &&
+		git repack -d || return 1
+	done &&
+
+	git multi-pack-index write --bitmap &&
+
+	: >trace2.txt &&
+	GIT_TRACE2_EVENT="$PWD/trace2.txt" \
+		git pack-objects --stdout --revs --all >/dev/null &&
+
+	test_reused 3 1
+'
+
+test_expect_success 'reuse all objects from all packs' '
+	git config pack.allowPackReuse multi &&
+
+	: >trace2.txt &&
+	GIT_TRACE2_EVENT="$PWD/trace2.txt" \
+		git pack-objects --stdout --revs --all >/dev/null &&
+
+	test_reused 6 2
+'
+
+test_expect_success 'reuse objects from a subset of packs' '
+	test_commit C &&
+	git repack -d &&
+	git multi-pack-index write --bitmap &&
+
+	cat >in <<-EOF &&
+	$(git rev-parse C)
+	^$(git rev-parse B)
+	EOF
+
+	: >trace2.txt &&
+	GIT_TRACE2_EVENT="$PWD/trace2.txt" \
+		git pack-objects --stdout --revs <in >/dev/null &&
+
+	test_reused 3 1
+'
+
+test_expect_success 'reused pack can be indexed' '
+	git pack-objects --stdout --revs --all --delta-base-offset \
+		<in >got.pack &&
+	git index-pack --strict --stdin <got.pack
+'
+
+test_expect_success 'reused objects are sent before delta search' '
+	: >trace2.txt &&
+	GIT_TRACE2_EVENT="$PWD/trace2.txt" \
+		git pack-objects --stdout --revs --all >got.pack &&
+	git index-pack --strict --stdin <got.pack &&
+
+	grep -n "\"region_enter\".*\"label\":\"stream-reused-packs\"" \
+		trace2.txt >stream &&
+	grep -n "\"region_enter\".*\"label\":\"prepare-pack\"" \
+		trace2.txt >prepare &&
+	test $(cut -d: -f1 stream) -lt $(cut -d: -f1 prepare)
+'
+
+test_expect_success 'setup cross-pack deltas' '
+	git init cross &&
+	(
+		cd cross &&
+		git config pack.allowPackReuse multi &&
+
+		test_seq 1 1000 >file &&
+		git add file &&
+		test_tick &&
+		git commit -m base &&
+		git repack -d &&
+
+		test_seq 1 1001 >file &&
+		test_tick &&
+		git commit -a -m delta &&
+
+		# Store the new blob as a delta against the old one,
+		# so that its base is only found in the other pack.
+		cat >in <<-EOF &&
+		$(git rev-parse HEAD^:file)
+		$(git rev-parse HEAD:file)
+		EOF
+		git pack-objects $packdir/pack <in &&
+		git repack -d &&
+
+		git multi-pack-index write --bitmap
+	)
+'
+
+test_expect_success 'cross-pack deltas are reused' '
+	(
+		cd cross &&
+
+		: >trace2.txt &&
+		GIT_TRACE2_EVENT="$PWD/trace2.txt" \
+			git pack-objects --stdout --revs --all \
+			--delta-base-offset >got.pack &&
+
+		grep "\"key\":\"packs-reused\",\"value\":\"[2-9]\"" trace2.txt &&
+		git index-pack --strict --stdin <got.pack &&
+		git cat-file --batch-all-objects --batch-check >expect &&
+		git init --bare unpacked.git &&
+		git -C unpacked.git index-pack --strict --stdin <got.pack &&
+		git -C unpacked.git cat-file --batch-all-objects \
+			--batch-check >actual &&
+		test_cmp expect actual
+	)
+'
+
+test_done
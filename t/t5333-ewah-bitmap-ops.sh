@@ -0,0 +1,95 @@
+#!/bin/sh
+
+test_description='combining EWAH bitmaps with flat bitmaps'
+
+TEST_PASSES_SANITIZE_LEAK=true
+. ./test-lib.sh
+
+# The EWAH bitmap is described on stdin one word at a time; see
+# t/helper/test-bitmap.c for the format.
+test_ewah_ops () {
+	test-tool bitmap ewah-ops >actual &&
+	test_cmp expect actual
+}
+
+test_expect_success 'runs of ones and literal words' '
+	cat >expect <<-\EOF &&
+	to-bitmap: 0 ff ffffffffffffffff ffffffffffffffff 3
+	and-popcount: 10
+	or-ewah: 1 1ff ffffffffffffffff ffffffffffffffff 3
+	EOF
+	test_ewah_ops <<-\EOF
+	bits 300
+	rlw 0 1 1
+	literal ff
+	rlw 1 2 1
+	literal 3
+	flat 1
+	flat 1ff
+	flat 5
+	flat 0
+	EOF
+'
+
+test_expect_success 'bit size that is a multiple of the word size' '
+	cat >expect <<-\EOF &&
+	to-bitmap: ffffffffffffffff ffffffffffffffff
+	and-popcount: 2
+	or-ewah: ffffffffffffffff ffffffffffffffff ff
+	EOF
+	test_ewah_ops <<-\EOF
+	bits 128
+	rlw 1 2 0
+	flat 1
+	flat 8000000000000000
+	flat ff
+	EOF
+'
+
+test_expect_success 'run extending past the end of the bitmap' '
+	cat >expect <<-\EOF &&
+	to-bitmap: ffffffffffffffff ffffffffffffffff
+	and-popcount: 24
+	or-ewah: ffffffffffffffff ffffffffffffffff ffffffffffffffff
+	EOF
+	test_ewah_ops <<-\EOF
+	bits 128
+	rlw 1 1000 0
+	flat ff
+	flat ff
+	flat ff
+	EOF
+'
+
+test_expect_success 'literal words past the end of the bitmap' '
+	cat >expect <<-\EOF &&
+	to-bitmap: 1
+	and-popcount: 1
+	or-ewah: ff 2
+	EOF
+	test_ewah_ops <<-\EOF
+	bits 64
+	rlw 0 0 3
+	literal 1
+	literal 2
+	literal 4
+	flat ff
+	EOF
+'
+
+test_expect_success 'literal words past the end of the buffer' '
+	cat >expect <<-\EOF &&
+	to-bitmap: 0 1 0 0 0
+	and-popcount: 1
+	or-ewah: 0 3 0 0 0 0
+	EOF
+	test_ewah_ops <<-\EOF
+	bits 320
+	rlw 0 1 4
+	literal 1
+	flat 0
+	flat 3
+	EOF
+'
+
+test_done
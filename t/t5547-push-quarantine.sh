@@ -71,4 +71,23 @@ test_expect_success 'updating a ref from quarantine is forbidden' '
 	git -C update.git fsck
 '
 
+test_expect_success 'loose objects are flushed once in the quarantine' '
+	git init --bare batch.git &&
+	git -C batch.git config receive.unpackLimit 1000 &&
+	git -C batch.git config core.fsync loose-object &&
+	git -C batch.git config core.fsyncMethod batch &&
+	GIT_TRACE2_EVENT="$(pwd)/trace2.txt" GIT_TEST_FSYNC=true \
+		git push batch.git HEAD &&
+	grep "\"key\":\"loose-objects\",\"value\":\"quarantine\"" trace2.txt &&
+	! grep "\"key\":\"loose-objects\",\"value\":\"tmp-objdir\"" trace2.txt &&
+	if ! grep "core.fsyncMethod = batch is unsupported" trace2.txt
+	then
+		grep "\"fsync/hardware-flush\",\"value\":\"1\"" trace2.txt
+	fi &&
+	git -C batch.git fsck &&
+	git rev-parse HEAD >expect &&
+	git -C batch.git rev-parse HEAD >actual &&
+	test_cmp expect actual
+'
+
 test_done
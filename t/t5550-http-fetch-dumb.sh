@@ -247,6 +247,100 @@ test_expect_success 'http-fetch --packfile' '
 	git -C packfileclient cat-file -e "$HASH"
 '
 
+test_expect_success 'http-fetch --packfile in ranges' '
+	test_when_finished "rm -rf packfileclient trace" &&
+	ARBITRARY=$(git -C "$HTTPD_DOCUMENT_ROOT_PATH"/repo_pack.git rev-parse HEAD) &&
+
+	rm -rf packfileclient &&
+	git init packfileclient &&
+	p=$(cd "$HTTPD_DOCUMENT_ROOT_PATH"/repo_pack.git && ls objects/pack/pack-*.pack) &&
+	GIT_TEST_HTTP_PACK_RANGE_SIZE=10 GIT_TRACE2_PERF="$(pwd)/trace" \
+	git -C packfileclient -c http.packRanges=3 http-fetch --packfile=$ARBITRARY \
+		--index-pack-arg=index-pack --index-pack-arg=--stdin \
+		--index-pack-arg=--keep \
+		"$HTTPD_URL"/dumb/repo_pack.git/$p >out &&
+	grep "pack-ranges/count:3$" trace &&
+
+	grep -E "^keep.[0-9a-f]{16,}$" out &&
+	cut -c6- out >packhash &&
+	test -e "packfileclient/.git/objects/pack/pack-$(cat packhash).pack" &&
+	test -e "packfileclient/.git/objects/pack/pack-$(cat packhash).idx" &&
+	test_path_is_missing packfileclient/.git/objects/pack/pack-$ARBITRARY.pack.partial &&
+	test_path_is_missing packfileclient/.git/objects/pack/pack-$ARBITRARY.pack.partial-state &&
+
+	HASH=$(git -C "$HTTPD_DOCUMENT_ROOT_PATH"/repo_pack.git rev-parse HEAD) &&
+	git -C packfileclient cat-file -e "$HASH"
+'
+
+test_expect_success 'http-fetch --packfile resumes a ranged download' '
+	test_when_finished "rm -rf packfileclient trace" &&
+	ARBITRARY=$(git -C "$HTTPD_DOCUMENT_ROOT_PATH"/repo_pack.git rev-parse HEAD) &&
+
+	rm -rf packfileclient &&
+	git init packfileclient &&
+	p=$(cd "$HTTPD_DOCUMENT_ROOT_PATH"/repo_pack.git && ls objects/pack/pack-*.pack) &&
+
+	# Pretend that the first of two ranges was downloaded before.
+	size=$(wc -c <"$HTTPD_DOCUMENT_ROOT_PATH"/repo_pack.git/$p) &&
+	half=$(($size / 2)) &&
+	partial=packfileclient/.git/objects/pack/pack-$ARBITRARY.pack.partial &&
+	test_copy_bytes $half <"$HTTPD_DOCUMENT_ROOT_PATH"/repo_pack.git/$p >$partial &&
+	cat >$partial-state <<-EOF &&
+	pack-ranges v1
+	$size
+	0 $half $half
+	$half $size 0
+	EOF
+
+	GIT_TRACE2_PERF="$(pwd)/trace" \
+	git -C packfileclient -c http.packRanges=2 http-fetch --packfile=$ARBITRARY \
+		--index-pack-arg=index-pack --index-pack-arg=--stdin \
+		--index-pack-arg=--keep \
+		"$HTTPD_URL"/dumb/repo_pack.git/$p >out &&
+	grep "pack-ranges/resumed:$half$" trace &&
+	grep "pack-ranges/count:2$" trace &&
+	grep -E "^keep.[0-9a-f]{16,}$" out &&
+	test_path_is_missing $partial &&
+	test_path_is_missing $partial-state &&
+
+	HASH=$(git -C "$HTTPD_DOCUMENT_ROOT_PATH"/repo_pack.git rev-parse HEAD) &&
+	git -C packfileclient cat-file -e "$HASH"
+'
+
+test_expect_success 'http-fetch --packfile reports a rejected ranged download' '
+	test_when_finished "rm -rf packfileclient" &&
+	ARBITRARY=$(git -C "$HTTPD_DOCUMENT_ROOT_PATH"/repo_pack.git rev-parse HEAD) &&
+
+	rm -rf packfileclient &&
+	git init packfileclient &&
+	p=$(cd "$HTTPD_DOCUMENT_ROOT_PATH"/repo_pack.git && ls objects/pack/pack-*.pack) &&
+
+	# Pretend that garbage was downloaded for the first of two ranges.
+	size=$(wc -c <"$HTTPD_DOCUMENT_ROOT_PATH"/repo_pack.git/$p) &&
+	half=$(($size / 2)) &&
+	partial=packfileclient/.git/objects/pack/pack-$ARBITRARY.pack.partial &&
+	printf "%0${half}d" 0 >$partial &&
+	cat >$partial-state <<-EOF &&
+	pack-ranges v1
+	$size
+	0 $half $half
+	$half $size 0
+	EOF
+
+	test_must_fail git -C packfileclient -c http.packRanges=2 \
+		http-fetch --packfile=$ARBITRARY \
+		--index-pack-arg=index-pack --index-pack-arg=--stdin \
+		--index-pack-arg=--keep \
+		"$HTTPD_URL"/dumb/repo_pack.git/$p 2>err &&
+	grep "index-pack rejected pack $ARBITRARY" err &&
+	grep "unable to store pack file $ARBITRARY" err &&
+	! grep "unable to get pack file" err &&
+
+	# The next attempt starts over instead of resuming the garbage.
+	test_path_is_missing $partial &&
+	test_path_is_missing $partial-state
+'
+
 test_expect_success 'fetch notices corrupt pack' '
 	cp -R "$HTTPD_DOCUMENT_ROOT_PATH"/repo_pack.git "$HTTPD_DOCUMENT_ROOT_PATH"/repo_bad1.git &&
 	(cd "$HTTPD_DOCUMENT_ROOT_PATH"/repo_bad1.git &&
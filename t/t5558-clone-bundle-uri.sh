@@ -412,6 +412,136 @@ test_expect_success 'clone bundle list (http, creationToken)' '
 	test_cmp expect actual
 '
 
+test_expect_success 'clone bundle list (HTTP, all mode, parallel)' '
+	test_when_finished rm -f trace*.txt &&
+
+	cp clone-from/bundle-*.bundle "$HTTPD_DOCUMENT_ROOT_PATH/" &&
+	cat >"$HTTPD_DOCUMENT_ROOT_PATH/bundle-list" <<-EOF &&
+	[bundle]
+		version = 1
+		mode = all
+
+	[bundle "bundle-1"]
+		uri = $HTTPD_URL/bundle-1.bundle
+
+	[bundle "bundle-2"]
+		uri = $HTTPD_URL/bundle-2.bundle
+
+	[bundle "bundle-3"]
+		uri = $HTTPD_URL/bundle-3.bundle
+
+	[bundle "bundle-4"]
+		uri = $HTTPD_URL/bundle-4.bundle
+
+	# Does not exist. Should be skipped.
+	[bundle "bundle-5"]
+		uri = $HTTPD_URL/bundle-5.bundle
+	EOF
+
+	GIT_TRACE2_EVENT="$(pwd)/trace-clone.txt" \
+		git -c fetch.bundleParallel=3 \
+		clone --bundle-uri="$HTTPD_URL/bundle-list" \
+		clone-from clone-list-http-parallel 2>err &&
+	test_region bundle-uri download trace-clone.txt &&
+	! grep "Repository lacks these prerequisite commits" err &&
+	! grep "fatal" err &&
+	grep "warning: failed to download bundle from URI" err &&
+
+	git -C clone-from for-each-ref --format="%(objectname)" >oids &&
+	git -C clone-list-http-parallel cat-file --batch-check <oids &&
+
+	# The bundles are downloaded by a single helper, and the missing
+	# one is attempted again by a helper of its own.
+	test_remote_https_urls <trace-clone.txt >actual &&
+	test_line_count = 3 actual &&
+	grep -x "$HTTPD_URL/bundle-list" actual &&
+	tail -n 1 actual >last &&
+	echo "$HTTPD_URL/bundle-5.bundle" >expect &&
+	test_cmp expect last
+'
+
+test_expect_success 'clone bundle list (http, creationToken, parallel)' '
+	test_when_finished rm -f trace*.txt &&
+
+	cp clone-from/bundle-*.bundle "$HTTPD_DOCUMENT_ROOT_PATH/" &&
+	cat >"$HTTPD_DOCUMENT_ROOT_PATH/bundle-list" <<-EOF &&
+	[bundle]
+		version = 1
+		mode = all
+		heuristic = creationToken
+
+	[bundle "bundle-1"]
+		uri = bundle-1.bundle
+		creationToken = 1
+
+	[bundle "bundle-2"]
+		uri = bundle-2.bundle
+		creationToken = 2
+
+	[bundle "bundle-3"]
+		uri = bundle-3.bundle
+		creationToken = 3
+
+	[bundle "bundle-4"]
+		uri = bundle-4.bundle
+		creationToken = 4
+	EOF
+
+	GIT_TRACE2_EVENT="$(pwd)/trace-clone.txt" \
+		git -c fetch.bundleParallel=4 \
+		clone --bundle-uri="$HTTPD_URL/bundle-list" \
+		"$HTTPD_URL/smart/fetch.git" clone-list-http-parallel-2 &&
+
+	git -C clone-from for-each-ref --format="%(objectname)" >oids &&
+	git -C clone-list-http-parallel-2 cat-file --batch-check <oids &&
+	test_cmp_config -C clone-list-http-parallel-2 4 fetch.bundlecreationtoken &&
+
+	# The list, then all the bundles at once.
+	test_remote_https_urls <trace-clone.txt >actual &&
+	test_line_count = 2 actual &&
+	head -n 1 actual >first &&
+	echo "$HTTPD_URL/bundle-list" >expect &&
+	test_cmp expect first
+'
+
+test_expect_success 'clone bundle list (http, parallel, two hosts)' '
+	test_when_finished rm -f trace*.txt &&
+
+	other_url=$(echo "$HTTPD_URL" | sed "s/127\.0\.0\.1/localhost/") &&
+	cp clone-from/bundle-*.bundle "$HTTPD_DOCUMENT_ROOT_PATH/" &&
+	cat >"$HTTPD_DOCUMENT_ROOT_PATH/bundle-list" <<-EOF &&
+	[bundle]
+		version = 1
+		mode = all
+
+	[bundle "bundle-1"]
+		uri = $HTTPD_URL/bundle-1.bundle
+
+	[bundle "bundle-2"]
+		uri = $other_url/bundle-2.bundle
+
+	[bundle "bundle-3"]
+		uri = $HTTPD_URL/bundle-3.bundle
+
+	[bundle "bundle-4"]
+		uri = $other_url/bundle-4.bundle
+	EOF
+
+	GIT_TRACE2_EVENT="$(pwd)/trace-clone.txt" \
+		git -c fetch.bundleParallel=4 \
+		clone --bundle-uri="$HTTPD_URL/bundle-list" \
+		clone-from clone-list-http-two-hosts &&
+
+	git -C clone-from for-each-ref --format="%(objectname)" >oids &&
+	git -C clone-list-http-two-hosts cat-file --batch-check <oids &&
+
+	# The list, then one batch for each host.
+	test_remote_https_urls <trace-clone.txt >actual &&
+	test_line_count = 3 actual &&
+	grep "^$HTTPD_URL/bundle-[13]\.bundle$" actual &&
+	grep "^$other_url/bundle-[24]\.bundle$" actual
+'
+
 test_expect_success 'clone incomplete bundle list (http, creationToken)' '
 	test_when_finished rm -f trace*.txt &&
 
@@ -0,0 +1,146 @@
+#!/bin/sh
+
+: ${HTTP_PROTO:=HTTP/1.1}
+test_description="test the get-batch command of remote-curl ($HTTP_PROTO)"
+
+. ./test-lib.sh
+. "$TEST_DIRECTORY"/lib-httpd.sh
+test "$HTTP_PROTO" = "HTTP/2" && enable_http2
+start_httpd
+setup_askpass_helper
+
+test_expect_success HTTP2 'enable client-side http/2' '
+	git config --global http.version HTTP/2
+'
+
+test_expect_success 'setup files' '
+	for i in 1 2 3 4 5 6
+	do
+		test-tool genrandom file-$i 65536 \
+			>"$HTTPD_DOCUMENT_ROOT_PATH/file-$i" || return 1
+	done
+'
+
+test_expect_success 'get a batch of files' '
+	test_when_finished "rm -f get-*" &&
+	for i in 1 2 3 4 5 6
+	do
+		echo "get-batch $HTTPD_URL/file-$i get-$i" || return 1
+	done >input &&
+	echo >>input &&
+	git remote-https "$HTTPD_URL/" <input >actual &&
+	echo >expect &&
+	test_cmp expect actual &&
+	for i in 1 2 3 4 5 6
+	do
+		test_cmp "$HTTPD_DOCUMENT_ROOT_PATH/file-$i" get-$i || return 1
+	done
+'
+
+test_expect_success 'get commands are answered one at a time' '
+	test_when_finished "rm -f get-*" &&
+	cat >input <<-EOF &&
+	get $HTTPD_URL/file-1 get-1
+	get $HTTPD_URL/file-2 get-2
+	get-batch $HTTPD_URL/file-3 get-3
+	get-batch $HTTPD_URL/file-4 get-4
+
+	option verbosity 1
+	EOF
+	git remote-https "$HTTPD_URL/" <input >actual &&
+	cat >expect <<-\EOF &&
+
+
+
+	ok
+	EOF
+	test_cmp expect actual &&
+	for i in 1 2 3 4
+	do
+		test_cmp "$HTTPD_DOCUMENT_ROOT_PATH/file-$i" get-$i || return 1
+	done
+'
+
+test_expect_success 'partial downloads are resumed' '
+	test_when_finished "rm -f get-*" &&
+	test_copy_bytes 1000 <"$HTTPD_DOCUMENT_ROOT_PATH/file-1" >get-1.temp &&
+	cat >input <<-EOF &&
+	get-batch $HTTPD_URL/file-1 get-1
+	get-batch $HTTPD_URL/file-2 get-2
+
+	EOF
+	git remote-https "$HTTPD_URL/" <input &&
+	test_cmp "$HTTPD_DOCUMENT_ROOT_PATH/file-1" get-1 &&
+	test_cmp "$HTTPD_DOCUMENT_ROOT_PATH/file-2" get-2 &&
+	test_path_is_missing get-1.temp
+'
+
+test_expect_success 'failed downloads are reported after the batch' '
+	test_when_finished "rm -f get-*" &&
+	cat >input <<-EOF &&
+	get-batch $HTTPD_URL/missing get-missing
+	get-batch $HTTPD_URL/file-2 get-2
+
+	EOF
+	test_must_fail git remote-https "$HTTPD_URL/" <input 2>err &&
+	grep "failed to download file at URL .$HTTPD_URL/missing." err &&
+	test_path_is_missing get-missing &&
+	test_cmp "$HTTPD_DOCUMENT_ROOT_PATH/file-2" get-2
+'
+
+test_expect_success 'error pages are not kept when asking for credentials' '
+	test_when_finished "rm -f get-*" &&
+	mkdir -p "$HTTPD_DOCUMENT_ROOT_PATH/auth/dumb" &&
+	cp "$HTTPD_DOCUMENT_ROOT_PATH/file-1" \
+		"$HTTPD_DOCUMENT_ROOT_PATH/auth/dumb/file-1" &&
+	cat >input <<-EOF &&
+	get-batch $HTTPD_URL/auth/dumb/file-1 get-1
+	get-batch $HTTPD_URL/file-2 get-2
+
+	EOF
+	set_askpass user@host pass@host &&
+	git remote-https "$HTTPD_URL/" <input &&
+	expect_askpass both user@host &&
+	test_cmp "$HTTPD_DOCUMENT_ROOT_PATH/file-1" get-1 &&
+	test_cmp "$HTTPD_DOCUMENT_ROOT_PATH/file-2" get-2
+'
+
+test_expect_success 'credentials are not sent to other hosts' '
+	test_when_finished "rm -f get-*" &&
+	cp "$HTTPD_DOCUMENT_ROOT_PATH/file-3" \
+		"$HTTPD_DOCUMENT_ROOT_PATH/auth/dumb/file-3" &&
+	other_url=$(echo "$HTTPD_URL" | sed "s/127\.0\.0\.1/localhost/") &&
+	cat >input <<-EOF &&
+	get-batch $HTTPD_URL/auth/dumb/file-3 get-3
+	get-batch $other_url/auth/dumb/file-3 get-other
+
+	EOF
+	set_askpass user@host pass@host &&
+	test_must_fail git remote-https "$HTTPD_URL/" <input 2>err &&
+	grep "not downloading .$other_url/auth/dumb/file-3. from another host" err &&
+	expect_askpass both user@host &&
+	test_cmp "$HTTPD_DOCUMENT_ROOT_PATH/file-3" get-3 &&
+	test_path_is_missing get-other &&
+	grep " user@host .*GET /auth/dumb/file-3 " \
+		"$HTTPD_ROOT_PATH/access.log" >authenticated &&
+	test_line_count = 1 authenticated
+'
+
+test_expect_success HTTP2 'a batch shares a single connection' '
+	test_when_finished "rm -f get-* trace" &&
+	for i in 1 2 3 4 5 6
+	do
+		echo "get-batch $HTTPD_URL/file-$i get-$i" || return 1
+	done >input &&
+	echo >>input &&
+	GIT_TRACE_CURL="$(pwd)/trace" GIT_HTTP_MAX_REQUESTS=6 \
+		git remote-https "$HTTPD_URL/" <input &&
+	grep "Info: Connected to" trace >connections &&
+	test_line_count = 1 connections &&
+	for i in 1 2 3 4 5 6
+	do
+		test_cmp "$HTTPD_DOCUMENT_ROOT_PATH/file-$i" get-$i || return 1
+	done
+'
+
+test_done
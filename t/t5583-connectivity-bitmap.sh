@@ -0,0 +1,56 @@
+#!/bin/sh
+
+test_description='connectivity check using reachability bitmaps'
+
+GIT_TEST_DEFAULT_INITIAL_BRANCH_NAME=main
+export GIT_TEST_DEFAULT_INITIAL_BRANCH_NAME
+
+TEST_PASSES_SANITIZE_LEAK=true
+. ./test-lib.sh
+
+test_expect_success 'setup' '
+	test_commit_bulk 20 &&
+	git repack -adb &&
+	git clone --bare . dst.git &&
+	git -C dst.git repack -adb &&
+	git -C dst.git config transfer.bitmapConnectivityCheck true
+'
+
+test_expect_success 'push walks only the new objects' '
+	test_commit new &&
+	test_when_finished "rm -f trace.output" &&
+	GIT_TRACE2_PERF="$(pwd)/trace.output" git push dst.git main &&
+	grep "bitmap/walked:3$" trace.output &&
+	git -C dst.git fsck
+'
+
+test_expect_success 'hidden refs fall back to rev-list' '
+	test_commit hidden &&
+	test_config -C dst.git receive.hideRefs refs/hidden &&
+	test_when_finished "rm -f trace.output" &&
+	GIT_TRACE2_PERF="$(pwd)/trace.output" git push dst.git main &&
+	! grep "bitmap/walked" trace.output
+'
+
+test_expect_success 'unreachable but connected objects are accepted' '
+	git repack -adb &&
+	blob=$(echo unreachable | git hash-object -w --stdin) &&
+	tree=$(printf "100644 blob $blob\tfile\n" | git mktree) &&
+	commit=$(git commit-tree -p main -m unreachable $tree) &&
+	test_when_finished "rm -f trace.output" &&
+	GIT_TRACE2_PERF="$(pwd)/trace.output" \
+		git -c transfer.bitmapConnectivityCheck=true \
+		fetch . $commit:refs/heads/unreachable &&
+	grep "bitmap/walked:3$" trace.output
+'
+
+test_expect_success 'missing objects are found' '
+	missing=$(echo missing | git hash-object --stdin) &&
+	tree=$(printf "100644 blob $missing\tfile\n" | git mktree --missing) &&
+	commit=$(git commit-tree -p main -m broken $tree) &&
+	test_must_fail git -c transfer.bitmapConnectivityCheck=true \
+		fetch . $commit:refs/heads/broken &&
+	test_must_fail git rev-parse --verify refs/heads/broken
+'
+
+test_done
@@ -0,0 +1,69 @@
+#!/bin/sh
+
+test_description='upload-pack relaying pack data with splice()'
+
+GIT_TEST_DEFAULT_INITIAL_BRANCH_NAME=main
+export GIT_TEST_DEFAULT_INITIAL_BRANCH_NAME
+
+TEST_PASSES_SANITIZE_LEAK=true
+. ./test-lib.sh
+
+test_expect_success 'setup' '
+	test_commit_bulk 50 &&
+	test-tool genrandom big 2000000 >big &&
+	git add big &&
+	git commit -m big &&
+	git repack -ad
+'
+
+for v in 0 2
+do
+	test_expect_success "clone over protocol v$v" '
+		test_when_finished "rm -rf spliced copied trace.event" &&
+		GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+			git -c protocol.version=$v clone --no-local --bare \
+			--progress . spliced 2>err &&
+		grep "Receiving objects: 100%" err &&
+		if test_have_prereq SPLICE
+		then
+			grep "\"key\":\"spliced\",\"value\":\"[0-9]" trace.event
+		fi &&
+		GIT_TEST_UPLOAD_PACK_NO_SPLICE=1 \
+			git -c protocol.version=$v clone --no-local --bare \
+			. copied &&
+		git -C spliced fsck &&
+		git -C spliced for-each-ref >expect &&
+		git -C copied for-each-ref >actual &&
+		test_cmp expect actual &&
+		git -C spliced cat-file blob main:big >actual &&
+		test_cmp big actual
+	'
+done
+
+test_expect_success 'GIT_TEST_UPLOAD_PACK_NO_SPLICE disables splicing' '
+	test_when_finished "rm -rf copied trace.event" &&
+	GIT_TEST_UPLOAD_PACK_NO_SPLICE=1 GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+		git clone --no-local --bare . copied &&
+	! grep "\"key\":\"spliced\"" trace.event
+'
+
+# splice() cannot write to a file opened for appending, so upload-pack
+# has to fall back to copying the pack data.
+test_expect_success SPLICE 'pack data is copied if it cannot be spliced' '
+	test_when_finished "rm -rf in out pack trace.event unspliced.git" &&
+	{
+		echo "want $(git rev-parse main)" &&
+		echo 0000 &&
+		echo done
+	} | test-tool pkt-line pack >in &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+		git upload-pack --stateless-rpc . <in >>out &&
+	! grep "\"key\":\"spliced\"" trace.event &&
+	tail -c +9 out >pack &&
+	git init --bare unspliced.git &&
+	git -C unspliced.git index-pack --stdin <pack &&
+	git -C unspliced.git cat-file blob $(git rev-parse main:big) >actual &&
+	test_cmp big actual
+'
+
+test_done
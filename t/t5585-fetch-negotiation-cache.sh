@@ -0,0 +1,100 @@
+#!/bin/sh
+
+test_description='fetch with fetch.negotiationCache'
+
+GIT_TEST_DEFAULT_INITIAL_BRANCH_NAME=main
+export GIT_TEST_DEFAULT_INITIAL_BRANCH_NAME
+
+TEST_PASSES_SANITIZE_LEAK=true
+. ./test-lib.sh
+
+# Make local commits that are newer than anything the server has, so
+# that the negotiator sends them before reaching the common history.
+local_work () {
+	git -C "$1" checkout -q -B work &&
+	for i in $(test_seq 1 40)
+	do
+		test_commit -C "$1" --no-tag "$1-work-$i" || return 1
+	done
+}
+
+test_expect_success 'setup' '
+	git init server &&
+	test_commit -C server --no-tag one &&
+	git clone "file://$(pwd)/server" cached &&
+	git clone "file://$(pwd)/server" uncached &&
+	git -C cached config fetch.negotiationCache true &&
+	test_commit -C server --no-tag two &&
+	git -C cached fetch &&
+	git -C uncached fetch &&
+	test_path_is_dir cached/.git/negotiation-cache &&
+	local_work cached &&
+	local_work uncached
+'
+
+for v in 0 2
+do
+	test_expect_success "cached commits are sent first (protocol v$v)" '
+		git -C cached rev-parse origin/main >expect &&
+		test_commit -C server --no-tag three-v$v &&
+		test_when_finished "rm -f trace.packet trace.output" &&
+		GIT_TRACE_PACKET="$(pwd)/trace.packet" \
+		GIT_TRACE2_PERF="$(pwd)/trace.output" \
+			git -C cached -c protocol.version=$v fetch &&
+		grep "negotiation_cache/seeded:1$" trace.output &&
+		grep "fetch.*> have" trace.packet >haves &&
+		echo "have $(cat expect)" >expect.have &&
+		head -n 1 haves | sed -e "s/.*> //" >actual &&
+		test_cmp expect.have actual &&
+		git -C cached rev-parse origin/main >actual &&
+		git -C server rev-parse main >expect &&
+		test_cmp expect actual
+	'
+done
+
+test_expect_success 'one round is enough with a cached common commit' '
+	test_commit -C server --no-tag three &&
+	test_when_finished "rm -f trace.cached trace.uncached" &&
+	GIT_TRACE2_PERF="$(pwd)/trace.cached" \
+		git -C cached -c protocol.version=2 fetch &&
+	GIT_TRACE2_PERF="$(pwd)/trace.uncached" \
+		git -C uncached -c protocol.version=2 fetch &&
+	grep "total_rounds:1$" trace.cached &&
+	! grep "total_rounds:1$" trace.uncached
+'
+
+test_expect_success 'commits not reachable from our refs are not used' '
+	test_commit -C server --no-tag four &&
+	commit=$(git -C cached commit-tree -m dangling HEAD^{tree}) &&
+	for f in cached/.git/negotiation-cache/*
+	do
+		printf "negotiation-cache v1\n%s\n" $commit >$f || return 1
+	done &&
+	test_when_finished "rm -f trace.output" &&
+	GIT_TRACE2_PERF="$(pwd)/trace.output" git -C cached fetch &&
+	grep "negotiation_cache/seeded:0$" trace.output
+'
+
+test_expect_success 'commits the server does not have are harmless' '
+	test_commit -C server --no-tag five &&
+	git -C cached rev-parse HEAD >commit &&
+	for f in cached/.git/negotiation-cache/*
+	do
+		printf "negotiation-cache v1\n%s\n" $(cat commit) >$f || return 1
+	done &&
+	test_when_finished "rm -f trace.output" &&
+	GIT_TRACE2_PERF="$(pwd)/trace.output" git -C cached fetch &&
+	grep "negotiation_cache/seeded:1$" trace.output &&
+	git -C cached fsck &&
+	! grep -r $(cat commit) cached/.git/negotiation-cache
+'
+
+test_expect_success 'the cache is ignored without the config' '
+	test_commit -C server --no-tag six &&
+	test_when_finished "rm -f trace.output" &&
+	GIT_TRACE2_PERF="$(pwd)/trace.output" \
+		git -C cached -c fetch.negotiationCache=false fetch &&
+	! grep "negotiation_cache/seeded" trace.output
+'
+
+test_done
@@ -0,0 +1,69 @@
+#!/bin/sh
+
+test_description='git daemon handing connections to pre-started workers'
+
+GIT_TEST_DEFAULT_INITIAL_BRANCH_NAME=main
+export GIT_TEST_DEFAULT_INITIAL_BRANCH_NAME
+
+. ./test-lib.sh
+
+. "$TEST_DIRECTORY"/lib-git-daemon.sh
+
+write_script access-hook <<-EOF
+echo "\$1 \$REMOTE_ADDR" >>"$PWD/access.log"
+EOF
+
+GIT_TRACE2_EVENT="$PWD/trace" &&
+export GIT_TRACE2_EVENT &&
+# the hook is run by the shell, and our path has spaces
+start_git_daemon --worker-pool=2 --access-hook="\"$PWD/access-hook\"" &&
+sane_unset GIT_TRACE2_EVENT
+
+test_expect_success 'setup repository' '
+	test_commit one &&
+	git init --bare "$GIT_DAEMON_DOCUMENT_ROOT_PATH/repo.git" &&
+	: >"$GIT_DAEMON_DOCUMENT_ROOT_PATH/repo.git/git-daemon-export-ok" &&
+	git push "$GIT_DAEMON_DOCUMENT_ROOT_PATH/repo.git" main
+'
+
+for v in 0 2
+do
+	test_expect_success "clone and fetch with protocol v$v" '
+		test_when_finished "rm -rf clone$v" &&
+		git -c protocol.version=$v clone "$GIT_DAEMON_URL/repo.git" clone$v &&
+		test_cmp one.t clone$v/one.t &&
+		test_commit --no-tag two$v &&
+		git push "$GIT_DAEMON_DOCUMENT_ROOT_PATH/repo.git" main &&
+		git -C clone$v -c protocol.version=$v fetch &&
+		git rev-parse main >expect &&
+		git -C clone$v rev-parse origin/main >actual &&
+		test_cmp expect actual
+	'
+done
+
+test_expect_success 'workers see the client address' '
+	grep "^upload-pack 127.0.0.1$" access.log >lines &&
+	test_line_count = 4 lines
+'
+
+test_expect_success 'unexported repository is refused' '
+	git init --bare "$GIT_DAEMON_DOCUMENT_ROOT_PATH/private.git" &&
+	test_must_fail git ls-remote "$GIT_DAEMON_URL/private.git" 2>err &&
+	grep "access denied or repository not exported" err
+'
+
+test_expect_success 'connections are served by pre-started workers' '
+	# the initial pool, plus one replacement per connection
+	grep "\"event\":\"child_start\".*--pool-worker" trace >started &&
+	test_line_count -ge 7 started &&
+	! grep "\"event\":\"child_start\".*\"--serve\"" trace |
+		grep -v -e --pool-worker
+'
+
+test_expect_success '--worker-pool is incompatible with --inetd' '
+	test_must_fail git daemon --inetd --log-destination=stderr \
+		--worker-pool=2 2>err &&
+	grep "incompatible with --inetd" err
+'
+
+test_done
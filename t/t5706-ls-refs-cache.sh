@@ -0,0 +1,151 @@
+#!/bin/sh
+
+test_description='ls-refs with lsrefs.cache'
+
+GIT_TEST_DEFAULT_INITIAL_BRANCH_NAME=main
+export GIT_TEST_DEFAULT_INITIAL_BRANCH_NAME
+
+TEST_PASSES_SANITIZE_LEAK=true
+. ./test-lib.sh
+
+# Changes to the refs less than a second old are not cached; pretend
+# that they happened $1 seconds ago.  Use a different $1 each time, so
+# that the mtimes still differ from the ones before the change.
+backdate_refs () {
+	find .git/refs -type d >dirs &&
+	test-tool chmtime =-$1 .git/packed-refs $(cat dirs)
+}
+
+# Send an ls-refs request with each argument as an option line.
+ls_refs () {
+	{
+		echo command=ls-refs &&
+		echo object-format=$(test_oid algo) &&
+		echo 0001 &&
+		for arg in "$@"
+		do
+			echo "$arg" || return 1
+		done &&
+		echo 0000
+	} | test-tool pkt-line pack >in &&
+	rm -f trace.output &&
+	GIT_TRACE2_PERF="$(pwd)/trace.output" \
+		test-tool serve-v2 --stateless-rpc <in >out &&
+	test-tool pkt-line unpack <out
+}
+
+test_expect_success 'setup' '
+	test_commit one &&
+	git branch dev main &&
+	test_commit two &&
+	git symbolic-ref refs/heads/release refs/heads/main &&
+	git tag -a -m "annotated tag" annotated-tag &&
+	git pack-refs --all &&
+	git update-ref refs/heads/loose one &&
+	backdate_refs 100 &&
+	git config lsrefs.cache true
+'
+
+test_expect_success 'cached response matches' '
+	test_when_finished "rm -f trace.output" &&
+	ls_refs >expect &&
+	grep "ls-refs.*cache:miss" trace.output &&
+	ls_refs >actual &&
+	grep "ls-refs.*cache:hit" trace.output &&
+	test_cmp expect actual
+'
+
+test_expect_success 'cached response matches (symrefs, peel)' '
+	test_when_finished "rm -f trace.output" &&
+	ls_refs symrefs peel >expect &&
+	grep "ls-refs.*cache:miss" trace.output &&
+	grep "symref-target:refs/heads/main" expect &&
+	grep "peeled:" expect &&
+	ls_refs symrefs peel >actual &&
+	grep "ls-refs.*cache:hit" trace.output &&
+	test_cmp expect actual
+'
+
+test_expect_success 'cached response matches (ref-prefix)' '
+	test_when_finished "rm -f trace.output" &&
+	ls_refs "ref-prefix refs/tags/" >expect &&
+	grep "ls-refs.*cache:miss" trace.output &&
+	! grep refs/heads/ expect &&
+	ls_refs "ref-prefix refs/tags/" >actual &&
+	grep "ls-refs.*cache:hit" trace.output &&
+	test_cmp expect actual
+'
+
+test_expect_success 'updating a loose ref invalidates the cache' '
+	test_when_finished "rm -f trace.output" &&
+	ls_refs &&
+	grep "ls-refs.*cache:hit" trace.output &&
+	git update-ref refs/heads/loose two &&
+	ls_refs >actual &&
+	grep "ls-refs.*cache:miss" trace.output &&
+	grep "$(git rev-parse two) refs/heads/loose" actual
+'
+
+test_expect_success 'updating a packed ref invalidates the cache' '
+	test_when_finished "rm -f trace.output" &&
+	backdate_refs 90 &&
+	ls_refs &&
+	ls_refs &&
+	grep "ls-refs.*cache:hit" trace.output &&
+	git update-ref refs/heads/dev two &&
+	backdate_refs 80 &&
+	ls_refs >actual &&
+	grep "ls-refs.*cache:miss" trace.output &&
+	grep "$(git rev-parse two) refs/heads/dev" actual
+'
+
+test_expect_success 'deleting a packed ref invalidates the cache' '
+	test_when_finished "rm -f trace.output" &&
+	ls_refs &&
+	grep "ls-refs.*cache:hit" trace.output &&
+	git update-ref -d refs/heads/dev &&
+	backdate_refs 70 &&
+	ls_refs >actual &&
+	grep "ls-refs.*cache:miss" trace.output &&
+	! grep refs/heads/dev actual
+'
+
+test_expect_success 'HEAD is not cached' '
+	test_when_finished "rm -f trace.output" &&
+	ls_refs &&
+	git symbolic-ref HEAD refs/heads/loose &&
+	ls_refs >actual &&
+	grep "ls-refs.*cache:hit" trace.output &&
+	grep "$(git rev-parse two) HEAD" actual
+'
+
+test_expect_success 'hidden refs are part of the key' '
+	test_when_finished "rm -f trace.output" &&
+	test_config transfer.hideRefs refs/tags &&
+	ls_refs >actual &&
+	grep "ls-refs.*cache:miss" trace.output &&
+	! grep refs/tags actual
+'
+
+test_expect_success 'cache files are bounded' '
+	test_when_finished "rm -f trace.output" &&
+	for i in $(test_seq 50)
+	do
+		ls_refs "ref-prefix refs/heads/$i" || return 1
+	done &&
+	ls .git/ls-refs-cache >files &&
+	test_line_count -le 16 files
+'
+
+test_expect_success 'responses are not sent to other requests sharing their slot' '
+	test_when_finished "rm -f trace.output" &&
+	ls_refs "ref-prefix refs/tags/" >expect &&
+	for i in $(test_seq 50)
+	do
+		ls_refs "ref-prefix refs/heads/$i" || return 1
+	done &&
+	ls_refs "ref-prefix refs/tags/" >actual &&
+	test_cmp expect actual
+'
+
+test_done
@@ -285,4 +285,31 @@ test_expect_success 'log --graph --simplify-merges --show-pulls' '
 	test_cmp expect actual
 '
 
+test_expect_success 'incremental --simplify-merges with a commit-graph' '
+	test_when_finished "rm -f .git/objects/info/commit-graph" &&
+	for opts in "--parents --simplify-merges -- file" \
+		    "--parents --simplify-merges --show-pulls -- file" \
+		    "--graph --simplify-merges -- file" \
+		    "--parents --simplify-by-decoration"
+	do
+		git -c core.commitGraph=false log --format="%s %p" $opts \
+			>"expect.$(echo $opts | tr -dc a-z)" || return 1
+	done &&
+	git commit-graph write --reachable --changed-paths &&
+	for opts in "--parents --simplify-merges -- file" \
+		    "--parents --simplify-merges --show-pulls -- file" \
+		    "--graph --simplify-merges -- file" \
+		    "--parents --simplify-by-decoration"
+	do
+		git log --format="%s %p" $opts >actual &&
+		test_cmp "expect.$(echo $opts | tr -dc a-z)" actual || return 1
+	done &&
+
+	GIT_TRACE2_EVENT="$(pwd)/trace.txt" \
+		git log -1 --format=%s --simplify-merges --show-pulls -- file >actual &&
+	echo N >expect &&
+	test_cmp expect actual &&
+	grep "\"count_simplify_walked\":" trace.txt
+'
+
 test_done
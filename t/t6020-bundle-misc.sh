@@ -619,6 +619,34 @@ test_expect_success TTY 'create --quiet disables all bundle progress' '
 	test_must_be_empty err
 '
 
+test_expect_success 'create --reuse-pack copies data from the bitmapped pack' '
+	test_when_finished "rm -rf reuse.git reuse-dst.git trace.output" &&
+	git clone --bare . reuse.git &&
+	git -C reuse.git repack -adb &&
+
+	GIT_TRACE2_EVENT="$(pwd)/trace.output" \
+		git -C reuse.git bundle create --reuse-pack ../reuse.bundle --all &&
+	grep "\"key\":\"pack-reused\"" trace.output &&
+	git bundle verify reuse.bundle &&
+	git -C reuse.git bundle create ../expect.bundle --all &&
+	git bundle list-heads expect.bundle >expect &&
+	git bundle list-heads reuse.bundle >actual &&
+	test_cmp expect actual &&
+
+	git -C reuse.git bundle create --reuse-pack ../reuse-incr.bundle \
+		main~2..main &&
+	git bundle verify reuse-incr.bundle &&
+	git -C reuse.git bundle create ../expect-incr.bundle main~2..main &&
+	git bundle list-heads expect-incr.bundle >expect &&
+	git bundle list-heads reuse-incr.bundle >actual &&
+	test_cmp expect actual &&
+
+	git init --bare reuse-dst.git &&
+	git -C reuse-dst.git fetch ../reuse.bundle "refs/*:refs/*" &&
+	git -C reuse-dst.git fetch ../reuse-incr.bundle main:refs/heads/incr &&
+	git -C reuse-dst.git fsck
+'
+
 test_expect_success 'read bundle over stdin' '
 	git bundle create some.bundle HEAD &&
 
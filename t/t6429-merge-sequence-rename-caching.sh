@@ -764,4 +764,96 @@ test_expect_success 'avoid assuming we detected renames' '
 	)
 '
 
+#
+# In the following testcase:
+#   Base:     numbers_1
+#   Upstream: rename numbers_1 -> sequence_2
+#   Topic_1:  numbers_3
+#   Topic_2:  numbers_4
+# and each topic commit is merged with upstream by a separate merge-tree
+# process, as a merge queue would do.  With merge.renameCache, the second
+# process should find the rename on the upstream side on disk instead of
+# detecting it again.
+#
+test_expect_success 'rename cache is shared between processes' '
+	git init rename-cache-on-disk &&
+	(
+		cd rename-cache-on-disk &&
+
+		test_seq 11 30 >numbers &&
+		git add numbers &&
+		git commit -m orig &&
+
+		git branch upstream &&
+		git branch topic &&
+
+		git switch upstream &&
+		test_seq 1 30 >numbers &&
+		git add numbers &&
+		git mv numbers sequence &&
+		git commit -m "Rename numbers -> sequence" &&
+
+		git switch topic &&
+		test_seq 11 31 >numbers &&
+		git commit -a -m A &&
+		test_seq 11 32 >numbers &&
+		git commit -a -m B &&
+
+		git merge-tree --write-tree upstream topic~1 >expect-A &&
+		git merge-tree --write-tree upstream topic >expect-B &&
+
+		GIT_TRACE2_PERF="$(pwd)/trace.output" &&
+		export GIT_TRACE2_PERF &&
+
+		git -c merge.renameCache=true merge-tree --write-tree \
+			upstream topic~1 >actual-A &&
+		test_cmp expect-A actual-A &&
+		grep region_enter.*diffcore_rename trace.output >calls &&
+		test_line_count = 1 calls &&
+		ls .git/rename-cache >entries &&
+		test_line_count = 2 entries &&
+
+		rm trace.output &&
+		git -c merge.renameCache=true merge-tree --write-tree \
+			upstream topic >actual-B &&
+		test_cmp expect-B actual-B &&
+		grep rename_cache/loaded trace.output &&
+		! grep region_enter.*diffcore_rename trace.output &&
+
+		# A broken entry is ignored and rewritten
+		for f in .git/rename-cache/*
+		do
+			echo garbage >"$f" || exit 1
+		done &&
+		git -c merge.renameCache=true merge-tree --write-tree \
+			upstream topic >actual-B &&
+		test_cmp expect-B actual-B &&
+		git -c merge.renameCache=true merge-tree --write-tree \
+			upstream topic >actual-B &&
+		test_cmp expect-B actual-B &&
+		# only the entry for topic~1 is left untouched
+		grep -l garbage .git/rename-cache/* >broken &&
+		test_line_count = 1 broken
+	)
+'
+
+test_expect_success 'gc removes rename cache entries that are not used' '
+	(
+		cd rename-cache-on-disk &&
+
+		test-tool chmtime =-2592000 .git/rename-cache/* &&
+		git -c merge.renameCache=true merge-tree --write-tree \
+			upstream topic >actual-B &&
+		test_cmp expect-B actual-B &&
+		git gc &&
+		ls .git/rename-cache >entries &&
+		test_line_count = 2 entries &&
+		! grep garbage .git/rename-cache/* &&
+
+		git -c gc.renameCacheExpire=now gc &&
+		ls .git/rename-cache >entries &&
+		test_must_be_empty entries
+	)
+'
+
 test_done
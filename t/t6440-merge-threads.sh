@@ -0,0 +1,102 @@
+#!/bin/sh
+
+test_description='merge-ort content merges with merge.threads'
+
+GIT_TEST_DEFAULT_INITIAL_BRANCH_NAME=main
+export GIT_TEST_DEFAULT_INITIAL_BRANCH_NAME
+
+TEST_PASSES_SANITIZE_LEAK=true
+. ./test-lib.sh
+
+test_expect_success 'setup' '
+	for i in $(test_seq 1 40)
+	do
+		test_write_lines a b c d e f g h i j "$i" >file$i || return 1
+	done &&
+	test_write_lines 1 2 3 4 5 >conflict &&
+	printf "\0base" >binary &&
+	test_write_lines 1 2 3 >union &&
+	test_write_lines 1 2 3 >custom &&
+	git add . &&
+	git commit -m base &&
+
+	git checkout -b side1 &&
+	for i in $(test_seq 1 40)
+	do
+		sed -e s/a/side1/ file$i >tmp &&
+		mv tmp file$i || return 1
+	done &&
+	test_write_lines 1 2 side1 4 5 >conflict &&
+	printf "\0side1" >binary &&
+	test_write_lines 1 2 3 side1 >union &&
+	test_write_lines 1 2 3 side1 >custom &&
+	git commit -a -m side1 &&
+
+	git checkout -b side2 main &&
+	for i in $(test_seq 1 40)
+	do
+		sed -e s/j/side2/ file$i >tmp &&
+		mv tmp file$i || return 1
+	done &&
+	test_write_lines 1 2 side2 4 5 >conflict &&
+	printf "\0side2" >binary &&
+	test_write_lines 1 2 3 side2 >union &&
+	test_write_lines 1 2 3 side2 >custom &&
+	git commit -a -m side2 &&
+
+	cat >.git/info/attributes <<-\EOF &&
+	union merge=union
+	custom merge=custom
+	EOF
+	git config merge.custom.driver "cat %B >%A"
+'
+
+test_expect_success 'threaded content merges match serial ones' '
+	test_expect_code 1 git -c merge.threads=1 \
+		merge-tree --write-tree side1 side2 >expect &&
+	test_expect_code 1 git -c merge.threads=4 \
+		merge-tree --write-tree side1 side2 >actual &&
+	test_cmp expect actual &&
+	grep "Cannot merge binary files: binary" actual &&
+	grep "CONFLICT (content): Merge conflict in conflict" actual
+'
+
+test_expect_success 'content merges are done ahead of time by threads' '
+	test_when_finished "rm -f trace.output" &&
+	test_expect_code 1 env GIT_TRACE2_PERF="$(pwd)/trace.output" \
+		git -c merge.threads=4 merge-tree --write-tree side1 side2 &&
+	grep "premerge_contents/count:43$" trace.output
+'
+
+test_expect_success 'threaded merge with -Xours' '
+	git checkout --detach side1 &&
+	git -c merge.threads=1 merge -Xours -m serial side2 &&
+	git rev-parse HEAD^{tree} >expect &&
+	git checkout --detach side1 &&
+	git -c merge.threads=0 merge -Xours -m threaded side2 &&
+	git rev-parse HEAD^{tree} >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'threaded merge of merge bases' '
+	git checkout -b cross1 side1 &&
+	git merge -s ours -m cross1 side2 &&
+	git checkout -b cross2 side2 &&
+	git merge -s ours -m cross2 side1 &&
+	test_commit cross2-change &&
+	git checkout cross1 &&
+	test_commit cross1-change &&
+	test_expect_code 1 git -c merge.threads=1 \
+		merge-tree --write-tree cross1 cross2 >expect &&
+	test_expect_code 1 git -c merge.threads=4 \
+		merge-tree --write-tree cross1 cross2 >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'negative merge.threads is rejected' '
+	test_must_fail git -c merge.threads=-1 \
+		merge-tree --write-tree side1 side2 2>err &&
+	grep "invalid number of threads specified (-1) for merge.threads" err
+'
+
+test_done
@@ -58,6 +58,7 @@ test_expect_success 'setup' '
 	git -c commitGraph.generationVersion=1 commit-graph write --reachable &&
 	mv .git/objects/info/commit-graph commit-graph-no-gdat &&
 	chmod u+w commit-graph-no-gdat &&
+	git repack -adb &&
 	git config core.commitGraph true
 '
 
@@ -73,6 +74,10 @@ run_all_modes () {
 	test_cmp expect actual &&
 	cp commit-graph-no-gdat .git/objects/info/commit-graph &&
 	"$@" <input >actual &&
+	test_cmp expect actual &&
+	rm -f .git/objects/info/commit-graph &&
+	test_config core.reachabilityBitmaps true &&
+	"$@" <input >actual &&
 	test_cmp expect actual
 }
 
@@ -0,0 +1,95 @@
+#!/bin/sh
+
+test_description='git blame with blame.cache'
+
+TEST_PASSES_SANITIZE_LEAK=true
+. ./test-lib.sh
+
+test_expect_success 'setup' '
+	test_write_lines 1 2 3 4 5 6 7 8 9 10 >file &&
+	git add file &&
+	test_tick &&
+	git commit -m initial &&
+	sed -e s/2/two/ file >tmp && mv tmp file &&
+	test_tick &&
+	git commit -a -m two &&
+
+	git checkout -b side &&
+	sed -e s/9/nine/ file >tmp && mv tmp file &&
+	test_tick &&
+	git commit -a -m nine &&
+	git checkout - &&
+	sed -e s/5/five/ file >tmp && mv tmp file &&
+	test_tick &&
+	git commit -a -m five &&
+	test_tick &&
+	git merge -m merge side &&
+
+	git mv file renamed &&
+	sed -e s/7/seven/ renamed >tmp && mv tmp renamed &&
+	test_tick &&
+	git commit -a -m "rename and seven" &&
+	test_write_lines 0 >>renamed &&
+	test_tick &&
+	git commit -a -m zero
+'
+
+test_expect_success 'blame at an older commit fills the cache' '
+	git blame --porcelain HEAD~2 -- file >expect &&
+	git -c blame.cache=true blame --porcelain HEAD~2 -- file >actual &&
+	test_cmp expect actual &&
+	ls .git/blame-cache >entries &&
+	test_line_count = 1 entries
+'
+
+test_expect_success 'later blame takes the cached result' '
+	git blame --porcelain HEAD -- renamed >expect &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+		git -c blame.cache=true blame --porcelain HEAD -- renamed >actual &&
+	test_cmp expect actual &&
+	grep "\"key\":\"cache/hit\",\"value\":\"file\"" trace.event &&
+
+	git blame -L3,8 HEAD -- renamed >expect &&
+	git -c blame.cache=true blame -L3,8 HEAD -- renamed >actual &&
+	test_cmp expect actual &&
+
+	git blame --root HEAD -- renamed >expect &&
+	git -c blame.cache=true blame --root HEAD -- renamed >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'cache is not used for blame -M' '
+	rm -rf .git/blame-cache &&
+	git -c blame.cache=true blame -M HEAD~2 -- file >/dev/null &&
+	test_path_is_missing .git/blame-cache
+'
+
+test_expect_success 'broken cache entries are ignored' '
+	git -c blame.cache=true blame HEAD~2 -- file >/dev/null &&
+	for f in .git/blame-cache/*
+	do
+		echo garbage >"$f" || return 1
+	done &&
+	git blame HEAD -- renamed >expect &&
+	git -c blame.cache=true blame HEAD -- renamed >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'gc removes blame cache entries that are not used' '
+	rm -rf .git/blame-cache trace.event &&
+	git -c blame.cache=true blame HEAD~2 -- file >/dev/null &&
+	git -c blame.cache=true blame HEAD~1 -- renamed >/dev/null &&
+	test-tool chmtime =-2592000 .git/blame-cache/* &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+		git -c blame.cache=true blame HEAD -- renamed >/dev/null &&
+	grep "\"key\":\"cache/hit\",\"value\":\"renamed\"" trace.event &&
+	git gc &&
+	ls .git/blame-cache >entries &&
+	test_line_count = 2 entries &&
+
+	git -c gc.blameCacheExpire=now gc &&
+	ls .git/blame-cache >entries &&
+	test_must_be_empty entries
+'
+
+test_done
@@ -0,0 +1,64 @@
+#!/bin/sh
+
+test_description='git blame with blame.threads'
+
+TEST_PASSES_SANITIZE_LEAK=true
+. ./test-lib.sh
+
+test_expect_success 'setup' '
+	test_write_lines 1 2 3 4 5 6 7 8 9 10 >file &&
+	git add file &&
+	test_tick &&
+	git commit -m initial &&
+	for i in 2 4 6 8
+	do
+		sed -e "s/^$i\$/line $i/" file >tmp &&
+		mv tmp file &&
+		test_tick &&
+		git commit -a -m "change $i" || return 1
+	done &&
+
+	git checkout -b side HEAD~2 &&
+	sed -e s/10/ten/ file >tmp && mv tmp file &&
+	test_tick &&
+	git commit -a -m ten &&
+	git checkout - &&
+	test_tick &&
+	git merge -m merge side &&
+
+	git mv file renamed &&
+	sed -e s/1/one/ renamed >tmp && mv tmp renamed &&
+	test_tick &&
+	git commit -m rename
+'
+
+test_expect_success 'threaded blame matches serial blame' '
+	for opts in "" "--porcelain" "-M" "-C -C" "--first-parent" "-w"
+	do
+		git -c blame.threads=1 blame $opts renamed >expect &&
+		git -c blame.threads=4 blame $opts renamed >actual &&
+		test_cmp expect actual || return 1
+	done
+'
+
+test_expect_success 'diffs are computed ahead of time by threads' '
+	test_when_finished "rm -f trace.output" &&
+	GIT_TRACE2_PERF="$(pwd)/trace.output" \
+		git -c blame.threads=4 blame renamed >/dev/null &&
+	grep "prediff/count:[1-9]" trace.output &&
+	grep "prediff/used:[1-9]" trace.output
+'
+
+test_expect_success 'blame.threads=1 does not look ahead' '
+	test_when_finished "rm -f trace.output" &&
+	GIT_TRACE2_PERF="$(pwd)/trace.output" \
+		git -c blame.threads=1 blame renamed >/dev/null &&
+	! grep "prediff/count" trace.output
+'
+
+test_expect_success 'negative blame.threads is rejected' '
+	test_must_fail git -c blame.threads=-1 blame renamed 2>err &&
+	grep "invalid number of threads" err
+'
+
+test_done
@@ -216,8 +216,91 @@ struct output_state {
 	int used;
 	unsigned packfile_uris_started : 1;
 	unsigned packfile_started : 1;
+	unsigned no_splice : 1;
+	uint64_t spliced;
 };
 
+#ifdef HAVE_SPLICE
+/*
+ * Move "len" bytes, which are known to be waiting in the pipe "in", to
+ * our output without copying them through userspace. Returns -1 without
+ * moving anything if splice() cannot be used for our output.
+ */
+static int splice_pack_data(int in, size_t len)
+{
+	size_t done = 0;
+
+	while (done < len) {
+		ssize_t n = splice(in, NULL, 1, NULL, len - done,
+				   SPLICE_F_MOVE | SPLICE_F_MORE);
+
+		if (n < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			if (!done && (errno == EINVAL || errno == ENOSYS))
+				return -1;
+			check_pipe(errno);
+			die_errno("unable to splice pack data");
+		}
+		if (!n)
+			die("pack-objects output ended early");
+		done += n;
+	}
+	return 0;
+}
+
+/*
+ * Relay what pack-objects has written so far like relay_pack_data()
+ * does once the pack has started, but splice the pack data into our
+ * output, writing only the sideband headers (and the byte we held back
+ * last time) ourselves. Returns 0 if it did not relay anything, in
+ * which case the caller should read the data instead.
+ */
+static int splice_relay_pack_data(int pack_objects_out, struct output_state *os,
+				  int use_sideband)
+{
+	int avail;
+	size_t len;
+	char hdr[5 + 1];
+	int hdr_len = 0;
+
+	if (ioctl(pack_objects_out, FIONREAD, &avail) < 0) {
+		os->no_splice = 1;
+		return 0;
+	}
+	/* keep the last byte to ourselves, see relay_pack_data() */
+	if (avail < 2)
+		return 0;
+
+	len = avail - 1;
+	if (use_sideband) {
+		if (len > use_sideband - 5 - os->used)
+			len = use_sideband - 5 - os->used;
+		xsnprintf(hdr, sizeof(hdr), "%04x", (int)(len + os->used + 5));
+		hdr[4] = 1;
+		hdr_len = 5;
+	}
+	if (os->used)
+		hdr[hdr_len++] = os->buffer[0];
+	if (hdr_len)
+		write_or_die(1, hdr, hdr_len);
+
+	if (splice_pack_data(pack_objects_out, len) < 0) {
+		os->no_splice = 1;
+		if (read_in_full(pack_objects_out, os->buffer, len) != len)
+			die_errno("unable to read pack data");
+		write_or_die(1, os->buffer, len);
+	} else {
+		os->spliced += len;
+	}
+
+	if (xread(pack_objects_out, os->buffer, 1) != 1)
+		die_errno("unable to read pack data");
+	os->used = 1;
+	return 1;
+}
+#endif
+
 static int relay_pack_data(int pack_objects_out, struct output_state *os,
 			   int use_sideband, int write_packfile_line)
 {
@@ -233,6 +316,12 @@ static int relay_pack_data(int pack_objects_out, struct output_state *os,
 	 */
 	ssize_t readsz;
 
+#ifdef HAVE_SPLICE
+	if (os->packfile_started && !os->no_splice &&
+	    splice_relay_pack_data(pack_objects_out, os, use_sideband))
+		return 1;
+#endif
+
 	readsz = xread(pack_objects_out, os->buffer + os->used,
 		       sizeof(os->buffer) - os->used);
 	if (readsz < 0) {
@@ -337,6 +426,8 @@ static void create_pack_file(struct upload_pack_data *pack_data,
 	pack_objects.err = -1;
 	pack_objects.clean_on_exit = 1;
 
+	output_state->no_splice = git_env_bool("GIT_TEST_UPLOAD_PACK_NO_SPLICE", 0);
+
 	if (start_command(&pack_objects))
 		die("git upload-pack: unable to fork git-pack-objects");
 
@@ -455,6 +546,10 @@ static void create_pack_file(struct upload_pack_data *pack_data,
 		goto fail;
 	}
 
+	if (output_state->spliced)
+		trace2_data_intmax("upload-pack", the_repository, "spliced",
+				   output_state->spliced);
+
 	/* flush the data */
 	if (output_state->used > 0) {
 		send_client_data(1, output_state->buffer, output_state->used,
@@ -295,19 +295,45 @@ static unsigned long xdl_hash_record_with_whitespace(char const **data,
 }
 
 unsigned long xdl_hash_record(char const **data, char const *top, long flags) {
-	unsigned long ha = 5381;
+	uint64_t ha = 5381, w;
 	char const *ptr = *data;
+	char const *eol;
+	size_t len;
 
 	if (flags & XDF_WHITESPACE_FLAGS)
 		return xdl_hash_record_with_whitespace(data, top, flags);
 
-	for (; ptr < top && *ptr != '\n'; ptr++) {
-		ha += (ha << 5);
-		ha ^= (unsigned long) *ptr;
+	/*
+	 * Find the end of the record with memchr(), which the C library
+	 * usually implements with vector instructions picked at runtime,
+	 * and then hash the record eight bytes at a time. Records are
+	 * compared byte for byte once their hashes match, so the hash
+	 * only needs to be cheap and well mixed, not stable across
+	 * platforms.
+	 */
+	if (!(eol = memchr(ptr, '\n', top - ptr)))
+		eol = top;
+	*data = eol < top ? eol + 1 : eol;
+	len = eol - ptr;
+
+	for (; eol - ptr >= 8; ptr += 8) {
+		memcpy(&w, ptr, 8);
+		ha = (ha ^ w) * 0x9e3779b97f4a7c15ULL;
+		ha ^= ha >> 29;
+	}
+	if (ptr < eol) {
+		w = 0;
+		memcpy(&w, ptr, eol - ptr);
+		ha = (ha ^ w) * 0x9e3779b97f4a7c15ULL;
 	}
-	*data = ptr < top ? ptr + 1: ptr;
 
-	return ha;
+	/* fold in the length, then mix the high bits into the low ones */
+	ha ^= len;
+	ha ^= ha >> 32;
+	ha *= 0xff51afd7ed558ccdULL;
+	ha ^= ha >> 29;
+
+	return (unsigned long)ha;
 }
 
 unsigned int xdl_hashbits(unsigned int size) {